@@ -0,0 +1,33 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "AlignmentGraph.h"
+#include "BigraphToDigraph.h"
+#include "GfaGraph.h"
+#include "MinimizerSeeder.h"
+
+// times building the minimizer index of a graph, which slides the minimizer window over every node
+// usage: MinimizerBuildBenchmark graph.gfa [minimizer length] [window size] [threads] [repeats] [index memory limit in MB, 0 for in memory]
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "usage: " << argv[0] << " graph.gfa [minimizer length] [window size] [threads] [repeats] [index memory limit in MB, 0 for in memory]" << std::endl;
+		return 1;
+	}
+	size_t minimizerLength = argc > 2 ? std::stoull(argv[2]) : 15;
+	size_t windowSize = argc > 3 ? std::stoull(argv[3]) : 20;
+	size_t numThreads = argc > 4 ? std::stoull(argv[4]) : 1;
+	size_t repeats = argc > 5 ? std::stoull(argv[5]) : 3;
+	size_t memoryLimit = argc > 6 ? std::stoull(argv[6]) * 1024 * 1024 : 0;
+	AlignmentGraph graph = DirectedGraph::BuildFromGFA(GfaGraph::LoadFromFile(argv[1], numThreads));
+	std::cout << "graph " << argv[1] << " nodes " << graph.BigraphNodeCount() << " k " << minimizerLength << " w " << windowSize << " threads " << numThreads << std::endl;
+	for (size_t repeat = 0; repeat < repeats; repeat++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		MinimizerSeeder seeder { graph, minimizerLength, windowSize, numThreads, 1.0 - 0.0002, false, memoryLimit };
+		auto time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "build " << time << " ms" << std::endl;
+	}
+}
@@ -0,0 +1,60 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "AlignmentGraph.h"
+#include "BigraphToDigraph.h"
+#include "GfaGraph.h"
+#include "MinimizerSeeder.h"
+#include "fastqloader.h"
+
+// builds the minimizer index with the BBHash bucket layout and with the hash table layout and seeds the same reads with both
+// usage: MinimizerIndexBenchmark graph.gfa reads.fq [minimizer length] [window size] [threads] [repeats]
+
+size_t residentKilobytes()
+{
+	std::ifstream file { "/proc/self/status" };
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.substr(0, 6) == "VmRSS:") return std::stoull(line.substr(6));
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		std::cerr << "usage: " << argv[0] << " graph.gfa reads.fq [minimizer length] [window size] [threads] [repeats]" << std::endl;
+		return 1;
+	}
+	size_t minimizerLength = argc > 3 ? std::stoull(argv[3]) : 15;
+	size_t windowSize = argc > 4 ? std::stoull(argv[4]) : 20;
+	size_t numThreads = argc > 5 ? std::stoull(argv[5]) : 1;
+	size_t repeats = argc > 6 ? std::stoull(argv[6]) : 5;
+	AlignmentGraph graph = DirectedGraph::BuildFromGFA(GfaGraph::LoadFromFile(argv[1], numThreads));
+	std::vector<std::string> reads;
+	FastQ::streamFastqFromFile(argv[2], false, [&reads](FastQ& read) { reads.push_back(read.sequence); });
+	std::cout << "graph " << argv[1] << " reads " << reads.size() << " k " << minimizerLength << " w " << windowSize << " threads " << numThreads << std::endl;
+	for (bool useHashTable : { false, true })
+	{
+		size_t memoryBefore = residentKilobytes();
+		auto buildStart = std::chrono::steady_clock::now();
+		MinimizerSeeder seeder { graph, minimizerLength, windowSize, numThreads, 1.0 - 0.0002, useHashTable, 0 };
+		auto buildTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - buildStart).count();
+		size_t memoryAfter = residentKilobytes();
+		size_t seeds = 0;
+		auto seedStart = std::chrono::steady_clock::now();
+		for (size_t repeat = 0; repeat < repeats; repeat++)
+		{
+			for (const auto& read : reads)
+			{
+				seeds += seeder.getSeeds(read, 10).size();
+			}
+		}
+		auto seedTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - seedStart).count();
+		std::cout << (useHashTable ? "hash table" : "buckets") << ": build " << buildTime << " ms, index " << (memoryAfter > memoryBefore ? memoryAfter - memoryBefore : 0) << " kB, getSeeds " << seedTime << " ms for " << seeds << " seeds" << std::endl;
+	}
+}
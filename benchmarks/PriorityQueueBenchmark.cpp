@@ -0,0 +1,198 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <phmap.h>
+#include "ArrayPriorityQueue.h"
+
+// runs ArrayPriorityQueue and the queue it replaced through the pattern of calculateSlice: each slice inserts the seeded nodes,
+// pops and reinserts neighbors with nondecreasing priorities until the band is exceeded, then clears the queue
+// usage: PriorityQueueBenchmark [slices] [repeats]
+// the checksum only depends on the pop order, so the two queues must print the same checksums
+
+// same size as EdgeWithPriority with a 64 bit WordSlice
+struct Edge
+{
+	size_t target;
+	int64_t priority;
+	uint64_t VP;
+	uint64_t VN;
+	int64_t scoreEnd;
+	bool sliceConsistency;
+};
+
+// ArrayPriorityQueue before the bitmap rewrite: a vector per priority with a std::priority_queue of the nonempty priorities
+namespace Baseline
+{
+	template <typename T, bool SparseStorage>
+	class ArrayPriorityQueue
+	{
+	public:
+		ArrayPriorityQueue(size_t maxPriority, size_t maxExtras) :
+		activeQueues(),
+		extras(),
+		queues(),
+		numItems(0)
+		{
+			initialize(maxPriority, maxExtras);
+		}
+		template <bool Sparse = SparseStorage>
+		typename std::enable_if<Sparse>::type initialize(size_t maxPriority, size_t maxExtras)
+		{
+			queues.resize(maxPriority);
+		}
+		template <bool Sparse = SparseStorage>
+		typename std::enable_if<!Sparse>::type initialize(size_t maxPriority, size_t maxExtras)
+		{
+			extras.resize(maxExtras, std::vector<T>{});
+			queues.resize(maxPriority);
+		}
+#ifdef NDEBUG
+		__attribute__((always_inline))
+#endif
+		T& top()
+		{
+			size_t queue = activeQueues.top();
+			return queues[queue].back();
+		}
+#ifdef NDEBUG
+		__attribute__((always_inline))
+#endif
+		void pop()
+		{
+			size_t queue = activeQueues.top();
+			queues[queue].pop_back();
+			if (queues[queue].size() == 0) activeQueues.pop();
+			numItems--;
+		}
+#ifdef NDEBUG
+		__attribute__((always_inline))
+#endif
+		size_t size() const
+		{
+			return numItems;
+		}
+#ifdef NDEBUG
+		__attribute__((always_inline))
+#endif
+		void insert(size_t priority, const T& item)
+		{
+			queues[priority].push_back(item);
+			extras[item.target].push_back(item);
+			if (queues[priority].size() == 1) activeQueues.emplace(priority);
+			numItems++;
+		}
+		void clear()
+		{
+			while (activeQueues.size() > 0)
+			{
+				size_t queue = activeQueues.top();
+				for (auto item : queues[queue])
+				{
+					removeExtras(item.target);
+				}
+				queues[queue].clear();
+				activeQueues.pop();
+			}
+			numItems = 0;
+			sparsify();
+		}
+		template<bool Sparse = SparseStorage>
+		typename std::enable_if<Sparse>::type sparsify()
+		{
+			decltype(extras) empty;
+			std::swap(extras, empty);
+		}
+		template<bool Sparse = SparseStorage>
+		typename std::enable_if<!Sparse>::type sparsify()
+		{
+		}
+		void removeExtras(size_t index)
+		{
+			extras[index].clear();
+		}
+		size_t extraSize(size_t index) const
+		{
+			return getVec(extras, index).size();
+		}
+	private:
+		const std::vector<T>& getVec(const std::vector<std::vector<T>>& list, size_t index) const
+		{
+			return list[index];
+		}
+		const std::vector<T>& getVec(const phmap::flat_hash_map<size_t, std::vector<T>>& list, size_t index) const
+		{
+			static std::vector<T> empty;
+			auto found = list.find(index);
+			if (found == list.end()) return empty;
+			return found->second;
+		}
+		std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> activeQueues;
+		typename std::conditional<SparseStorage, phmap::flat_hash_map<size_t, std::vector<T>>, std::vector<std::vector<T>>>::type extras;
+		std::vector<std::vector<T>> queues;
+		size_t numItems;
+	};
+}
+
+template <typename Queue>
+double runSlices(size_t numSlices, size_t& checksum)
+{
+	const size_t wordSize = 64;
+	const size_t bandwidth = 35;
+	const size_t numNodes = 100000;
+	// as sized in AlignerGraphsizedState
+	const size_t maxPriority = wordSize * (wordSize + bandwidth + 1) + bandwidth + 1;
+	Queue queue { maxPriority, numNodes };
+	std::mt19937_64 rng { 1 };
+	auto start = std::chrono::steady_clock::now();
+	for (size_t slice = 0; slice < numSlices; slice++)
+	{
+		size_t base = rng() % (maxPriority / 2);
+		for (size_t i = 0; i < 30; i++)
+		{
+			size_t priority = base + rng() % 200;
+			queue.insert(priority, Edge { rng() % numNodes, (int64_t)priority, 0, 0, 0, false });
+		}
+		size_t pops = 0;
+		while (queue.size() > 0)
+		{
+			Edge edge = queue.top();
+			if (edge.priority > (int64_t)(base + 600)) break;
+			checksum += edge.target + queue.extraSize(edge.target);
+			queue.pop();
+			queue.removeExtras(edge.target);
+			pops += 1;
+			if (pops < 300)
+			{
+				size_t priority = edge.priority + rng() % 100;
+				queue.insert(priority, Edge { rng() % numNodes, (int64_t)priority, 0, 0, 0, false });
+			}
+		}
+		queue.clear();
+	}
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	size_t numSlices = argc > 1 ? std::stoull(argv[1]) : 20000;
+	size_t repeats = argc > 2 ? std::stoull(argv[2]) : 3;
+	for (size_t repeat = 0; repeat < repeats; repeat++)
+	{
+		size_t oldSparseChecksum = 0;
+		size_t oldDenseChecksum = 0;
+		size_t sparseChecksum = 0;
+		size_t denseChecksum = 0;
+		double oldSparseTime = runSlices<Baseline::ArrayPriorityQueue<Edge, true>>(numSlices, oldSparseChecksum);
+		double sparseTime = runSlices<ArrayPriorityQueue<Edge, true>>(numSlices, sparseChecksum);
+		double oldDenseTime = runSlices<Baseline::ArrayPriorityQueue<Edge, false>>(numSlices, oldDenseChecksum);
+		double denseTime = runSlices<ArrayPriorityQueue<Edge, false>>(numSlices, denseChecksum);
+		if (oldSparseChecksum != sparseChecksum || oldDenseChecksum != denseChecksum)
+		{
+			std::cerr << "pop order differs between the old and the new queue" << std::endl;
+			return 1;
+		}
+		std::cout << "sparse extras: old " << oldSparseTime << " s, new " << sparseTime << " s (checksum " << sparseChecksum << "); dense extras: old " << oldDenseTime << " s, new " << denseTime << " s (checksum " << denseChecksum << ")" << std::endl;
+	}
+}
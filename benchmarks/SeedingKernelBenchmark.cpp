@@ -0,0 +1,240 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "SeedingKernel.h"
+
+// checks SeedingKernel::EncodeBases against a per-base switch on random strings, times encoding a long random sequence,
+// and times the read-side k-mer iteration of getSeeds over random reads with the per-base charToInt / validChar lookups it used before the kernel and with the kernel
+// usage: SeedingKernelBenchmark [megabases] [repeats] [k] [w]
+// build with -DNOSIMDKERNEL for the scalar numbers. getSeeds as a whole is timed by MinimizerIndexBenchmark
+
+uint8_t referenceCode(char base)
+{
+	switch(base)
+	{
+		case 'a':
+		case 'A':
+			return 0;
+		case 'c':
+		case 'C':
+			return 1;
+		case 'g':
+		case 'G':
+			return 2;
+		case 't':
+		case 'T':
+			return 3;
+	}
+	return SeedingKernel::InvalidBase;
+}
+
+// the k-mer iteration of getSeeds before the kernel, checking and converting each base separately
+namespace Baseline
+{
+	size_t charToInt(char c)
+	{
+		switch(c)
+		{
+			case 'a':
+			case 'A':
+				return 0;
+			case 'c':
+			case 'C':
+				return 1;
+			case 'g':
+			case 'G':
+				return 2;
+			case 't':
+			case 'T':
+				return 3;
+		}
+		return 0;
+	}
+
+	std::vector<bool> getValidChars()
+	{
+		std::vector<bool> result;
+		result.resize(256, false);
+		result['a'] = true;
+		result['A'] = true;
+		result['c'] = true;
+		result['C'] = true;
+		result['g'] = true;
+		result['G'] = true;
+		result['t'] = true;
+		result['T'] = true;
+		return result;
+	}
+
+	std::vector<bool> validChar = getValidChars();
+
+	template <typename CallbackF>
+	void iterateKmers(const std::string& str, size_t kmerLength, size_t windowSize, CallbackF callback)
+	{
+		const size_t realWindow = windowSize - kmerLength + 1;
+		if (str.size() < kmerLength) return;
+		const size_t mask = ~(0xFFFFFFFFFFFFFFFF << (kmerLength * 2));
+		size_t offset = 0;
+	start:
+		while (offset < str.size() && !validChar[str[offset]]) offset++;
+		if (offset + kmerLength > str.size()) return;
+		size_t kmer = 0;
+		for (size_t i = 0; i < kmerLength; i++)
+		{
+			if (!validChar[str[offset+i]])
+			{
+				offset += i;
+				goto start;
+			}
+			kmer <<= 2;
+			kmer |= charToInt(str[offset+i]);
+		}
+		callback(offset + kmerLength-1, kmer);
+		size_t lastKmer = kmer;
+		size_t lastPos = offset + kmerLength-1;
+		for (size_t i = kmerLength; offset+i < str.size(); i++)
+		{
+			if (!validChar[str[offset+i]])
+			{
+				offset += i;
+				goto start;
+			}
+			kmer <<= 2;
+			kmer &= mask;
+			kmer |= charToInt(str[offset + i]);
+			if (lastKmer != kmer || lastPos <= offset + i - realWindow)
+			{
+				callback(offset + i, kmer);
+				lastKmer = kmer;
+				lastPos = offset + i;
+			}
+		}
+	}
+}
+
+// the k-mer iteration of getSeeds with the kernel, the codes buffer is reused between reads like the thread's buffer in MinimizerSeeder
+namespace Kernel
+{
+	template <typename CallbackF>
+	void iterateKmers(const std::string& str, size_t kmerLength, size_t windowSize, std::vector<uint8_t>& codes, CallbackF callback)
+	{
+		const size_t realWindow = windowSize - kmerLength + 1;
+		if (str.size() < kmerLength) return;
+		const size_t mask = ~(0xFFFFFFFFFFFFFFFF << (kmerLength * 2));
+		if (codes.size() < str.size()) codes.resize(str.size());
+		SeedingKernel::EncodeBases(str.data(), str.size(), codes.data());
+		size_t offset = 0;
+	start:
+		while (offset < str.size() && codes[offset] == SeedingKernel::InvalidBase) offset++;
+		if (offset + kmerLength > str.size()) return;
+		size_t kmer = 0;
+		for (size_t i = 0; i < kmerLength; i++)
+		{
+			if (codes[offset+i] == SeedingKernel::InvalidBase)
+			{
+				offset += i;
+				goto start;
+			}
+			kmer <<= 2;
+			kmer |= codes[offset+i];
+		}
+		callback(offset + kmerLength-1, kmer);
+		size_t lastKmer = kmer;
+		size_t lastPos = offset + kmerLength-1;
+		for (size_t i = kmerLength; offset+i < str.size(); i++)
+		{
+			if (codes[offset+i] == SeedingKernel::InvalidBase)
+			{
+				offset += i;
+				goto start;
+			}
+			kmer <<= 2;
+			kmer &= mask;
+			kmer |= codes[offset + i];
+			if (lastKmer != kmer || lastPos <= offset + i - realWindow)
+			{
+				callback(offset + i, kmer);
+				lastKmer = kmer;
+				lastPos = offset + i;
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t megabases = argc > 1 ? std::stoull(argv[1]) : 100;
+	size_t repeats = argc > 2 ? std::stoull(argv[2]) : 3;
+	size_t kmerLength = argc > 3 ? std::stoull(argv[3]) : 15;
+	size_t windowSize = argc > 4 ? std::stoull(argv[4]) : 20;
+	std::mt19937 rng { 1 };
+	// odd rounds use sequence-like characters, even rounds all byte values. Lengths cover the vector tails
+	for (size_t round = 0; round < 10000; round++)
+	{
+		std::string sequence;
+		sequence.resize(rng() % 200);
+		for (size_t i = 0; i < sequence.size(); i++)
+		{
+			sequence[i] = (round % 2 == 1) ? "ACGTacgtNn-"[rng() % 11] : (char)(rng() % 256);
+		}
+		std::vector<uint8_t> codes;
+		codes.resize(sequence.size());
+		SeedingKernel::EncodeBases(sequence.data(), sequence.size(), codes.data());
+		for (size_t i = 0; i < sequence.size(); i++)
+		{
+			if (codes[i] != referenceCode(sequence[i]))
+			{
+				std::cerr << SeedingKernel::ImplementationName() << " encoded character " << (int)(uint8_t)sequence[i] << " as " << (int)codes[i] << std::endl;
+				return 1;
+			}
+		}
+	}
+	std::string sequence;
+	sequence.resize(megabases * 1000000);
+	for (size_t i = 0; i < sequence.size(); i++)
+	{
+		sequence[i] = "ACGT"[rng() % 4];
+	}
+	std::vector<uint8_t> codes;
+	codes.resize(sequence.size());
+	for (size_t repeat = 0; repeat < repeats; repeat++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		SeedingKernel::EncodeBases(sequence.data(), sequence.size(), codes.data());
+		auto time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+		std::cout << SeedingKernel::ImplementationName() << ": " << megabases << " Mbp encoded in " << time << " ms" << std::endl;
+	}
+	// 10 kbp reads with an occasional N
+	std::vector<std::string> reads;
+	for (size_t start = 0; start + 10000 <= sequence.size(); start += 10000)
+	{
+		reads.emplace_back(sequence.substr(start, 10000));
+		reads.back()[rng() % 10000] = 'N';
+	}
+	std::vector<uint8_t> readCodes;
+	for (size_t repeat = 0; repeat < repeats; repeat++)
+	{
+		size_t baselineChecksum = 0;
+		size_t kernelChecksum = 0;
+		auto baselineStart = std::chrono::steady_clock::now();
+		for (const auto& read : reads)
+		{
+			Baseline::iterateKmers(read, kmerLength, windowSize, [&baselineChecksum](size_t pos, size_t kmer) { baselineChecksum += pos ^ kmer; });
+		}
+		auto kernelStart = std::chrono::steady_clock::now();
+		for (const auto& read : reads)
+		{
+			Kernel::iterateKmers(read, kmerLength, windowSize, readCodes, [&kernelChecksum](size_t pos, size_t kmer) { kernelChecksum += pos ^ kmer; });
+		}
+		auto kernelEnd = std::chrono::steady_clock::now();
+		if (baselineChecksum != kernelChecksum)
+		{
+			std::cerr << "k-mers differ between the baseline and the kernel" << std::endl;
+			return 1;
+		}
+		std::cout << "k-mers of " << reads.size() << " reads: charToInt / validChar " << std::chrono::duration_cast<std::chrono::milliseconds>(kernelStart - baselineStart).count() << " ms, " << SeedingKernel::ImplementationName() << " " << std::chrono::duration_cast<std::chrono::milliseconds>(kernelEnd - kernelStart).count() << " ms" << std::endl;
+	}
+}
@@ -4,8 +4,14 @@
 #include <functional>
 #include <algorithm>
 #include <thread>
+#include <map>
+#include <memory>
+#include <condition_variable>
 #include <concurrentqueue.h> //https://github.com/cameron314/concurrentqueue
+#include "BoundedBlockingQueue.h"
+#include "BgzfWriter.h"
 #include <google/protobuf/util/json_util.h>
+#include <google/protobuf/util/type_resolver_util.h>
 #include "Aligner.h"
 #include "CommonUtils.h"
 #include "vg.pb.h"
@@ -19,6 +25,7 @@
 #include "MinimizerSeeder.h"
 #include "AlignmentSelection.h"
 #include "DiploidHeuristic.h"
+#include "SeedingKernel.h"
 
 struct Seeder
 {
@@ -124,7 +131,9 @@ struct AlignmentStats
 	bpInAlignments(0),
 	bpInFullAlignments(0),
 	allAlignmentsCount(0),
-	assertionBroke(false)
+	assertionBroke(false),
+	outOfReadsTime(),
+	helpAfterReadsMicroseconds()
 	{
 	}
 	std::atomic<size_t> reads;
@@ -142,6 +151,9 @@ struct AlignmentStats
 	std::atomic<size_t> bpInFullAlignments;
 	std::atomic<size_t> allAlignmentsCount;
 	std::atomic<bool> assertionBroke;
+	// per thread, when it ran out of reads and how long it then spent on the other threads' clusters
+	std::vector<std::chrono::steady_clock::time_point> outOfReadsTime;
+	std::vector<uint64_t> helpAfterReadsMicroseconds;
 };
 
 bool is_file_exist(std::string fileName)
@@ -169,33 +181,213 @@ void replaceDigraphNodeIdsWithOriginalNodeIds(vg::Alignment& alignment, const Al
 	}
 }
 
-void readFastqs(const std::vector<std::string>& filenames, moodycamel::ConcurrentQueue<std::shared_ptr<FastQ>>& writequeue, std::atomic<bool>& readStreamingFinished)
+struct ReadBatch
+{
+	size_t batchNumber;
+	std::vector<FastQ*> reads;
+};
+
+class OutputArena;
+
+// output of one read batch in one output format
+struct OutputBatch
+{
+	size_t batchNumber;
+	std::string bytes;
+	OutputArena* arena;
+};
+
+// recycles one worker's output buffers so formatting reuses their capacity instead of allocating per batch
+// the writers give the buffers back after writing them, so the arenas must outlive the writer threads
+class OutputArena
+{
+public:
+	// a batch with huge alignments shouldn't pin its memory for the rest of the run
+	static constexpr size_t MaxRetainedCapacity = 16 * 1024 * 1024;
+	OutputArena() :
+		freelist(),
+		allocated(0)
+	{
+	}
+	OutputArena(const OutputArena& other) = delete;
+	OutputArena& operator=(const OutputArena& other) = delete;
+	~OutputArena()
+	{
+		OutputBatch* batch;
+		while (freelist.try_dequeue(batch))
+		{
+			delete batch;
+			allocated -= 1;
+		}
+		assert(allocated == 0);
+	}
+	OutputBatch* Acquire(size_t batchNumber)
+	{
+		OutputBatch* result;
+		if (!freelist.try_dequeue(result))
+		{
+			result = new OutputBatch;
+			result->arena = this;
+			allocated += 1;
+		}
+		assert(result->arena == this);
+		assert(result->bytes.size() == 0);
+		result->batchNumber = batchNumber;
+		return result;
+	}
+	void Release(OutputBatch* batch)
+	{
+		assert(batch->arena == this);
+		batch->bytes.clear();
+		if (batch->bytes.capacity() > MaxRetainedCapacity) std::string{}.swap(batch->bytes);
+		freelist.enqueue(batch);
+	}
+private:
+	moodycamel::ConcurrentQueue<OutputBatch*> freelist;
+	std::atomic<size_t> allocated;
+};
+
+// limits how much output the writers hold back while waiting for earlier batches in --ordered-output mode
+// the reader stops handing out new batches while the limit is exceeded, the batches the writers wait for have already been handed out
+class ReorderBufferLimit
+{
+public:
+	ReorderBufferLimit(size_t maxBytes) :
+		mutex(),
+		hasSpace(),
+		maxBytes(maxBytes),
+		bufferedBytes(0),
+		peakBytes(0),
+		peakBatches(0),
+		readerWaitMicroseconds(0),
+		readerWaits(0)
+	{
+	}
+	void WaitForSpace()
+	{
+		std::unique_lock<std::mutex> lock { mutex };
+		if (bufferedBytes <= maxBytes) return;
+		auto waitStart = std::chrono::steady_clock::now();
+		hasSpace.wait(lock, [this]() { return bufferedBytes <= maxBytes; });
+		readerWaitMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - waitStart).count();
+		readerWaits += 1;
+	}
+	void Hold(size_t bytes, size_t heldBatches)
+	{
+		std::lock_guard<std::mutex> lock { mutex };
+		bufferedBytes += bytes;
+		peakBytes = std::max(peakBytes, bufferedBytes);
+		peakBatches = std::max(peakBatches, heldBatches);
+	}
+	void Release(size_t bytes)
+	{
+		std::lock_guard<std::mutex> lock { mutex };
+		assert(bufferedBytes >= bytes);
+		bufferedBytes -= bytes;
+		if (bufferedBytes <= maxBytes) hasSpace.notify_all();
+	}
+	void PrintStats() const
+	{
+		std::cout << "Ordered output: at most " << peakBatches << " batches (" << peakBytes << " bytes) waited for earlier batches, read dispatch was paused " << readerWaits << " times for " << readerWaitMicroseconds / 1000 << "ms" << std::endl;
+	}
+private:
+	std::mutex mutex;
+	std::condition_variable hasSpace;
+	size_t maxBytes;
+	size_t bufferedBytes;
+	size_t peakBytes;
+	size_t peakBatches;
+	uint64_t readerWaitMicroseconds;
+	size_t readerWaits;
+};
+
+void readFastqs(const std::vector<std::string>& filenames, BoundedBlockingQueue<ReadBatch*>& writequeue, FastQPool& readPool, ReorderBufferLimit* reorderLimit, size_t decompressionThreads, size_t batchReads, size_t batchBp, size_t longestFirstWindow)
 {
 	assertSetNoRead("Read streamer");
+	size_t nextBatchNumber = 0;
+	ReadBatch* batch = new ReadBatch;
+	batch->batchNumber = nextBatchNumber++;
+	size_t bpInBatch = 0;
+	// with a window the largest of the last longestFirstWindow batches is handed out first, so that the longest reads don't start last and finish after all other threads are idle
+	// long reads fill a batch by themselves so the batch size in bp is about the time it takes
+	// a batch which is 2*longestFirstWindow batches older than the newest one is handed out regardless of its size, so small batches don't wait until the end of the input
+	std::vector<std::pair<size_t, ReadBatch*>> window;
+	auto heapOrder = [](const std::pair<size_t, ReadBatch*>& left, const std::pair<size_t, ReadBatch*>& right)
+	{
+		if (left.first != right.first) return left.first < right.first;
+		return left.second->batchNumber > right.second->batchNumber;
+	};
+	auto sendBatch = [&writequeue, &window, heapOrder, reorderLimit, longestFirstWindow](ReadBatch* batch, size_t bp)
+	{
+		if (longestFirstWindow > 0)
+		{
+			size_t newestBatchNumber = batch->batchNumber;
+			window.emplace_back(bp, batch);
+			std::push_heap(window.begin(), window.end(), heapOrder);
+			if (window.size() <= longestFirstWindow) return;
+			size_t oldest = 0;
+			for (size_t i = 1; i < window.size(); i++)
+			{
+				if (window[i].second->batchNumber < window[oldest].second->batchNumber) oldest = i;
+			}
+			if (window[oldest].second->batchNumber + 2 * longestFirstWindow <= newestBatchNumber)
+			{
+				batch = window[oldest].second;
+				std::swap(window[oldest], window.back());
+				window.pop_back();
+				std::make_heap(window.begin(), window.end(), heapOrder);
+			}
+			else
+			{
+				std::pop_heap(window.begin(), window.end(), heapOrder);
+				batch = window.back().second;
+				window.pop_back();
+			}
+		}
+		if (reorderLimit != nullptr) reorderLimit->WaitForSpace();
+		writequeue.enqueue(batch);
+	};
 	for (auto filename : filenames)
 	{
-		FastQ::streamFastqFromFile(filename, false, [&writequeue](FastQ& read)
+		FastQ::streamFastqFromFile(filename, false, decompressionThreads, [&readPool, &batch, &bpInBatch, &nextBatchNumber, &sendBatch, batchReads, batchBp](FastQ& read)
 		{
-			std::shared_ptr<FastQ> ptr = std::make_shared<FastQ>();
+			// the parser reuses the swapped-in pooled strings for the next record
+			FastQ* ptr = readPool.acquire();
 			std::swap(*ptr, read);
-			size_t slept = 0;
-			while (writequeue.size_approx() > 200)
+			batch->reads.push_back(ptr);
+			bpInBatch += ptr->sequence.size();
+			if (batch->reads.size() >= batchReads || bpInBatch >= batchBp)
 			{
-				std::this_thread::sleep_for(std::chrono::milliseconds(10));
-				slept++;
-				if (slept > 100) break;
+				sendBatch(batch, bpInBatch);
+				batch = new ReadBatch;
+				batch->batchNumber = nextBatchNumber++;
+				bpInBatch = 0;
 			}
-			writequeue.enqueue(ptr);
 		});
 	}
-	readStreamingFinished = true;
+	if (batch->reads.size() > 0)
+	{
+		sendBatch(batch, bpInBatch);
+	}
+	else
+	{
+		delete batch;
+	}
+	while (window.size() > 0)
+	{
+		std::pop_heap(window.begin(), window.end(), heapOrder);
+		if (reorderLimit != nullptr) reorderLimit->WaitForSpace();
+		writequeue.enqueue(window.back().second);
+		window.pop_back();
+	}
+	writequeue.close();
 }
 
-void consumeBytesAndWrite(const std::string& filename, moodycamel::ConcurrentQueue<std::string*>& writequeue, moodycamel::ConcurrentQueue<std::string*>& deallocqueue, std::atomic<bool>& allThreadsDone, std::atomic<bool>& allWriteDone, bool verboseMode, bool textMode)
+void consumeBytesAndWrite(const std::string& filename, BoundedBlockingQueue<OutputBatch*>& writequeue, ReorderBufferLimit* reorderLimit, std::atomic<bool>& allWriteDone, bool verboseMode, bool textMode, size_t compressionThreads)
 {
 	assertSetNoRead("Writer");
 	auto openmode = std::ios::out;
-	if (!textMode) openmode |= std::ios::binary;
+	if (!textMode || compressionThreads > 0) openmode |= std::ios::binary;
 	std::ofstream outfile { filename, openmode };
 
 	if (!outfile.good())
@@ -204,9 +396,26 @@ void consumeBytesAndWrite(const std::string& filename, moodycamel::ConcurrentQue
 		std::abort();
 	}
 
+	std::unique_ptr<BgzfWriter> compressor;
+	if (compressionThreads > 0) compressor = std::make_unique<BgzfWriter>(outfile, compressionThreads);
+	auto writeBytes = [&outfile, &compressor](const std::string& bytes)
+	{
+		if (compressor != nullptr)
+		{
+			compressor->Write(bytes.data(), bytes.size());
+		}
+		else
+		{
+			outfile.write(bytes.data(), bytes.size());
+		}
+	};
+
 	bool wroteAny = false;
 
-	std::string* alns[100] {};
+	OutputBatch* alns[100] {};
+	// in ordered mode batches are held here until all earlier batches are written
+	std::map<size_t, OutputBatch*> heldBatches;
+	size_t nextBatchNumber = 0;
 
 	BufferedWriter coutoutput;
 	if (verboseMode)
@@ -221,24 +430,46 @@ void consumeBytesAndWrite(const std::string& filename, moodycamel::ConcurrentQue
 			std::cerr << "Cannot write results to file: " << filename << std::endl;
 			std::abort();
 		}
-		size_t gotAlns = writequeue.try_dequeue_bulk(alns, 100);
-		if (gotAlns == 0)
+		size_t gotAlns = writequeue.dequeue_bulk(alns, 100);
+		if (gotAlns == 0) break;
+		coutoutput << "write " << gotAlns << ", " << writequeue.size_approx() << " left" << BufferedWriter::Flush;
+		if (reorderLimit == nullptr)
 		{
-			if (!writequeue.try_dequeue(alns[0]))
+			for (size_t i = 0; i < gotAlns; i++)
 			{
-				if (allThreadsDone) break;
-				std::this_thread::sleep_for(std::chrono::milliseconds(10));
-				continue;
+				writeBytes(alns[i]->bytes);
+				alns[i]->arena->Release(alns[i]);
 			}
-			gotAlns = 1;
+			wroteAny = true;
+			continue;
 		}
-		coutoutput << "write " << gotAlns << ", " << writequeue.size_approx() << " left" << BufferedWriter::Flush;
 		for (size_t i = 0; i < gotAlns; i++)
 		{
-			outfile.write(alns[i]->data(), alns[i]->size());
+			assert(heldBatches.count(alns[i]->batchNumber) == 0);
+			heldBatches[alns[i]->batchNumber] = alns[i];
+			reorderLimit->Hold(alns[i]->bytes.size(), heldBatches.size());
+		}
+		while (heldBatches.size() > 0 && heldBatches.begin()->first == nextBatchNumber)
+		{
+			OutputBatch* write = heldBatches.begin()->second;
+			heldBatches.erase(heldBatches.begin());
+			writeBytes(write->bytes);
+			reorderLimit->Release(write->bytes.size());
+			if (write->bytes.size() > 0) wroteAny = true;
+			write->arena->Release(write);
+			nextBatchNumber += 1;
+		}
+	}
+	assert(heldBatches.size() == 0);
+
+	if (compressor != nullptr)
+	{
+		compressor->Close();
+		if (!outfile.good())
+		{
+			std::cerr << "Cannot write results to file: " << filename << std::endl;
+			std::abort();
 		}
-		deallocqueue.enqueue_bulk(alns, gotAlns);
-		wroteAny = true;
 	}
 
 	if (!textMode && !wroteAny)
@@ -258,82 +489,158 @@ void consumeBytesAndWrite(const std::string& filename, moodycamel::ConcurrentQue
 	allWriteDone = true;
 }
 
-void QueueInsertSlowly(moodycamel::ProducerToken& token, moodycamel::ConcurrentQueue<std::string*>& queue, std::string&& str)
+template <typename T>
+void printQueueWaitStats(const std::string& name, const BoundedBlockingQueue<T>& queue)
+{
+	std::cout << name << ": producers waited " << queue.ProducerWaitMicroseconds() / 1000 << "ms while full (" << queue.FullWaits() << " times), consumers waited " << queue.ConsumerWaitMicroseconds() / 1000 << "ms while empty (" << queue.EmptyWaits() << " times)" << std::endl;
+}
+
+// how long the threads were idle at the end of the run after they ran out of reads, waiting for the slowest thread
+void printTailIdleStats(const AlignmentStats& stats, std::chrono::steady_clock::time_point alignmentEnd, bool verboseMode)
 {
-	std::string* write = new std::string { std::move(str) };
-	size_t waited = 0;
-	while (!queue.try_enqueue(token, write) && !queue.try_enqueue(token, write))
+	uint64_t maxIdleMicroseconds = 0;
+	uint64_t totalIdleMicroseconds = 0;
+	for (size_t i = 0; i < stats.outOfReadsTime.size(); i++)
 	{
-		if (queue.size_approx() < 100 && queue.enqueue(token, write)) break;
-		std::this_thread::sleep_for(std::chrono::milliseconds(10));
-		waited++;
-		if (waited >= 10)
+		uint64_t tailMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(alignmentEnd - stats.outOfReadsTime[i]).count();
+		uint64_t idleMicroseconds = tailMicroseconds - std::min(tailMicroseconds, stats.helpAfterReadsMicroseconds[i]);
+		maxIdleMicroseconds = std::max(maxIdleMicroseconds, idleMicroseconds);
+		totalIdleMicroseconds += idleMicroseconds;
+		if (verboseMode) std::cout << "Thread " << i << " idle for " << idleMicroseconds / 1000 << "ms at the end, aligned other threads' clusters for " << stats.helpAfterReadsMicroseconds[i] / 1000 << "ms" << std::endl;
+	}
+	std::cout << "Tail idle time: " << totalIdleMicroseconds / 1000 << "ms in total, at most " << maxIdleMicroseconds / 1000 << "ms per thread" << std::endl;
+}
+
+// collects one worker's output for a batch of reads so that each batch is a single queue item
+// the output is formatted directly into a buffer from the worker's arena
+class BatchOutput
+{
+public:
+	BatchOutput(BoundedBlockingQueue<OutputBatch*>& queue, OutputArena& arena, bool active, bool ordered) :
+		queue(queue),
+		token(queue.Underlying()),
+		arena(arena),
+		current(nullptr),
+		active(active),
+		ordered(ordered),
+		scratch(),
+		rawOut(),
+		gzipOut(),
+		codedOut()
+	{
+		if (active) current = arena.Acquire(0);
+	}
+	BatchOutput(const BatchOutput& other) = delete;
+	BatchOutput& operator=(const BatchOutput& other) = delete;
+	~BatchOutput()
+	{
+		closeGzipStream();
+		if (current != nullptr) arena.Release(current);
+	}
+	std::string& Buffer()
+	{
+		assert(current != nullptr);
+		return current->bytes;
+	}
+	// reused between reads so that formatting a read doesn't allocate
+	std::string& Scratch()
+	{
+		return scratch;
+	}
+	// compresses into the buffer. The batch is one gzip member, which is closed when the batch is sent
+	::google::protobuf::io::CodedOutputStream& GzipStream()
+	{
+		assert(current != nullptr);
+		if (codedOut == nullptr)
 		{
-			if (queue.enqueue(token, write)) break;
+			rawOut = std::make_unique<::google::protobuf::io::StringOutputStream>(&current->bytes);
+			gzipOut = std::make_unique<::google::protobuf::io::GzipOutputStream>(rawOut.get());
+			codedOut = std::make_unique<::google::protobuf::io::CodedOutputStream>(gzipOut.get());
 		}
+		return *codedOut;
 	}
-}
+	// in ordered mode empty batches are sent too so the writer knows not to wait for them
+	void Flush(size_t batchNumber)
+	{
+		if (!active) return;
+		closeGzipStream();
+		if (current->bytes.size() == 0 && !ordered) return;
+		current->batchNumber = batchNumber;
+		queue.enqueue(token, current);
+		current = arena.Acquire(batchNumber + 1);
+	}
+private:
+	void closeGzipStream()
+	{
+		// each stream writes its remaining bytes into the next one when destroyed
+		codedOut.reset();
+		gzipOut.reset();
+		rawOut.reset();
+	}
+	BoundedBlockingQueue<OutputBatch*>& queue;
+	moodycamel::ProducerToken token;
+	OutputArena& arena;
+	OutputBatch* current;
+	bool active;
+	bool ordered;
+	std::string scratch;
+	std::unique_ptr<::google::protobuf::io::StringOutputStream> rawOut;
+	std::unique_ptr<::google::protobuf::io::GzipOutputStream> gzipOut;
+	std::unique_ptr<::google::protobuf::io::CodedOutputStream> codedOut;
+};
 
-void writeGAMToQueue(moodycamel::ProducerToken& token, const AlignerParams& params, moodycamel::ConcurrentQueue<std::string*>& alignmentsOut, const AlignmentResult& alignments)
+void writeGAMToBatch(BatchOutput& alignmentsOut, const AlignerParams& params, const AlignmentResult& alignments)
 {
-	std::stringstream strstr;
-	::google::protobuf::io::ZeroCopyOutputStream *raw_out = new ::google::protobuf::io::OstreamOutputStream(&strstr);
-	::google::protobuf::io::GzipOutputStream *gzip_out = new ::google::protobuf::io::GzipOutputStream(raw_out);
-	::google::protobuf::io::CodedOutputStream *coded_out = new ::google::protobuf::io::CodedOutputStream(gzip_out);
-	coded_out->WriteVarint64(alignments.alignments.size());
+	// each batch is its own gzip member, concatenated members are still a valid GAM stream
+	::google::protobuf::io::CodedOutputStream& coded_out = alignmentsOut.GzipStream();
+	coded_out.WriteVarint64(alignments.alignments.size());
 	for (size_t i = 0; i < alignments.alignments.size(); i++)
 	{
 		assert(!alignments.alignments[i].alignmentFailed());
 		assert(alignments.alignments[i].alignment != nullptr);
-		std::string s;
-		alignments.alignments[i].alignment->SerializeToString(&s);
-		coded_out->WriteVarint32(s.size());
-		coded_out->WriteRaw(s.data(), s.size());
+		const vg::Alignment& alignment = *alignments.alignments[i].alignment;
+		coded_out.WriteVarint32(alignment.ByteSizeLong());
+		alignment.SerializeWithCachedSizes(&coded_out);
 	}
-	delete coded_out;
-	delete gzip_out;
-	delete raw_out;
-	QueueInsertSlowly(token, alignmentsOut, strstr.str());
 }
 
-void writeJSONToQueue(moodycamel::ProducerToken& token, const AlignerParams& params, moodycamel::ConcurrentQueue<std::string*>& alignmentsOut, const AlignmentResult& alignments)
+void writeJSONToBatch(BatchOutput& alignmentsOut, const AlignerParams& params, const AlignmentResult& alignments)
 {
-	std::stringstream strstr;
+	// MessageToJsonString does the same but allocates the binary message and the json string for each alignment
+	static const std::unique_ptr<google::protobuf::util::TypeResolver> resolver { google::protobuf::util::NewTypeResolverForDescriptorPool("type.googleapis.com", google::protobuf::DescriptorPool::generated_pool()) };
+	static const std::string typeUrl = "type.googleapis.com/" + vg::Alignment::descriptor()->full_name();
+	std::string& buffer = alignmentsOut.Buffer();
+	std::string& binary = alignmentsOut.Scratch();
 	google::protobuf::util::JsonPrintOptions options;
 	options.preserve_proto_field_names = true;
 	for (size_t i = 0; i < alignments.alignments.size(); i++)
 	{
 		assert(!alignments.alignments[i].alignmentFailed());
 		assert(alignments.alignments[i].alignment != nullptr);
-		std::string s;
-		google::protobuf::util::MessageToJsonString(*alignments.alignments[i].alignment, &s, options);
-		strstr << s;
-		strstr << '\n';
+		alignments.alignments[i].alignment->SerializeToString(&binary);
+		{
+			::google::protobuf::io::ArrayInputStream input { binary.data(), (int)binary.size() };
+			::google::protobuf::io::StringOutputStream output { &buffer };
+			google::protobuf::util::BinaryToJsonStream(resolver.get(), typeUrl, &input, &output, options);
+		}
+		buffer += '\n';
 	}
-	QueueInsertSlowly(token, alignmentsOut, strstr.str());
 }
 
-void writeGAFToQueue(moodycamel::ProducerToken& token, const AlignerParams& params, moodycamel::ConcurrentQueue<std::string*>& alignmentsOut, const AlignmentResult& alignments)
+void writeGAFToBatch(BatchOutput& alignmentsOut, const AlignerParams& params, const AlignmentResult& alignments)
 {
-	std::stringstream strstr;
+	std::string& buffer = alignmentsOut.Buffer();
 	for (size_t i = 0; i < alignments.alignments.size(); i++)
 	{
 		assert(!alignments.alignments[i].alignmentFailed());
 		assert(alignments.alignments[i].GAFline.size() > 0);
-		strstr << alignments.alignments[i].GAFline;
-		strstr << '\n';
+		buffer += alignments.alignments[i].GAFline;
+		buffer += '\n';
 	}
-	QueueInsertSlowly(token, alignmentsOut, strstr.str());
 }
 
-void writeCorrectedToQueue(moodycamel::ProducerToken& token, const AlignerParams& params, const std::string& readName, const std::string& original, moodycamel::ConcurrentQueue<std::string*>& correctedOut, const AlignmentResult& alignments)
+void writeCorrectedToBatch(BatchOutput& correctedOut, const AlignerParams& params, const std::string& readName, const std::string& original, const AlignmentResult& alignments)
 {
-	std::stringstream strstr;
-	zstr::ostream *compressed = nullptr;
-	if (params.compressCorrected)
-	{
-		compressed = new zstr::ostream(strstr);
-	}
 	std::vector<Correction> corrections;
 	for (size_t i = 0; i < alignments.alignments.size(); i++)
 	{
@@ -346,48 +653,28 @@ void writeCorrectedToQueue(moodycamel::ProducerToken& token, const AlignerParams
 	}
 	std::sort(corrections.begin(), corrections.end(), [](const Correction& left, const Correction& right) { return left.startIndex < right.startIndex; });
 	std::string corrected = getCorrected(original, corrections, 1000); // todo better maxOverlap?
-	if (compressed != nullptr)
-	{
-		(*compressed) << ">" << readName << std::endl;
-		(*compressed) << corrected << std::endl;
-		delete compressed;
-	}
-	else
-	{
-		strstr << ">" << readName << std::endl;
-		strstr << corrected << std::endl;
-	}
-	QueueInsertSlowly(token, correctedOut, strstr.str());
+	// compression, if any, is done by the writer
+	std::string& buffer = correctedOut.Buffer();
+	buffer += ">";
+	buffer += readName;
+	buffer += "\n";
+	buffer += corrected;
+	buffer += "\n";
 }
 
-void writeCorrectedClippedToQueue(moodycamel::ProducerToken& token, const AlignerParams& params, moodycamel::ConcurrentQueue<std::string*>& correctedClippedOut, const AlignmentResult& alignments)
+void writeCorrectedClippedToBatch(BatchOutput& correctedClippedOut, const AlignerParams& params, const AlignmentResult& alignments)
 {
-	std::stringstream strstr;
-	zstr::ostream *compressed = nullptr;
-	if (params.compressClipped)
-	{
-		compressed = new zstr::ostream(strstr);
-	}
+	std::string& buffer = correctedClippedOut.Buffer();
 	for (size_t i = 0; i < alignments.alignments.size(); i++)
 	{
 		assert(!alignments.alignments[i].alignmentFailed());
 		assert(alignments.alignments[i].corrected.size() > 0);
-		if (compressed != nullptr)
-		{
-			(*compressed) << ">" << alignments.readName << "_" << i << "_" << alignments.alignments[i].alignmentStart << "_" << alignments.alignments[i].alignmentEnd << std::endl;
-			(*compressed) << alignments.alignments[i].corrected << std::endl;
-		}
-		else
-		{
-			strstr << ">" << alignments.readName << "_" << i << "_" << alignments.alignments[i].alignmentStart << "_" << alignments.alignments[i].alignmentEnd << std::endl;
-			strstr << alignments.alignments[i].corrected << std::endl;
-		}
+		buffer += ">";
+		buffer += alignments.readName;
+		buffer += "_" + std::to_string(i) + "_" + std::to_string(alignments.alignments[i].alignmentStart) + "_" + std::to_string(alignments.alignments[i].alignmentEnd) + "\n";
+		buffer += alignments.alignments[i].corrected;
+		buffer += "\n";
 	}
-	if (compressed != nullptr)
-	{
-		delete compressed;
-	}
-	QueueInsertSlowly(token, correctedClippedOut, strstr.str());
 }
 
 std::string hpcCollapse(const std::string& read)
@@ -404,7 +691,8 @@ std::string hpcCollapse(const std::string& read)
 	return result;
 }
 
-void setForbiddenNodes(GraphAlignerCommon<size_t, int64_t, uint64_t>::AlignerGraphsizedState& reusableState, const DiploidHeuristicSplitter& diploidHeuristic, const std::string& sequence)
+template <typename ReusableState>
+void setForbiddenNodes(ReusableState& reusableState, const DiploidHeuristicSplitter& diploidHeuristic, const std::string& sequence)
 {
 	for (std::tuple<size_t, int, int> t : diploidHeuristic.getForbiddenNodes(sequence))
 	{
@@ -412,20 +700,22 @@ void setForbiddenNodes(GraphAlignerCommon<size_t, int64_t, uint64_t>::AlignerGra
 	}
 }
 
-void unsetForbiddenNodes(GraphAlignerCommon<size_t, int64_t, uint64_t>::AlignerGraphsizedState& reusableState, const DiploidHeuristicSplitter& diploidHeuristic, const std::string& sequence)
+template <typename ReusableState>
+void unsetForbiddenNodes(ReusableState& reusableState, const DiploidHeuristicSplitter& diploidHeuristic, const std::string& sequence)
 {
 	reusableState.bigraphNodeForbiddenSpans.clear();
 }
 
-void filterOutWrongHaplotypeSeeds(std::vector<SeedHit>& seeds, const GraphAlignerCommon<size_t, int64_t, uint64_t>::AlignerGraphsizedState& reusableState)
+template <typename ReusableState>
+void filterOutWrongHaplotypeSeeds(std::vector<SeedHit>& seeds, const ReusableState& reusableState, size_t sliceSize)
 {
 	phmap::flat_hash_map<size_t, std::vector<std::pair<int, int>>> forbiddenSpans;
 	for (auto t : reusableState.bigraphNodeForbiddenSpans)
 	{
 		size_t roundedStart = 0;
 		size_t roundedEnd = 0;
-		if (std::get<1>(t) > 0) roundedStart = (std::get<1>(t) / 64) * 64;
-		if (std::get<2>(t) > 0) roundedEnd = ((std::get<2>(t) + 63) / 64) * 64;
+		if (std::get<1>(t) > 0) roundedStart = (std::get<1>(t) / sliceSize) * sliceSize;
+		if (std::get<2>(t) > 0) roundedEnd = ((std::get<2>(t) + sliceSize - 1) / sliceSize) * sliceSize;
 		forbiddenSpans[std::get<0>(t)].emplace_back(roundedStart, roundedEnd);
 	}
 	for (size_t i = seeds.size()-1; i < seeds.size(); i--)
@@ -447,15 +737,16 @@ void filterOutWrongHaplotypeSeeds(std::vector<SeedHit>& seeds, const GraphAligne
 	}
 }
 
-void runComponentMappings(const AlignmentGraph& alignmentGraph, const DiploidHeuristicSplitter& diploidHeuristic, moodycamel::ConcurrentQueue<std::shared_ptr<FastQ>>& readFastqsQueue, std::atomic<bool>& readStreamingFinished, int threadnum, const Seeder& seeder, AlignerParams params, moodycamel::ConcurrentQueue<std::string*>& GAMOut, moodycamel::ConcurrentQueue<std::string*>& JSONOut, moodycamel::ConcurrentQueue<std::string*>& GAFOut, moodycamel::ConcurrentQueue<std::string*>& correctedOut, moodycamel::ConcurrentQueue<std::string*>& correctedClippedOut, moodycamel::ConcurrentQueue<std::string*>& deallocqueue, AlignmentStats& stats)
+template <typename ReusableState>
+void runComponentMappings(const AlignmentGraph& alignmentGraph, const DiploidHeuristicSplitter& diploidHeuristic, BoundedBlockingQueue<ReadBatch*>& readFastqsQueue, FastQPool& readPool, int threadnum, const Seeder& seeder, AlignerParams params, BoundedBlockingQueue<OutputBatch*>& GAMOut, BoundedBlockingQueue<OutputBatch*>& JSONOut, BoundedBlockingQueue<OutputBatch*>& GAFOut, BoundedBlockingQueue<OutputBatch*>& correctedOut, BoundedBlockingQueue<OutputBatch*>& correctedClippedOut, OutputArena& outputArena, AlignmentStats& stats, WorkStealingPool<ReusableState>& clusterPool)
 {
-	moodycamel::ProducerToken GAMToken { GAMOut };
-	moodycamel::ProducerToken JSONToken { JSONOut };
-	moodycamel::ProducerToken GAFToken { GAFOut };
-	moodycamel::ProducerToken correctedToken { correctedOut };
-	moodycamel::ProducerToken clippedToken { correctedClippedOut };
+	BatchOutput GAMBatch { GAMOut, outputArena, params.outputGAMFile != "", params.orderedOutput };
+	BatchOutput JSONBatch { JSONOut, outputArena, params.outputJSONFile != "", params.orderedOutput };
+	BatchOutput GAFBatch { GAFOut, outputArena, params.outputGAFFile != "", params.orderedOutput };
+	BatchOutput correctedBatch { correctedOut, outputArena, params.outputCorrectedFile != "", params.orderedOutput };
+	BatchOutput clippedBatch { correctedClippedOut, outputArena, params.outputCorrectedClippedFile != "", params.orderedOutput };
 	assertSetNoRead("Before any read");
-	GraphAlignerCommon<size_t, int64_t, uint64_t>::AlignerGraphsizedState reusableState { alignmentGraph, params.alignmentBandwidth };
+	ReusableState reusableState { alignmentGraph, params.alignmentBandwidth };
 	AlignmentSelection::SelectionOptions selectionOptions;
 	selectionOptions.graphSize = alignmentGraph.SizeInBP();
 	selectionOptions.ECutoff = params.selectionECutoff;
@@ -469,21 +760,29 @@ void runComponentMappings(const AlignmentGraph& alignmentGraph, const DiploidHeu
 		cerroutput = {std::cerr};
 		coutoutput = {std::cout};
 	}
+	ReadBatch* batch = nullptr;
+	size_t batchIndex = 0;
 	while (true)
 	{
-		std::string* dealloc;
-		while (deallocqueue.try_dequeue(dealloc))
-		{
-			delete dealloc;
-		}
-		std::shared_ptr<FastQ> fastq = nullptr;
-		while (fastq == nullptr && !readFastqsQueue.try_dequeue(fastq))
+		if (batch == nullptr || batchIndex == batch->reads.size())
 		{
-			bool tryBreaking = readStreamingFinished;
-			if (!readFastqsQueue.try_dequeue(fastq) && tryBreaking) break;
-			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			// all reads of the previous batch are done, so its output goes to the writers as one item per format
+			if (batch != nullptr)
+			{
+				GAMBatch.Flush(batch->batchNumber);
+				JSONBatch.Flush(batch->batchNumber);
+				GAFBatch.Flush(batch->batchNumber);
+				correctedBatch.Flush(batch->batchNumber);
+				clippedBatch.Flush(batch->batchNumber);
+			}
+			delete batch;
+			batch = nullptr;
+			batchIndex = 0;
+			if (!readFastqsQueue.dequeue(batch)) break;
 		}
-		if (fastq == nullptr) break;
+		// returned to the pool when the read is done
+		FastQPool::Handle fastq = readPool.wrap(batch->reads[batchIndex]);
+		batchIndex += 1;
 		if (!params.keepSequenceNameTags)
 		{
 			fastq->seq_id = fastq->seq_id.substr(0, fastq->seq_id.find_first_of(" \t\r\n"));
@@ -514,7 +813,7 @@ void runComponentMappings(const AlignmentGraph& alignmentGraph, const DiploidHeu
 					setForbiddenNodes(reusableState, diploidHeuristic, fastq->sequence);
 				}
 				std::vector<SeedHit> seeds = seeder.getSeeds(fastq->seq_id, fastq->sequence);
-				if (params.useDiploidHeuristic) filterOutWrongHaplotypeSeeds(seeds, reusableState);
+				if (params.useDiploidHeuristic) filterOutWrongHaplotypeSeeds(seeds, reusableState, params.DPWordBits);
 				auto timeEnd = std::chrono::system_clock::now();
 				size_t time = std::chrono::duration_cast<std::chrono::milliseconds>(timeEnd - timeStart).count();
 				coutoutput << "Read " << fastq->seq_id << " seeding took " << time << "ms" << BufferedWriter::Flush;
@@ -525,7 +824,7 @@ void runComponentMappings(const AlignmentGraph& alignmentGraph, const DiploidHeu
 					cerroutput << "Read " << fastq->seq_id << " has no seed hits" << BufferedWriter::Flush;
 					coutoutput << "Read " << fastq->seq_id << " alignment failed" << BufferedWriter::Flush;
 					cerroutput << "Read " << fastq->seq_id << " alignment failed" << BufferedWriter::Flush;
-					if (params.outputCorrectedFile != "") writeCorrectedToQueue(correctedToken, params, fastq->seq_id, fastq->sequence, correctedOut, alignments);
+					if (params.outputCorrectedFile != "") writeCorrectedToBatch(correctedBatch, params, fastq->seq_id, fastq->sequence, alignments);
 					continue;
 				}
 				auto clusterTimeStart = std::chrono::system_clock::now();
@@ -550,7 +849,7 @@ void runComponentMappings(const AlignmentGraph& alignmentGraph, const DiploidHeu
 					cerroutput << "Read " << fastq->seq_id << " has no seed clusters" << BufferedWriter::Flush;
 					coutoutput << "Read " << fastq->seq_id << " alignment failed" << BufferedWriter::Flush;
 					cerroutput << "Read " << fastq->seq_id << " alignment failed" << BufferedWriter::Flush;
-					if (params.outputCorrectedFile != "") writeCorrectedToQueue(correctedToken, params, fastq->seq_id, fastq->sequence, correctedOut, alignments);
+					if (params.outputCorrectedFile != "") writeCorrectedToBatch(correctedBatch, params, fastq->seq_id, fastq->sequence, alignments);
 					continue;
 				}
 				stats.seedsFound += seeds.size();
@@ -562,7 +861,14 @@ void runComponentMappings(const AlignmentGraph& alignmentGraph, const DiploidHeu
 				{
 					paddedSequence += '-';
 				}
-				alignments = AlignClusters(alignmentGraph, fastq->seq_id, paddedSequence, params.alignmentBandwidth, params.maxCellsPerSlice, !params.verboseMode, processedSeeds, reusableState, params.preciseClippingIdentityCutoff, params.Xdropcutoff, params.multimapScoreFraction, params.clipAmbiguousEnds, params.maxTraceCount);
+				if (params.parallelClusters && processedSeeds.size() > 1)
+				{
+					alignments = AlignClustersParallel(alignmentGraph, fastq->seq_id, paddedSequence, params.alignmentBandwidth, params.maxCellsPerSlice, !params.verboseMode, processedSeeds, reusableState, clusterPool, threadnum, params.preciseClippingIdentityCutoff, params.Xdropcutoff, params.multimapScoreFraction, params.clipAmbiguousEnds, params.maxTraceCount, params.maxDPTableBytes);
+				}
+				else
+				{
+					alignments = AlignClusters(alignmentGraph, fastq->seq_id, paddedSequence, params.alignmentBandwidth, params.maxCellsPerSlice, !params.verboseMode, processedSeeds, reusableState, params.preciseClippingIdentityCutoff, params.Xdropcutoff, params.multimapScoreFraction, params.clipAmbiguousEnds, params.maxTraceCount, params.maxDPTableBytes);
+				}
 				AlignmentSelection::RemoveDuplicateAlignments(alignmentGraph, alignments.alignments);
 				AlignmentSelection::AddMappingQualities(alignments.alignments);
 				auto alntimeEnd = std::chrono::system_clock::now();
@@ -575,7 +881,7 @@ void runComponentMappings(const AlignmentGraph& alignmentGraph, const DiploidHeu
 			else
 			{
 				auto alntimeStart = std::chrono::system_clock::now();
-				alignments = AlignOneWay(alignmentGraph, fastq->seq_id, fastq->sequence, params.alignmentBandwidth, !params.verboseMode, reusableState, params.preciseClippingIdentityCutoff, params.Xdropcutoff, params.DPRestartStride, params.clipAmbiguousEnds);
+				alignments = AlignOneWay(alignmentGraph, fastq->seq_id, fastq->sequence, params.alignmentBandwidth, !params.verboseMode, reusableState, params.preciseClippingIdentityCutoff, params.Xdropcutoff, params.DPRestartStride, params.clipAmbiguousEnds, params.maxDPTableBytes);
 				auto alntimeEnd = std::chrono::system_clock::now();
 				alntimems = std::chrono::duration_cast<std::chrono::milliseconds>(alntimeEnd - alntimeStart).count();
 			}
@@ -601,7 +907,7 @@ void runComponentMappings(const AlignmentGraph& alignmentGraph, const DiploidHeu
 			cerroutput << "Read " << fastq->seq_id << " alignment failed" << BufferedWriter::Flush;
 			try
 			{
-				if (params.outputCorrectedFile != "") writeCorrectedToQueue(correctedToken, params, fastq->seq_id, fastq->sequence, correctedOut, alignments);
+				if (params.outputCorrectedFile != "") writeCorrectedToBatch(correctedBatch, params, fastq->seq_id, fastq->sequence, alignments);
 			}
 			catch (const ThreadReadAssertion::AssertionFailure& a)
 			{
@@ -677,11 +983,11 @@ void runComponentMappings(const AlignmentGraph& alignmentGraph, const DiploidHeu
 
 		try
 		{
-			if (params.outputGAMFile != "") writeGAMToQueue(GAMToken, params, GAMOut, alignments);
-			if (params.outputJSONFile != "") writeJSONToQueue(JSONToken, params, JSONOut, alignments);
-			if (params.outputGAFFile != "") writeGAFToQueue(GAFToken, params, GAFOut, alignments);
-			if (params.outputCorrectedFile != "") writeCorrectedToQueue(correctedToken, params, fastq->seq_id, fastq->sequence, correctedOut, alignments);
-			if (params.outputCorrectedClippedFile != "") writeCorrectedClippedToQueue(clippedToken, params, correctedClippedOut, alignments);
+			if (params.outputGAMFile != "") writeGAMToBatch(GAMBatch, params, alignments);
+			if (params.outputJSONFile != "") writeJSONToBatch(JSONBatch, params, alignments);
+			if (params.outputGAFFile != "") writeGAFToBatch(GAFBatch, params, alignments);
+			if (params.outputCorrectedFile != "") writeCorrectedToBatch(correctedBatch, params, fastq->seq_id, fastq->sequence, alignments);
+			if (params.outputCorrectedClippedFile != "") writeCorrectedClippedToBatch(clippedBatch, params, alignments);
 		}
 		catch (const ThreadReadAssertion::AssertionFailure& a)
 		{
@@ -691,11 +997,14 @@ void runComponentMappings(const AlignmentGraph& alignmentGraph, const DiploidHeu
 		}
 
 	}
+	stats.outOfReadsTime[threadnum] = std::chrono::steady_clock::now();
+	// keep aligning the other threads' clusters until they are all done
+	if (params.parallelClusters) stats.helpAfterReadsMicroseconds[threadnum] = clusterPool.finish(threadnum, reusableState);
 	assertSetNoRead("After all reads");
 	coutoutput << "Thread " << threadnum << " finished" << BufferedWriter::Flush;
 }
 
-AlignmentGraph getGraph(std::string graphFile, MEMSeeder** mxmSeeder, const AlignerParams& params)
+AlignmentGraph buildGraph(std::string graphFile, MEMSeeder** mxmSeeder, const AlignerParams& params)
 {
 	bool loadMxmSeeder = params.mumCount > 0 || params.memCount > 0;
 	if (is_file_exist(graphFile)){
@@ -728,7 +1037,7 @@ AlignmentGraph getGraph(std::string graphFile, MEMSeeder** mxmSeeder, const Alig
 		}
 		else if (graphFile.substr(graphFile.size() - 4) == ".gfa" || (graphFile.size() > 7 && graphFile.substr(graphFile.size() - 7) == ".gfa.gz"))
 		{
-			auto graph = GfaGraph::LoadFromFile(graphFile);
+			auto graph = GfaGraph::LoadFromFile(graphFile, params.numThreads);
 			if (loadMxmSeeder)
 			{
 				std::cout << "Build MUM/MEM seeder from the graph" << std::endl;
@@ -752,6 +1061,37 @@ AlignmentGraph getGraph(std::string graphFile, MEMSeeder** mxmSeeder, const Alig
 	}
 }
 
+AlignmentGraph getGraph(std::string graphFile, MEMSeeder** mxmSeeder, const AlignerParams& params)
+{
+	bool loadMxmSeeder = params.mumCount > 0 || params.memCount > 0;
+	if (params.graphIndexFile != "" && is_file_exist(params.graphIndexFile))
+	{
+		if (loadMxmSeeder)
+		{
+			std::cout << "MUM/MEM seeding needs the input graph, not using graph index " << params.graphIndexFile << std::endl;
+			return buildGraph(graphFile, mxmSeeder, params);
+		}
+		std::cout << "Load alignment graph from index " << params.graphIndexFile << std::endl;
+		try
+		{
+			return AlignmentGraph::LoadFromFile(params.graphIndexFile, graphFile);
+		}
+		catch (const CommonUtils::InvalidGraphException& e)
+		{
+			std::cerr << "Error in the graph index: " << e.what() << std::endl;
+			std::cerr << "Remove the old graph index " << params.graphIndexFile << " and rerun" << std::endl;
+			std::exit(1);
+		}
+	}
+	auto result = buildGraph(graphFile, mxmSeeder, params);
+	if (params.graphIndexFile != "")
+	{
+		std::cout << "Save alignment graph index to " << params.graphIndexFile << std::endl;
+		result.SaveToFile(params.graphIndexFile, graphFile);
+	}
+	return result;
+}
+
 std::unordered_map<std::string, std::vector<SeedHit>> loadGafSeeds(const AlignmentGraph& alignmentGraph, const std::string& gafFile)
 {
 	std::unordered_map<std::string, size_t> nodeNameMap;
@@ -871,8 +1211,31 @@ void alignReads(AlignerParams params)
 	MinimizerSeeder* minimizerseeder = nullptr;
 	if (loadMinimizerSeeder)
 	{
-		std::cout << "Build minimizer seeder from the graph" << std::endl;
-		minimizerseeder = new MinimizerSeeder(alignmentGraph, params.minimizerLength, params.minimizerWindowSize, params.numThreads, 1.0 - params.minimizerDiscardMostNumerousFraction);
+		if (params.minimizerIndexFile != "" && is_file_exist(params.minimizerIndexFile))
+		{
+			std::cout << "Load minimizer index from " << params.minimizerIndexFile << std::endl;
+			try
+			{
+				minimizerseeder = new MinimizerSeeder(alignmentGraph, params.minimizerIndexFile, params.minimizerLength, params.minimizerWindowSize, 1.0 - params.minimizerDiscardMostNumerousFraction, params.minimizerHashTable);
+			}
+			catch (const CommonUtils::InvalidGraphException& e)
+			{
+				std::cerr << "Error in the minimizer index: " << e.what() << std::endl;
+				std::cerr << "Remove the old minimizer index " << params.minimizerIndexFile << " and rerun" << std::endl;
+				std::exit(1);
+			}
+		}
+		else
+		{
+			std::cout << "Build minimizer seeder from the graph" << std::endl;
+			if (params.indexMemoryLimit > 0) std::cout << "Minimizer index construction memory limit " << params.indexMemoryLimit / 1024 / 1024 << "MB" << std::endl;
+			minimizerseeder = new MinimizerSeeder(alignmentGraph, params.minimizerLength, params.minimizerWindowSize, params.numThreads, 1.0 - params.minimizerDiscardMostNumerousFraction, params.minimizerHashTable, params.indexMemoryLimit);
+			if (params.minimizerIndexFile != "")
+			{
+				std::cout << "Save minimizer index to " << params.minimizerIndexFile << std::endl;
+				minimizerseeder->saveTo(params.minimizerIndexFile);
+			}
+		}
 		if (!minimizerseeder->canSeed())
 		{
 			std::cout << "Warning: Minimizer seeder has no seed hits. Reads cannot be aligned. Try unchopping the graph with vg or a different seeding mode" << std::endl;
@@ -954,42 +1317,67 @@ void alignReads(AlignerParams params)
 
 	assertSetNoRead("Running alignments");
 
-	moodycamel::ConcurrentQueue<std::string*> outputGAM { 50, params.numThreads, params.numThreads };
-	moodycamel::ConcurrentQueue<std::string*> outputGAF { 50, params.numThreads, params.numThreads };
-	moodycamel::ConcurrentQueue<std::string*> outputJSON { 50, params.numThreads, params.numThreads };
-	moodycamel::ConcurrentQueue<std::string*> deallocAlns;
-	moodycamel::ConcurrentQueue<std::string*> outputCorrected { 50, params.numThreads, params.numThreads };
-	moodycamel::ConcurrentQueue<std::string*> outputCorrectedClipped { 50, params.numThreads, params.numThreads };
-	moodycamel::ConcurrentQueue<std::shared_ptr<FastQ>> readFastqsQueue;
-	std::atomic<bool> readStreamingFinished { false };
-	std::atomic<bool> allThreadsDone { false };
+	// declared before the writer queues since the writers return the output buffers to the workers' arenas
+	std::vector<std::unique_ptr<OutputArena>> outputArenas;
+	for (size_t i = 0; i < params.numThreads; i++) outputArenas.emplace_back(std::make_unique<OutputArena>());
+	BoundedBlockingQueue<OutputBatch*> outputGAM { 100, params.numThreads };
+	BoundedBlockingQueue<OutputBatch*> outputGAF { 100, params.numThreads };
+	BoundedBlockingQueue<OutputBatch*> outputJSON { 100, params.numThreads };
+	BoundedBlockingQueue<OutputBatch*> outputCorrected { 100, params.numThreads };
+	BoundedBlockingQueue<OutputBatch*> outputCorrectedClipped { 100, params.numThreads };
+	// queue at most about 200 reads like before batching, independent of the thread count, but always at least two batches
+	size_t readBatchesInQueue = std::max((size_t)2, 200 / params.readBatchSize);
+	BoundedBlockingQueue<ReadBatch*> readFastqsQueue { readBatchesInQueue, 1 };
+	FastQPool readPool { (readBatchesInQueue + params.numThreads * 2) * params.readBatchSize };
+	std::unique_ptr<ReorderBufferLimit> reorderLimit;
+	if (params.orderedOutput) reorderLimit = std::make_unique<ReorderBufferLimit>(params.orderedOutputMaxBytes);
 	std::atomic<bool> GAMWriteDone { false };
 	std::atomic<bool> GAFWriteDone { false };
 	std::atomic<bool> JSONWriteDone { false };
 	std::atomic<bool> correctedWriteDone { false };
 	std::atomic<bool> correctedClippedWriteDone { false };
 
+	// deflate is much faster than aligning, so a few threads per compressed output keep up with all aligner threads
+	size_t compressionThreads = std::max((size_t)1, std::min(params.numThreads / 8, (size_t)8));
+
 	std::cout << "Align" << std::endl;
+	if (params.verboseMode && minimizerseeder != nullptr) std::cout << "Seeding kernel: " << SeedingKernel::ImplementationName() << std::endl;
 	AlignmentStats stats;
-	std::thread fastqThread { [files=params.fastqFiles, &readFastqsQueue, &readStreamingFinished]() { readFastqs(files, readFastqsQueue, readStreamingFinished); } };
-	std::thread GAMwriterThread { [file=params.outputGAMFile, &outputGAM, &deallocAlns, &allThreadsDone, &GAMWriteDone, verboseMode=params.verboseMode]() { if (file != "") consumeBytesAndWrite(file, outputGAM, deallocAlns, allThreadsDone, GAMWriteDone, verboseMode, false); else GAMWriteDone = true; } };
-	std::thread GAFwriterThread { [file=params.outputGAFFile, &outputGAF, &deallocAlns, &allThreadsDone, &GAFWriteDone, verboseMode=params.verboseMode]() { if (file != "") consumeBytesAndWrite(file, outputGAF, deallocAlns, allThreadsDone, GAFWriteDone, verboseMode, true); else GAFWriteDone = true; } };
-	std::thread JSONwriterThread { [file=params.outputJSONFile, &outputJSON, &deallocAlns, &allThreadsDone, &JSONWriteDone, verboseMode=params.verboseMode]() { if (file != "") consumeBytesAndWrite(file, outputJSON, deallocAlns, allThreadsDone, JSONWriteDone, verboseMode, true); else JSONWriteDone = true; } };
-	std::thread correctedWriterThread { [file=params.outputCorrectedFile, &outputCorrected, &deallocAlns, &allThreadsDone, &correctedWriteDone, verboseMode=params.verboseMode, uncompressed=!params.compressCorrected]() { if (file != "") consumeBytesAndWrite(file, outputCorrected, deallocAlns, allThreadsDone, correctedWriteDone, verboseMode, uncompressed); else correctedWriteDone = true; } };
-	std::thread correctedClippedWriterThread { [file=params.outputCorrectedClippedFile, &outputCorrectedClipped, &deallocAlns, &allThreadsDone, &correctedClippedWriteDone, verboseMode=params.verboseMode, uncompressed=!params.compressClipped]() { if (file != "") consumeBytesAndWrite(file, outputCorrectedClipped, deallocAlns, allThreadsDone, correctedClippedWriteDone, verboseMode, uncompressed); else correctedClippedWriteDone = true; } };
+	stats.outOfReadsTime.resize(params.numThreads);
+	stats.helpAfterReadsMicroseconds.resize(params.numThreads, 0);
+	ClusterTaskPool clusterPool { params.numThreads };
+	WideClusterTaskPool wideClusterPool { params.numThreads };
+	std::thread fastqThread { [files=params.fastqFiles, &readFastqsQueue, &readPool, reorderLimit=reorderLimit.get(), decompressionThreads=std::min(params.numThreads, (size_t)4), batchReads=params.readBatchSize, batchBp=params.readBatchBp, longestFirstWindow=params.longestFirstWindow]() { readFastqs(files, readFastqsQueue, readPool, reorderLimit, decompressionThreads, batchReads, batchBp, longestFirstWindow); } };
+	std::thread GAMwriterThread { [file=params.outputGAMFile, &outputGAM, reorderLimit=reorderLimit.get(), &GAMWriteDone, verboseMode=params.verboseMode]() { if (file != "") consumeBytesAndWrite(file, outputGAM, reorderLimit, GAMWriteDone, verboseMode, false, 0); else GAMWriteDone = true; } };
+	std::thread GAFwriterThread { [file=params.outputGAFFile, &outputGAF, reorderLimit=reorderLimit.get(), &GAFWriteDone, verboseMode=params.verboseMode, compressionThreads=params.compressGAF ? compressionThreads : 0]() { if (file != "") consumeBytesAndWrite(file, outputGAF, reorderLimit, GAFWriteDone, verboseMode, true, compressionThreads); else GAFWriteDone = true; } };
+	std::thread JSONwriterThread { [file=params.outputJSONFile, &outputJSON, reorderLimit=reorderLimit.get(), &JSONWriteDone, verboseMode=params.verboseMode]() { if (file != "") consumeBytesAndWrite(file, outputJSON, reorderLimit, JSONWriteDone, verboseMode, true, 0); else JSONWriteDone = true; } };
+	std::thread correctedWriterThread { [file=params.outputCorrectedFile, &outputCorrected, reorderLimit=reorderLimit.get(), &correctedWriteDone, verboseMode=params.verboseMode, compressionThreads=params.compressCorrected ? compressionThreads : 0]() { if (file != "") consumeBytesAndWrite(file, outputCorrected, reorderLimit, correctedWriteDone, verboseMode, true, compressionThreads); else correctedWriteDone = true; } };
+	std::thread correctedClippedWriterThread { [file=params.outputCorrectedClippedFile, &outputCorrectedClipped, reorderLimit=reorderLimit.get(), &correctedClippedWriteDone, verboseMode=params.verboseMode, compressionThreads=params.compressClipped ? compressionThreads : 0]() { if (file != "") consumeBytesAndWrite(file, outputCorrectedClipped, reorderLimit, correctedClippedWriteDone, verboseMode, true, compressionThreads); else correctedClippedWriteDone = true; } };
 
 	for (size_t i = 0; i < params.numThreads; i++)
 	{
-		threads.emplace_back([&alignmentGraph, &readFastqsQueue, &readStreamingFinished, i, seeder, params, &outputGAM, &outputJSON, &outputGAF, &outputCorrected, &outputCorrectedClipped, &deallocAlns, &stats, &diploidHeuristic]() { runComponentMappings(alignmentGraph, diploidHeuristic, readFastqsQueue, readStreamingFinished, i, seeder, params, outputGAM, outputJSON, outputGAF, outputCorrected, outputCorrectedClipped, deallocAlns, stats); });
+		if (params.DPWordBits == 128)
+		{
+			threads.emplace_back([&alignmentGraph, &readFastqsQueue, &readPool, i, seeder, params, &outputGAM, &outputJSON, &outputGAF, &outputCorrected, &outputCorrectedClipped, outputArena=outputArenas[i].get(), &stats, &diploidHeuristic, &wideClusterPool]() { runComponentMappings(alignmentGraph, diploidHeuristic, readFastqsQueue, readPool, i, seeder, params, outputGAM, outputJSON, outputGAF, outputCorrected, outputCorrectedClipped, *outputArena, stats, wideClusterPool); });
+		}
+		else
+		{
+			threads.emplace_back([&alignmentGraph, &readFastqsQueue, &readPool, i, seeder, params, &outputGAM, &outputJSON, &outputGAF, &outputCorrected, &outputCorrectedClipped, outputArena=outputArenas[i].get(), &stats, &diploidHeuristic, &clusterPool]() { runComponentMappings(alignmentGraph, diploidHeuristic, readFastqsQueue, readPool, i, seeder, params, outputGAM, outputJSON, outputGAF, outputCorrected, outputCorrectedClipped, *outputArena, stats, clusterPool); });
+		}
 	}
 
 	for (size_t i = 0; i < params.numThreads; i++)
 	{
 		threads[i].join();
 	}
+	auto alignmentEnd = std::chrono::steady_clock::now();
 	assertSetNoRead("Postprocessing");
 
-	allThreadsDone = true;
+	outputGAM.close();
+	outputGAF.close();
+	outputJSON.close();
+	outputCorrected.close();
+	outputCorrectedClipped.close();
 
 	GAMwriterThread.join();
 	GAFwriterThread.join();
@@ -1001,12 +1389,6 @@ void alignReads(AlignerParams params)
 	if (memseeder != nullptr) delete memseeder;
 	if (minimizerseeder != nullptr) delete minimizerseeder;
 
-	std::string* dealloc;
-	while (deallocAlns.try_dequeue(dealloc))
-	{
-		delete dealloc;
-	}
-
 	std::cout << "Alignment finished" << std::endl;
 	std::cout << "Input reads: " << stats.reads << " (" << stats.bpInReads << "bp)" << std::endl;
 	std::cout << "Seeds found: " << stats.seedsFound << std::endl;
@@ -1021,4 +1403,15 @@ void alignReads(AlignerParams params)
 	{
 		std::cout << "Alignment broke with some reads. Look at stderr output." << std::endl;
 	}
+	if (reorderLimit != nullptr) reorderLimit->PrintStats();
+	printTailIdleStats(stats, alignmentEnd, params.verboseMode);
+	if (params.verboseMode)
+	{
+		printQueueWaitStats("Read queue", readFastqsQueue);
+		if (params.outputGAMFile != "") printQueueWaitStats("GAM output queue", outputGAM);
+		if (params.outputJSONFile != "") printQueueWaitStats("JSON output queue", outputJSON);
+		if (params.outputGAFFile != "") printQueueWaitStats("GAF output queue", outputGAF);
+		if (params.outputCorrectedFile != "") printQueueWaitStats("Corrected output queue", outputCorrected);
+		if (params.outputCorrectedClippedFile != "") printQueueWaitStats("Corrected clipped output queue", outputCorrectedClipped);
+	}
 }
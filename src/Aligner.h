@@ -29,6 +29,7 @@ struct AlignerParams
 	double selectionECutoff;
 	bool compressCorrected;
 	bool compressClipped;
+	bool compressGAF;
 	size_t minimizerLength;
 	size_t minimizerWindowSize;
 	double minimizerSeedDensity;
@@ -55,6 +56,18 @@ struct AlignerParams
 	std::vector<size_t> diploidHeuristicK;
 	std::string diploidHeuristicCacheFile;
 	bool keepSequenceNameTags;
+	std::string graphIndexFile;
+	size_t readBatchSize;
+	size_t readBatchBp;
+	bool orderedOutput;
+	size_t orderedOutputMaxBytes;
+	size_t maxDPTableBytes;
+	bool parallelClusters;
+	size_t longestFirstWindow;
+	std::string minimizerIndexFile;
+	bool minimizerHashTable;
+	size_t indexMemoryLimit;
+	size_t DPWordBits;
 };
 
 void alignReads(AlignerParams params);
@@ -35,7 +35,7 @@ int main(int argc, char** argv)
 	mandatory.add_options()
 		("graph,g", boost::program_options::value<std::string>(), "input graph (.gfa / .vg)")
 		("reads,f", boost::program_options::value<std::vector<std::string>>()->multitoken(), "input reads (fasta or fastq, uncompressed or gzipped)")
-		("alignments-out,a", boost::program_options::value<std::vector<std::string>>(), "output alignment file (.gaf/.gam/.json)")
+		("alignments-out,a", boost::program_options::value<std::vector<std::string>>(), "output alignment file (.gaf/.gaf.gz/.gam/.json)")
 		("corrected-out", boost::program_options::value<std::string>(), "output corrected reads file (.fa/.fa.gz)")
 		("corrected-clipped-out", boost::program_options::value<std::string>(), "output corrected clipped reads file (.fa/.fa.gz)")
 	;
@@ -56,6 +56,12 @@ int main(int argc, char** argv)
 		("min-alignment-score", boost::program_options::value<double>(), "discard alignments with alignment score < arg (double) (default 0)")
 		("multimap-score-fraction", boost::program_options::value<double>(), "discard alignments whose alignment score is less than this fraction of the best overlapping alignment (double) (default 0.9)")
 		("keep-sequence-name-tags", "Keep tags in input sequence names")
+		("graph-index", boost::program_options::value<std::string>(), "store the alignment graph to a binary index file for reuse, or reuse it if it exists (filename)")
+		("read-batch-size", boost::program_options::value<size_t>(), "give reads to the aligner threads in batches of up to arg reads (int) (default 100)")
+		("read-batch-bp", boost::program_options::value<size_t>(), "end a read batch once it has arg base pairs (int) (default 100000)")
+		("ordered-output", "write the output in the same order as the input reads")
+		("ordered-output-memory", boost::program_options::value<size_t>(), "with --ordered-output, pause reading when arg megabytes of output are waiting for earlier reads (int) (default 1024)")
+		("longest-first-window", boost::program_options::value<size_t>(), "give the largest of the next arg read batches to the aligner threads first, so the longest reads don't finish last (int) (0 for input order) (default 0)")
 	;
 	boost::program_options::options_description seeding("Seeding");
 	seeding.add_options()
@@ -65,6 +71,9 @@ int main(int argc, char** argv)
 		("seeds-minimizer-windowsize", boost::program_options::value<size_t>(), "window size for minimizer seeding (int)")
 		("seeds-minimizer-density", boost::program_options::value<double>(), "keep approximately (arg * sequence length) least frequent minimizers (double) (-1 for all)")
 		("seeds-minimizer-ignore-frequent", boost::program_options::value<double>(), "ignore arg most frequent fraction of minimizers (double)")
+		("seeds-minimizer-index", boost::program_options::value<std::string>(), "store the minimizer index to a file for reuse, or reuse it if it exists (filename)")
+		("seeds-minimizer-hashtable", "store the minimizer index in one cache line friendly hash table instead of minimal perfect hashes. Faster lookups, more memory")
+		("index-memory-limit", boost::program_options::value<size_t>(), "build the minimizer index through temporary files using about arg megabytes of memory on top of the index itself (int) (0 for building in memory) (default 0)")
 		("seeds-mum-count", boost::program_options::value<size_t>(), "arg longest maximal unique matches (int) (-1 for all)")
 		("seeds-mem-count", boost::program_options::value<size_t>(), "arg longest maximal exact matches (int) (-1 for all)")
 		("seeds-mxm-length", boost::program_options::value<size_t>(), "minimum length for maximal unique / exact matches (int)")
@@ -78,6 +87,9 @@ int main(int argc, char** argv)
 		("X-drop", boost::program_options::value<int>(), "X-drop alignment ending score cutoff (int)")
 		("precise-clipping", boost::program_options::value<double>(), "clip the alignment ends with arg as the identity cutoff between correct / wrong alignments (double) (default 0.66)")
 		("max-trace-count", boost::program_options::value<size_t>(), "backtrace from up to arg highest scoring local maxima per cluster (int) (-1 for all)")
+		("max-dp-memory", boost::program_options::value<size_t>(), "keep the DP table of one alignment under about arg megabytes by recalculating parts of it during the backtrace (int) (0 for no limit) (default 0)")
+		("parallel-clusters", "align the seed clusters of one read in parallel. Faster when a few reads with many clusters take most of the runtime")
+		("dp-word-bits", boost::program_options::value<size_t>(), "EXPERIMENTAL width of the bitvector DP words, 64 or 128. 128 handles twice as many read bases per slice but is usually slower (int) (default 64)")
 	;
 	boost::program_options::options_description hidden("hidden");
 	hidden.add_options()
@@ -144,6 +156,7 @@ int main(int argc, char** argv)
 	params.selectionECutoff = -1;
 	params.compressCorrected = false;
 	params.compressClipped = false;
+	params.compressGAF = false;
 	params.minimizerSeedDensity = 0;
 	params.minimizerLength = 19;
 	params.minimizerWindowSize = 30;
@@ -169,6 +182,18 @@ int main(int argc, char** argv)
 	params.useDiploidHeuristic = false;
 	params.diploidHeuristicCacheFile = "";
 	params.keepSequenceNameTags = false;
+	params.graphIndexFile = "";
+	params.readBatchSize = 100;
+	params.readBatchBp = 100000;
+	params.orderedOutput = false;
+	params.orderedOutputMaxBytes = (size_t)1024 * 1024 * 1024;
+	params.maxDPTableBytes = 0;
+	params.parallelClusters = false;
+	params.longestFirstWindow = 0;
+	params.minimizerIndexFile = "";
+	params.minimizerHashTable = false;
+	params.indexMemoryLimit = 0;
+	params.DPWordBits = 64;
 
 	std::vector<std::string> outputAlns;
 	bool paramError = false;
@@ -214,6 +239,9 @@ int main(int argc, char** argv)
 	if (vm.count("seeds-clustersize")) params.seedClusterMinSize = vm["seeds-clustersize"].as<size_t>();
 	if (vm.count("seeds-minimizer-density")) params.minimizerSeedDensity = vm["seeds-minimizer-density"].as<double>();
 	if (vm.count("seeds-minimizer-length")) params.minimizerLength = vm["seeds-minimizer-length"].as<size_t>();
+	if (vm.count("seeds-minimizer-index")) params.minimizerIndexFile = vm["seeds-minimizer-index"].as<std::string>();
+	if (vm.count("seeds-minimizer-hashtable")) params.minimizerHashTable = true;
+	if (vm.count("index-memory-limit")) params.indexMemoryLimit = vm["index-memory-limit"].as<size_t>() * 1024 * 1024;
 	if (vm.count("seeds-minimizer-windowsize")) params.minimizerWindowSize = vm["seeds-minimizer-windowsize"].as<size_t>();
 	if (vm.count("seeds-file")) params.seedFiles = vm["seeds-file"].as<std::vector<std::string>>();
 	if (vm.count("seeds-mxm-length")) params.mxmLength = vm["seeds-mxm-length"].as<size_t>();
@@ -233,6 +261,15 @@ int main(int argc, char** argv)
 	if (vm.count("max-trace-count")) params.maxTraceCount = vm["max-trace-count"].as<size_t>();
 
 	if (vm.count("keep-sequence-name-tags")) params.keepSequenceNameTags = true;
+	if (vm.count("graph-index")) params.graphIndexFile = vm["graph-index"].as<std::string>();
+	if (vm.count("read-batch-size")) params.readBatchSize = vm["read-batch-size"].as<size_t>();
+	if (vm.count("read-batch-bp")) params.readBatchBp = vm["read-batch-bp"].as<size_t>();
+	if (vm.count("ordered-output")) params.orderedOutput = true;
+	if (vm.count("longest-first-window")) params.longestFirstWindow = vm["longest-first-window"].as<size_t>();
+	if (vm.count("ordered-output-memory")) params.orderedOutputMaxBytes = vm["ordered-output-memory"].as<size_t>() * 1024 * 1024;
+	if (vm.count("max-dp-memory")) params.maxDPTableBytes = vm["max-dp-memory"].as<size_t>() * 1024 * 1024;
+	if (vm.count("parallel-clusters")) params.parallelClusters = true;
+	if (vm.count("dp-word-bits")) params.DPWordBits = vm["dp-word-bits"].as<size_t>();
 	if (vm.count("verbose")) params.verboseMode = true;
 	if (vm.count("precise-clipping")) params.preciseClippingIdentityCutoff = vm["precise-clipping"].as<double>();
 	if (vm.count("hpc-collapse-reads")) params.hpcCollapse = true;
@@ -303,9 +340,14 @@ int main(int argc, char** argv)
 		{
 			params.outputGAFFile = file;
 		}
+		else if (file.size() >= 7 && file.substr(file.size()-7) == ".gaf.gz")
+		{
+			params.outputGAFFile = file;
+			params.compressGAF = true;
+		}
 		else
 		{
-			std::cerr << "unknown output alignment format (" << file << "), must be either .gaf, .gam or .json" << std::endl;
+			std::cerr << "unknown output alignment format (" << file << "), must be either .gaf, .gaf.gz, .gam or .json" << std::endl;
 			paramError = true;
 		}
 	}
@@ -324,6 +366,22 @@ int main(int argc, char** argv)
 		std::cerr << "number of threads must be >= 1" << std::endl;
 		paramError = true;
 	}
+	if (params.readBatchSize < 1)
+	{
+		std::cerr << "read batch size must be >= 1" << std::endl;
+		paramError = true;
+	}
+	if (params.readBatchBp < 1)
+	{
+		std::cerr << "read batch bp must be >= 1" << std::endl;
+		paramError = true;
+	}
+	if (params.orderedOutput && params.longestFirstWindow > 0)
+	{
+		// the writers would wait for a batch still held in the window while the reader waits for the writers
+		std::cerr << "--longest-first-window can't be used with --ordered-output" << std::endl;
+		paramError = true;
+	}
 	if (params.alignmentBandwidth < 1)
 	{
 		std::cerr << "alignment bandwidth must be >= 1" << std::endl;
@@ -374,6 +432,11 @@ int main(int argc, char** argv)
 		std::cerr << "--max-cluster-extend cannot be 0" << std::endl;
 		paramError = true;
 	}
+	if (params.DPWordBits != 64 && params.DPWordBits != 128)
+	{
+		std::cerr << "--dp-word-bits must be 64 or 128" << std::endl;
+		paramError = true;
+	}
 	int pickedSeedingMethods = ((params.dynamicRowStart) ? 1 : 0) + ((params.seedFiles.size() > 0) ? 1 : 0) + ((params.mumCount != 0) ? 1 : 0) + ((params.memCount != 0) ? 1 : 0) + ((params.minimizerSeedDensity != 0) ? 1 : 0) + ((params.realignFile.size() > 0) ? 1 : 0);
 	if (pickedSeedingMethods == 0)
 	{
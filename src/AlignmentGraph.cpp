@@ -2,6 +2,15 @@
 #include <limits>
 #include <algorithm>
 #include <queue>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "AlignmentGraph.h"
 #include "CommonUtils.h"
 #include "ThreadReadAssertion.h"
@@ -27,32 +36,34 @@ AlignmentGraph AlignmentGraph::DummyGraph()
 	return dummy;
 }
 
-AlignmentGraph::NodeEdgeIterator::NodeEdgeIterator(size_t implicitEdge, const size_t* startPointer, const size_t* endPointer) :
+AlignmentGraph::NodeEdgeIterator::NodeEdgeIterator(size_t implicitEdge, const uint32_t* narrowStart, const size_t* wideStart, size_t count) :
 	implicitEdge(implicitEdge),
-	startPointer(startPointer),
-	endPointer(endPointer)
+	narrowStart(narrowStart),
+	wideStart(wideStart),
+	count(count)
 {
 }
 
-AlignmentGraph::EdgeIterator::EdgeIterator(size_t implicitEdge, const size_t* vecPointer) :
+AlignmentGraph::EdgeIterator::EdgeIterator(size_t implicitEdge, const uint32_t* narrowPointer, const size_t* widePointer) :
 	implicitEdge(implicitEdge),
-	vecPointer(vecPointer)
+	narrowPointer(narrowPointer),
+	widePointer(widePointer)
 {
 }
 
 AlignmentGraph::EdgeIterator AlignmentGraph::NodeEdgeIterator::begin() const
 {
-	return AlignmentGraph::EdgeIterator { implicitEdge, startPointer };
+	return AlignmentGraph::EdgeIterator { implicitEdge, narrowStart, wideStart };
 }
 
 AlignmentGraph::EdgeIterator AlignmentGraph::NodeEdgeIterator::end() const
 {
-	return AlignmentGraph::EdgeIterator { std::numeric_limits<size_t>::max(), endPointer };
+	return AlignmentGraph::EdgeIterator { std::numeric_limits<size_t>::max(), narrowStart != nullptr ? narrowStart + count : nullptr, wideStart != nullptr ? wideStart + count : nullptr };
 }
 
 size_t AlignmentGraph::NodeEdgeIterator::size() const
 {
-	return endPointer - startPointer + (implicitEdge != std::numeric_limits<size_t>::max() ? 1 : 0);
+	return count + (implicitEdge != std::numeric_limits<size_t>::max() ? 1 : 0);
 }
 
 size_t AlignmentGraph::NodeEdgeIterator::operator[](size_t index) const
@@ -62,12 +73,14 @@ size_t AlignmentGraph::NodeEdgeIterator::operator[](size_t index) const
 		if (index == 0) return implicitEdge;
 		index -= 1;
 	}
-	return *(startPointer+index);
+	assert(index < count);
+	if (narrowStart != nullptr) return *(narrowStart+index);
+	return *(wideStart+index);
 }
 
 bool AlignmentGraph::EdgeIterator::operator==(const AlignmentGraph::EdgeIterator& other) const
 {
-	return implicitEdge == other.implicitEdge && vecPointer == other.vecPointer;
+	return implicitEdge == other.implicitEdge && narrowPointer == other.narrowPointer && widePointer == other.widePointer;
 }
 
 bool AlignmentGraph::EdgeIterator::operator!=(const AlignmentGraph::EdgeIterator& other) const
@@ -78,7 +91,8 @@ bool AlignmentGraph::EdgeIterator::operator!=(const AlignmentGraph::EdgeIterator
 size_t AlignmentGraph::EdgeIterator::operator*() const
 {
 	if (implicitEdge != std::numeric_limits<size_t>::max()) return implicitEdge;
-	return *vecPointer;
+	if (narrowPointer != nullptr) return *narrowPointer;
+	return *widePointer;
 }
 
 AlignmentGraph::EdgeIterator& AlignmentGraph::EdgeIterator::operator++()
@@ -88,7 +102,14 @@ AlignmentGraph::EdgeIterator& AlignmentGraph::EdgeIterator::operator++()
 		implicitEdge = std::numeric_limits<size_t>::max();
 		return *this;
 	}
-	vecPointer += 1;
+	if (narrowPointer != nullptr)
+	{
+		narrowPointer += 1;
+	}
+	else
+	{
+		widePointer += 1;
+	}
 	return *this;
 }
 
@@ -116,6 +137,13 @@ AlignmentGraph::AlignmentGraph() :
 	intermediateDinodesStart(),
 	intermediateInEdges(),
 	intermediateOutEdges(),
+	narrowEdgeTargets(false),
+	inEdgeOffsets(),
+	outEdgeOffsets(),
+	narrowInEdgeTargets(),
+	narrowOutEdgeTargets(),
+	wideInEdgeTargets(),
+	wideOutEdgeTargets(),
 	firstOfIntermediates(),
 	nodeSequences(),
 	ambiguousNodeSequences(),
@@ -495,6 +523,7 @@ void AlignmentGraph::Finalize(int wordSize)
 		}
 		assert(lastDinodeLength[i] == NodeLength(intermediateLastDinode(i)));
 	}
+	buildEdgeCSR();
 	for (size_t i = 0; i < NodeSize(); i++)
 	{
 		for (auto neighbor : OutNeighbors(i))
@@ -611,6 +640,50 @@ void AlignmentGraph::replaceIntermediateEdgesWithDinodes()
 	}
 }
 
+void AlignmentGraph::buildEdgeCSR()
+{
+	assert(intermediateInEdges.size() == intermediateDinodesStart.size());
+	assert(intermediateOutEdges.size() == intermediateDinodesStart.size());
+	inEdgeOffsets.resize(intermediateInEdges.size()+1);
+	outEdgeOffsets.resize(intermediateOutEdges.size()+1);
+	inEdgeOffsets[0] = 0;
+	outEdgeOffsets[0] = 0;
+	for (size_t i = 0; i < intermediateInEdges.size(); i++)
+	{
+		inEdgeOffsets[i+1] = inEdgeOffsets[i] + intermediateInEdges[i].size();
+		outEdgeOffsets[i+1] = outEdgeOffsets[i] + intermediateOutEdges[i].size();
+	}
+	narrowEdgeTargets = NodeSize() < (size_t)std::numeric_limits<uint32_t>::max();
+	if (narrowEdgeTargets)
+	{
+		narrowInEdgeTargets.reserve(inEdgeOffsets.back());
+		narrowOutEdgeTargets.reserve(outEdgeOffsets.back());
+		for (size_t i = 0; i < intermediateInEdges.size(); i++)
+		{
+			narrowInEdgeTargets.insert(narrowInEdgeTargets.end(), intermediateInEdges[i].begin(), intermediateInEdges[i].end());
+			narrowOutEdgeTargets.insert(narrowOutEdgeTargets.end(), intermediateOutEdges[i].begin(), intermediateOutEdges[i].end());
+		}
+	}
+	else
+	{
+		wideInEdgeTargets.reserve(inEdgeOffsets.back());
+		wideOutEdgeTargets.reserve(outEdgeOffsets.back());
+		for (size_t i = 0; i < intermediateInEdges.size(); i++)
+		{
+			wideInEdgeTargets.insert(wideInEdgeTargets.end(), intermediateInEdges[i].begin(), intermediateInEdges[i].end());
+			wideOutEdgeTargets.insert(wideOutEdgeTargets.end(), intermediateOutEdges[i].begin(), intermediateOutEdges[i].end());
+		}
+	}
+	{
+		decltype(intermediateInEdges) tmp;
+		std::swap(tmp, intermediateInEdges);
+	}
+	{
+		decltype(intermediateOutEdges) tmp;
+		std::swap(tmp, intermediateOutEdges);
+	}
+}
+
 std::pair<bool, size_t> AlignmentGraph::findBubble(const size_t start, const std::vector<bool>& ignorableTip)
 {
 	std::vector<size_t> S;
@@ -659,7 +732,8 @@ std::pair<bool, size_t> AlignmentGraph::findBubble(const size_t start, const std
 	return std::make_pair(false, 0);
 }
 
-size_t find(std::vector<size_t>& parent, size_t item)
+template <typename Parent>
+size_t find(Parent& parent, size_t item)
 {
 	if (parent[item] == item) return item;
 	std::vector<size_t> stack;
@@ -669,7 +743,8 @@ size_t find(std::vector<size_t>& parent, size_t item)
 	return stack.back();
 }
 
-void merge(std::vector<size_t>& parent, std::vector<size_t>& rank, size_t left, size_t right)
+template <typename Parent>
+void merge(Parent& parent, std::vector<size_t>& rank, size_t left, size_t right)
 {
 	left = find(parent, left);
 	right = find(parent, right);
@@ -1136,11 +1211,11 @@ std::vector<size_t> renumber(const std::vector<size_t>& vec, const std::vector<s
 	return result;
 }
 
-template <typename T>
-std::vector<T> reorder(const std::vector<T>& vec, const std::vector<size_t>& renumbering)
+template <typename Container>
+std::vector<typename Container::value_type> reorder(const Container& vec, const std::vector<size_t>& renumbering)
 {
 	assert(vec.size() == renumbering.size());
-	std::vector<T> result;
+	std::vector<typename Container::value_type> result;
 	result.resize(vec.size());
 	for (size_t i = 0; i < vec.size(); i++)
 	{
@@ -1370,10 +1445,13 @@ AlignmentGraph::NodeEdgeIterator AlignmentGraph::OutNeighbors(size_t digraphNode
 	assert(digraphNodeId < NodeSize());
 	if (!firstOfIntermediates.get(digraphNodeId+1))
 	{
-		return AlignmentGraph::NodeEdgeIterator { digraphNodeId+1, nullptr, nullptr };
+		return AlignmentGraph::NodeEdgeIterator { digraphNodeId+1, nullptr, nullptr, 0 };
 	}
 	size_t intermediate = digraphToIntermediate(digraphNodeId);
-	return AlignmentGraph::NodeEdgeIterator { std::numeric_limits<size_t>::max(), intermediateOutEdges[intermediate].data(), intermediateOutEdges[intermediate].data() + intermediateOutEdges[intermediate].size() };
+	size_t start = outEdgeOffsets[intermediate];
+	size_t count = outEdgeOffsets[intermediate+1] - start;
+	if (narrowEdgeTargets) return AlignmentGraph::NodeEdgeIterator { std::numeric_limits<size_t>::max(), narrowOutEdgeTargets.data() + start, nullptr, count };
+	return AlignmentGraph::NodeEdgeIterator { std::numeric_limits<size_t>::max(), nullptr, wideOutEdgeTargets.data() + start, count };
 }
 
 AlignmentGraph::NodeEdgeIterator AlignmentGraph::InNeighbors(size_t digraphNodeId) const
@@ -1381,10 +1459,13 @@ AlignmentGraph::NodeEdgeIterator AlignmentGraph::InNeighbors(size_t digraphNodeI
 	assert(digraphNodeId < NodeSize());
 	if (!firstOfIntermediates.get(digraphNodeId))
 	{
-		return AlignmentGraph::NodeEdgeIterator { digraphNodeId - 1, nullptr, nullptr };
+		return AlignmentGraph::NodeEdgeIterator { digraphNodeId - 1, nullptr, nullptr, 0 };
 	}
 	size_t intermediate = digraphToIntermediate(digraphNodeId);
-	return AlignmentGraph::NodeEdgeIterator { std::numeric_limits<size_t>::max(), intermediateInEdges[intermediate].data(), intermediateInEdges[intermediate].data() + intermediateInEdges[intermediate].size() };
+	size_t start = inEdgeOffsets[intermediate];
+	size_t count = inEdgeOffsets[intermediate+1] - start;
+	if (narrowEdgeTargets) return AlignmentGraph::NodeEdgeIterator { std::numeric_limits<size_t>::max(), narrowInEdgeTargets.data() + start, nullptr, count };
+	return AlignmentGraph::NodeEdgeIterator { std::numeric_limits<size_t>::max(), nullptr, wideInEdgeTargets.data() + start, count };
 }
 
 size_t AlignmentGraph::BigraphNodeCount() const
@@ -1503,3 +1584,325 @@ bool AlignmentGraph::AllNodeNamesAreNumbers() const
 {
 	return allNodeNamesAreNumbers;
 }
+
+// flat binary layout: header, then every array as (uint64 count, raw items) padded to 8 bytes
+// so that the file can be mapped read-only and shared between processes through the page cache
+constexpr uint64_t GraphIndexMagic = 0x3158444e49414741; // "AGAINDX1"
+constexpr uint64_t GraphIndexVersion = 3;
+
+class GraphIndexWriter
+{
+public:
+	GraphIndexWriter(std::ostream& file) :
+		file(file),
+		written(0)
+	{
+	}
+	template <typename T>
+	void writeValue(T value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value);
+		file.write((const char*)&value, sizeof(T));
+		written += sizeof(T);
+		pad();
+	}
+	template <typename Container>
+	void writeVector(const Container& vec)
+	{
+		using T = typename Container::value_type;
+		static_assert(std::is_trivially_copyable<T>::value);
+		writeValue((uint64_t)vec.size());
+		file.write((const char*)vec.data(), vec.size() * sizeof(T));
+		written += vec.size() * sizeof(T);
+		pad();
+	}
+	void writeNestedVector(const std::vector<std::vector<size_t>>& vec)
+	{
+		std::vector<uint64_t> offsets;
+		std::vector<uint64_t> items;
+		offsets.reserve(vec.size()+1);
+		for (const auto& inner : vec)
+		{
+			offsets.push_back(items.size());
+			items.insert(items.end(), inner.begin(), inner.end());
+		}
+		offsets.push_back(items.size());
+		writeVector(offsets);
+		writeVector(items);
+	}
+	void writeStrings(const std::vector<std::string>& vec)
+	{
+		std::vector<uint64_t> offsets;
+		std::vector<char> chars;
+		offsets.reserve(vec.size()+1);
+		for (const auto& str : vec)
+		{
+			offsets.push_back(chars.size());
+			chars.insert(chars.end(), str.begin(), str.end());
+		}
+		offsets.push_back(chars.size());
+		writeVector(offsets);
+		writeVector(chars);
+	}
+private:
+	void pad()
+	{
+		while (written % 8 != 0)
+		{
+			file.put(0);
+			written += 1;
+		}
+	}
+	std::ostream& file;
+	size_t written;
+};
+
+class GraphIndexReader
+{
+public:
+	GraphIndexReader(std::shared_ptr<const char> mapping, size_t size) :
+		mapping(mapping),
+		data(mapping.get()),
+		size(size),
+		pos(0)
+	{
+	}
+	template <typename T>
+	T readValue()
+	{
+		static_assert(std::is_trivially_copyable<T>::value);
+		T result;
+		checkAvailable(sizeof(T));
+		memcpy(&result, data + pos, sizeof(T));
+		pos += sizeof(T);
+		skipPadding();
+		return result;
+	}
+	template <typename T>
+	void readVector(std::vector<T>& vec)
+	{
+		static_assert(std::is_trivially_copyable<T>::value);
+		uint64_t count = readValue<uint64_t>();
+		checkAvailableItems<T>(count);
+		vec.resize(count);
+		memcpy(vec.data(), data + pos, count * sizeof(T));
+		pos += count * sizeof(T);
+		skipPadding();
+	}
+	// points the array into the mapping instead of copying. Blocks are 8-byte aligned in the file and the mapping is page aligned
+	template <typename T>
+	void mapVector(MappedArray<T>& vec)
+	{
+		static_assert(std::is_trivially_copyable<T>::value);
+		static_assert(alignof(T) <= 8);
+		uint64_t count = readValue<uint64_t>();
+		checkAvailableItems<T>(count);
+		if ((uintptr_t)(data + pos) % alignof(T) != 0) throw CommonUtils::InvalidGraphException { "Graph index is corrupted" };
+		vec.map(mapping, (const T*)(data + pos), count);
+		pos += count * sizeof(T);
+		skipPadding();
+	}
+	void readNestedVector(std::vector<std::vector<size_t>>& vec)
+	{
+		std::vector<uint64_t> offsets;
+		std::vector<uint64_t> items;
+		readVector(offsets);
+		readVector(items);
+		if (offsets.size() == 0 || offsets.back() != items.size()) throw CommonUtils::InvalidGraphException { "Graph index is corrupted" };
+		vec.resize(offsets.size()-1);
+		for (size_t i = 0; i+1 < offsets.size(); i++)
+		{
+			if (offsets[i] > offsets[i+1] || offsets[i+1] > items.size()) throw CommonUtils::InvalidGraphException { "Graph index is corrupted" };
+			vec[i].assign(items.begin() + offsets[i], items.begin() + offsets[i+1]);
+		}
+	}
+	void readStrings(std::vector<std::string>& vec)
+	{
+		std::vector<uint64_t> offsets;
+		std::vector<char> chars;
+		readVector(offsets);
+		readVector(chars);
+		if (offsets.size() == 0 || offsets.back() != chars.size()) throw CommonUtils::InvalidGraphException { "Graph index is corrupted" };
+		vec.resize(offsets.size()-1);
+		for (size_t i = 0; i+1 < offsets.size(); i++)
+		{
+			if (offsets[i] > offsets[i+1] || offsets[i+1] > chars.size()) throw CommonUtils::InvalidGraphException { "Graph index is corrupted" };
+			vec[i].assign(chars.begin() + offsets[i], chars.begin() + offsets[i+1]);
+		}
+	}
+	bool atEnd() const
+	{
+		return pos == size;
+	}
+private:
+	void checkAvailable(size_t bytes) const
+	{
+		if (bytes > size - pos) throw CommonUtils::InvalidGraphException { "Graph index is truncated" };
+	}
+	// count comes from the file, so compare before multiplying to not wrap around
+	template <typename T>
+	void checkAvailableItems(uint64_t count) const
+	{
+		if (count > (size - pos) / sizeof(T)) throw CommonUtils::InvalidGraphException { "Graph index is truncated" };
+	}
+	void skipPadding()
+	{
+		pos = std::min(size, (pos + 7) / 8 * 8);
+	}
+	std::shared_ptr<const char> mapping;
+	const char* data;
+	size_t size;
+	size_t pos;
+};
+
+// identifies the graph file an index was built from without reading the file
+struct SourceGraphStamp
+{
+	std::string path;
+	uint64_t size;
+	uint64_t modified;
+};
+
+SourceGraphStamp getSourceGraphStamp(const std::string& filename)
+{
+	SourceGraphStamp result { filename, 0, 0 };
+	char* canonical = realpath(filename.c_str(), nullptr);
+	if (canonical != nullptr)
+	{
+		result.path = canonical;
+		free(canonical);
+	}
+	struct stat fileStat;
+	if (stat(filename.c_str(), &fileStat) == 0)
+	{
+		result.size = fileStat.st_size;
+		result.modified = fileStat.st_mtime;
+	}
+	return result;
+}
+
+void AlignmentGraph::SaveToFile(const std::string& filename, const std::string& sourceGraphFile) const
+{
+	assert(Finalized());
+	// written under a temporary name and renamed so that other processes sharing the index never see a partial file
+	std::string tmpFilename = filename + ".tmp." + std::to_string(getpid());
+	std::ofstream file { tmpFilename, std::ios::binary };
+	if (!file.good())
+	{
+		std::cerr << "Cannot write graph index to file: " << tmpFilename << std::endl;
+		std::abort();
+	}
+	SourceGraphStamp stamp = getSourceGraphStamp(sourceGraphFile);
+	GraphIndexWriter writer { file };
+	writer.writeValue(GraphIndexMagic);
+	writer.writeValue(GraphIndexVersion);
+	writer.writeValue((uint64_t)SPLIT_NODE_SIZE);
+	writer.writeValue((uint64_t)sizeof(size_t));
+	writer.writeStrings(std::vector<std::string> { stamp.path });
+	writer.writeValue(stamp.size);
+	writer.writeValue(stamp.modified);
+	writer.writeValue((uint64_t)bpSize);
+	writer.writeValue((uint64_t)firstAmbiguous);
+	writer.writeValue((uint64_t)(allNodeNamesAreNumbers ? 1 : 0));
+	writer.writeStrings(originalNodeName);
+	writer.writeNestedVector(bigraphIntermediateList);
+	writer.writeVector(originalNodeSize);
+	writer.writeVector(chainNumber);
+	writer.writeVector(chainApproxPos);
+	writer.writeVector(reverse);
+	writer.writeVector(partOfStronglyConnectedComponent);
+	writer.writeVector(componentNumber);
+	writer.writeVector(lastDinodeLength);
+	writer.writeVector(firstDinodeOffset);
+	writer.writeVector(intermediateBigraphNodeIDs);
+	writer.writeVector(intermediateDinodesStart);
+	writer.writeValue((uint64_t)(narrowEdgeTargets ? 1 : 0));
+	writer.writeVector(inEdgeOffsets);
+	writer.writeVector(outEdgeOffsets);
+	writer.writeVector(narrowInEdgeTargets);
+	writer.writeVector(narrowOutEdgeTargets);
+	writer.writeVector(wideInEdgeTargets);
+	writer.writeVector(wideOutEdgeTargets);
+	writer.writeVector(nodeSequences);
+	writer.writeVector(ambiguousNodeSequences);
+	file.close();
+	if (!file.good() || rename(tmpFilename.c_str(), filename.c_str()) != 0)
+	{
+		std::cerr << "Cannot write graph index to file: " << filename << std::endl;
+		remove(tmpFilename.c_str());
+		std::abort();
+	}
+}
+
+AlignmentGraph AlignmentGraph::LoadFromFile(const std::string& filename, const std::string& sourceGraphFile)
+{
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd == -1)
+	{
+		std::cerr << "Cannot read graph index from file: " << filename << std::endl;
+		std::abort();
+	}
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) == -1 || fileStat.st_size == 0)
+	{
+		close(fd);
+		throw CommonUtils::InvalidGraphException { "Graph index is empty: " + filename };
+	}
+	size_t fileSize = fileStat.st_size;
+	// MAP_SHARED + PROT_READ so concurrent processes loading the same index share the page cache
+	// the graph's arrays point into the mapping, which is unmapped when the last of them is gone
+	void* mapped = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED)
+	{
+		std::cerr << "Cannot map graph index file: " << filename << std::endl;
+		std::abort();
+	}
+	std::shared_ptr<const char> mapping { (const char*)mapped, [fileSize](const char* ptr) { munmap((void*)ptr, fileSize); } };
+	AlignmentGraph result;
+	{
+		GraphIndexReader reader { mapping, fileSize };
+		if (reader.readValue<uint64_t>() != GraphIndexMagic) throw CommonUtils::InvalidGraphException { "Not a graph index file: " + filename };
+		if (reader.readValue<uint64_t>() != GraphIndexVersion) throw CommonUtils::InvalidGraphException { "Graph index was built by a different version, rebuild it: " + filename };
+		if (reader.readValue<uint64_t>() != SPLIT_NODE_SIZE) throw CommonUtils::InvalidGraphException { "Graph index node size does not match, rebuild it: " + filename };
+		if (reader.readValue<uint64_t>() != sizeof(size_t)) throw CommonUtils::InvalidGraphException { "Graph index word size does not match, rebuild it: " + filename };
+		std::vector<std::string> sourcePath;
+		reader.readStrings(sourcePath);
+		uint64_t sourceSize = reader.readValue<uint64_t>();
+		uint64_t sourceModified = reader.readValue<uint64_t>();
+		SourceGraphStamp stamp = getSourceGraphStamp(sourceGraphFile);
+		if (sourcePath.size() != 1 || sourcePath[0] != stamp.path || sourceSize != stamp.size || sourceModified != stamp.modified) throw CommonUtils::InvalidGraphException { "Graph index was built from a different or modified graph file than " + sourceGraphFile + ": " + filename };
+		result.bpSize = reader.readValue<uint64_t>();
+		result.firstAmbiguous = reader.readValue<uint64_t>();
+		result.allNodeNamesAreNumbers = reader.readValue<uint64_t>() == 1;
+		reader.readStrings(result.originalNodeName);
+		reader.readNestedVector(result.bigraphIntermediateList);
+		reader.mapVector(result.originalNodeSize);
+		reader.mapVector(result.chainNumber);
+		reader.mapVector(result.chainApproxPos);
+		reader.mapVector(result.reverse);
+		reader.mapVector(result.partOfStronglyConnectedComponent);
+		reader.mapVector(result.componentNumber);
+		reader.mapVector(result.lastDinodeLength);
+		reader.mapVector(result.firstDinodeOffset);
+		reader.mapVector(result.intermediateBigraphNodeIDs);
+		reader.mapVector(result.intermediateDinodesStart);
+		result.narrowEdgeTargets = reader.readValue<uint64_t>() == 1;
+		reader.mapVector(result.inEdgeOffsets);
+		reader.mapVector(result.outEdgeOffsets);
+		reader.mapVector(result.narrowInEdgeTargets);
+		reader.mapVector(result.narrowOutEdgeTargets);
+		reader.mapVector(result.wideInEdgeTargets);
+		reader.mapVector(result.wideOutEdgeTargets);
+		reader.mapVector(result.nodeSequences);
+		reader.mapVector(result.ambiguousNodeSequences);
+		if (!reader.atEnd()) throw CommonUtils::InvalidGraphException { "Graph index has trailing data: " + filename };
+	}
+	if (result.originalNodeSize.size() != result.BigraphNodeCount() || result.componentNumber.size() != result.intermediateDinodesStart.size() || result.inEdgeOffsets.size() != result.intermediateDinodesStart.size()+1 || result.outEdgeOffsets.size() != result.intermediateDinodesStart.size()+1 || result.inEdgeOffsets.back() != (result.narrowEdgeTargets ? result.narrowInEdgeTargets.size() : result.wideInEdgeTargets.size()) || result.outEdgeOffsets.back() != (result.narrowEdgeTargets ? result.narrowOutEdgeTargets.size() : result.wideOutEdgeTargets.size()))
+	{
+		throw CommonUtils::InvalidGraphException { "Graph index is corrupted: " + filename };
+	}
+	result.makeDinodeIntermediateMapping();
+	result.finalized = true;
+	return result;
+}
@@ -2,15 +2,18 @@
 #define AlignmentGraph_h
 
 #include <iterator>
+#include <cstdint>
 #include <functional>
 #include <vector>
 #include <tuple>
 #include <unordered_set>
 #include <set>
+#include <string>
 #include <phmap.h>
 #include "RankBitvector.h"
 #include "ThreadReadAssertion.h"
 #include "DNAString.h"
+#include "MappedArray.h"
 
 class AlignmentGraph
 {
@@ -18,7 +21,7 @@ public:
 	class EdgeIterator : public std::iterator<std::input_iterator_tag, size_t>
 	{
 	public:
-		EdgeIterator(size_t implicitEdge, const size_t* vecPointer);
+		EdgeIterator(size_t implicitEdge, const uint32_t* narrowPointer, const size_t* widePointer);
 		EdgeIterator& operator=(const EdgeIterator& other) = default;
 		bool operator!=(const EdgeIterator& other) const;
 		bool operator==(const EdgeIterator& other) const;
@@ -27,13 +30,15 @@ public:
 		EdgeIterator operator++(int);
 	private:
 		size_t implicitEdge;
-		const size_t* vecPointer;
+		// exactly one of these is used, depending on whether the graph fits 32-bit edge targets
+		const uint32_t* narrowPointer;
+		const size_t* widePointer;
 	};
 	class NodeEdgeIterator
 	{
 	public:
 		using iterator = EdgeIterator;
-		NodeEdgeIterator(size_t implicitEdge, const size_t* startPointer, const size_t* endPointer);
+		NodeEdgeIterator(size_t implicitEdge, const uint32_t* narrowStart, const size_t* wideStart, size_t count);
 		NodeEdgeIterator& operator=(const NodeEdgeIterator& other) = default;
 		EdgeIterator begin() const;
 		EdgeIterator end() const;
@@ -41,8 +46,9 @@ public:
 		size_t operator[](size_t index) const;
 	private:
 		size_t implicitEdge;
-		const size_t* startPointer;
-		const size_t* endPointer;
+		const uint32_t* narrowStart;
+		const size_t* wideStart;
+		size_t count;
 	};
 	//determines extra band size, shouldn't be too high because of extra slices
 	//should be 0 mod (wordsize/2 == 32), otherwise storage has overhead
@@ -148,10 +154,15 @@ public:
 	std::string BigraphNodeSeq(size_t bigraphNodeId) const;
 	static AlignmentGraph DummyGraph();
 	bool AllNodeNamesAreNumbers() const;
+	// the index remembers the size and modification time of the graph file it was built from
+	void SaveToFile(const std::string& filename, const std::string& sourceGraphFile) const;
+	// the arrays point into a shared read-only mapping of the index. Throws CommonUtils::InvalidGraphException if the index is broken or sourceGraphFile has changed
+	static AlignmentGraph LoadFromFile(const std::string& filename, const std::string& sourceGraphFile);
 private:
 	void makeDinodeIntermediateMapping();
 	void sparsenComponentNumbers();
 	void replaceIntermediateEdgesWithDinodes();
+	void buildEdgeCSR();
 	size_t addIntermediateNodes(size_t bigraphNodeId, const DNAString& sequence, size_t start, size_t end);
 	void fixChainApproxPos(const size_t start);
 	std::pair<bool, size_t> findBubble(const size_t start, const std::vector<bool>& ignorableTip);
@@ -175,23 +186,31 @@ private:
 	// bigraph
 	std::vector<std::string> originalNodeName;
 	std::vector<std::vector<size_t>> bigraphIntermediateList;
-	std::vector<size_t> originalNodeSize;
-	std::vector<size_t> chainNumber;
-	std::vector<size_t> chainApproxPos;
-	std::vector<bool> reverse;
+	MappedArray<size_t> originalNodeSize;
+	MappedArray<size_t> chainNumber;
+	MappedArray<size_t> chainApproxPos;
+	MappedArray<uint8_t> reverse;
 	// intermediates
-	std::vector<bool> partOfStronglyConnectedComponent;
-	std::vector<size_t> componentNumber;
-	std::vector<uint8_t> lastDinodeLength;
-	std::vector<size_t> firstDinodeOffset;
-	std::vector<size_t> intermediateBigraphNodeIDs;
-	std::vector<size_t> intermediateDinodesStart;
-	std::vector<std::vector<size_t>> intermediateInEdges; // during construction points to intermediates, after points to dinodes
-	std::vector<std::vector<size_t>> intermediateOutEdges; // during construction points to intermediates, after points to dinodes
+	MappedArray<uint8_t> partOfStronglyConnectedComponent;
+	MappedArray<size_t> componentNumber;
+	MappedArray<uint8_t> lastDinodeLength;
+	MappedArray<size_t> firstDinodeOffset;
+	MappedArray<size_t> intermediateBigraphNodeIDs;
+	MappedArray<size_t> intermediateDinodesStart;
+	std::vector<std::vector<size_t>> intermediateInEdges; // during construction points to intermediates, after points to dinodes, emptied when finalized
+	std::vector<std::vector<size_t>> intermediateOutEdges; // during construction points to intermediates, after points to dinodes, emptied when finalized
+	// finalized edges in compressed sparse row form, targets are dinodes
+	bool narrowEdgeTargets;
+	MappedArray<size_t> inEdgeOffsets;
+	MappedArray<size_t> outEdgeOffsets;
+	MappedArray<uint32_t> narrowInEdgeTargets;
+	MappedArray<uint32_t> narrowOutEdgeTargets;
+	MappedArray<size_t> wideInEdgeTargets;
+	MappedArray<size_t> wideOutEdgeTargets;
 	// digraph
 	RankBitvector firstOfIntermediates;
-	std::vector<NodeChunkSequence> nodeSequences;
-	std::vector<AmbiguousChunkSequence> ambiguousNodeSequences;
+	MappedArray<NodeChunkSequence> nodeSequences;
+	MappedArray<AmbiguousChunkSequence> ambiguousNodeSequences;
 };
 
 
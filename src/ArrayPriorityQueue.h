@@ -1,61 +1,80 @@
 #ifndef ArrayPriorityQueue_h
 #define ArrayPriorityQueue_h
 
-#include <queue>
+#include <vector>
+#include <limits>
+#include <cstdint>
 #include <phmap.h>
 #include "ThreadReadAssertion.h"
 
+// bucket queue with one bucket per priority. Items of all buckets are stored contiguously with each bucket as a LIFO list,
+// and a two level bitmap of non-empty buckets finds the minimum priority with find-first-set.
+// clear only touches the bitmap words which are non-zero
 template <typename T, bool SparseStorage>
 class ArrayPriorityQueue
 {
+	static constexpr uint32_t NoItem = std::numeric_limits<uint32_t>::max();
 public:
 	constexpr bool IsComponentPriorityQueue() { return false; }
 	ArrayPriorityQueue(size_t maxPriority, size_t maxExtras) :
-	activeQueues(),
+	heads(),
+	nonEmptyBuckets(),
+	nonEmptyWords(),
+	items(),
+	nextItems(),
 	extras(),
-	queues(),
-	numItems(0)
+	numItems(0),
+	minPriority(0)
 	{
 		initialize(maxPriority, maxExtras);
 	}
 	ArrayPriorityQueue() :
-	activeQueues(),
+	heads(),
+	nonEmptyBuckets(),
+	nonEmptyWords(),
+	items(),
+	nextItems(),
 	extras(),
-	queues(),
-	numItems(0)
+	numItems(0),
+	minPriority(0)
 	{
 	}
 	template <bool Sparse = SparseStorage>
 	typename std::enable_if<Sparse>::type initialize(size_t maxPriority, size_t maxExtras)
 	{
-		queues.resize(maxPriority);
+		initializeBuckets(maxPriority);
 	}
 	template <bool Sparse = SparseStorage>
 	typename std::enable_if<!Sparse>::type initialize(size_t maxPriority, size_t maxExtras)
 	{
 		extras.resize(maxExtras, std::vector<T>{});
-		queues.resize(maxPriority);
+		initializeBuckets(maxPriority);
 	}
 #ifdef NDEBUG
 	__attribute__((always_inline))
 #endif
 	T& top()
 	{
-		assert(activeQueues.size() > 0);
-		size_t queue = activeQueues.top();
-		assert(queues[queue].size() > 0);
-		return queues[queue].back();
+		assert(numItems > 0);
+		assert(minPriority < heads.size());
+		assert(isNonEmpty(minPriority));
+		return items[heads[minPriority]];
 	}
 #ifdef NDEBUG
 	__attribute__((always_inline))
 #endif
 	void pop()
 	{
-		size_t queue = activeQueues.top();
-		assert(queues[queue].size() > 0);
-		queues[queue].pop_back();
-		if (queues[queue].size() == 0) activeQueues.pop();
+		assert(numItems > 0);
+		assert(isNonEmpty(minPriority));
+		uint32_t index = heads[minPriority];
+		heads[minPriority] = nextItems[index];
 		numItems--;
+		if (heads[minPriority] == NoItem)
+		{
+			setEmpty(minPriority);
+			minPriority = findMinPriority();
+		}
 	}
 #ifdef NDEBUG
 	__attribute__((always_inline))
@@ -73,26 +92,41 @@ public:
 #endif
 	void insert(size_t priority, const T& item)
 	{
-		assert(priority < queues.size());
-		queues[priority].push_back(item);
+		assert(priority < heads.size());
+		assert(items.size() < NoItem);
+		uint32_t index = items.size();
+		items.push_back(item);
+		if (isNonEmpty(priority))
+		{
+			nextItems.push_back(heads[priority]);
+		}
+		else
+		{
+			nextItems.push_back(NoItem);
+			setNonEmpty(priority);
+		}
+		heads[priority] = index;
+		if (priority < minPriority) minPriority = priority;
 		assert(SparseStorage || getId(item) < extras.size());
 		extras[getId(item)].push_back(item);
-		if (queues[priority].size() == 1) activeQueues.emplace(priority);
 		numItems++;
 	}
 	void clear()
 	{
-		while (activeQueues.size() > 0)
+		for (size_t i = 0; i < nonEmptyWords.size(); i++)
 		{
-			size_t queue = activeQueues.top();
-			for (auto item : queues[queue])
+			while (nonEmptyWords[i] != 0)
 			{
-				removeExtras(getId(item));
+				size_t word = i * 64 + __builtin_ctzll(nonEmptyWords[i]);
+				removeQueuedExtras(word);
+				nonEmptyBuckets[word] = 0;
+				nonEmptyWords[i] &= nonEmptyWords[i] - 1;
 			}
-			queues[queue].clear();
-			activeQueues.pop();
 		}
+		items.clear();
+		nextItems.clear();
 		numItems = 0;
+		minPriority = heads.size();
 		sparsify();
 	}
 
@@ -122,6 +156,57 @@ public:
 		return getVec(extras, index).size();
 	}
 private:
+	void initializeBuckets(size_t maxPriority)
+	{
+		heads.resize(maxPriority, NoItem);
+		nonEmptyBuckets.resize((maxPriority + 63) / 64, 0);
+		nonEmptyWords.resize((nonEmptyBuckets.size() + 63) / 64, 0);
+		minPriority = maxPriority;
+	}
+	bool isNonEmpty(size_t priority) const
+	{
+		return (nonEmptyBuckets[priority / 64] >> (priority % 64)) & 1;
+	}
+	void setNonEmpty(size_t priority)
+	{
+		nonEmptyBuckets[priority / 64] |= (uint64_t)1 << (priority % 64);
+		nonEmptyWords[priority / 4096] |= (uint64_t)1 << ((priority / 64) % 64);
+	}
+	void setEmpty(size_t priority)
+	{
+		nonEmptyBuckets[priority / 64] &= ~((uint64_t)1 << (priority % 64));
+		if (nonEmptyBuckets[priority / 64] == 0) nonEmptyWords[priority / 4096] &= ~((uint64_t)1 << ((priority / 64) % 64));
+	}
+	size_t findMinPriority() const
+	{
+		for (size_t i = 0; i < nonEmptyWords.size(); i++)
+		{
+			if (nonEmptyWords[i] == 0) continue;
+			size_t word = i * 64 + __builtin_ctzll(nonEmptyWords[i]);
+			assert(nonEmptyBuckets[word] != 0);
+			return word * 64 + __builtin_ctzll(nonEmptyBuckets[word]);
+		}
+		return heads.size();
+	}
+	// sparse extras are thrown away as a whole in sparsify
+	template<bool Sparse = SparseStorage>
+	typename std::enable_if<Sparse>::type removeQueuedExtras(size_t word)
+	{
+	}
+	template<bool Sparse = SparseStorage>
+	typename std::enable_if<!Sparse>::type removeQueuedExtras(size_t word)
+	{
+		uint64_t buckets = nonEmptyBuckets[word];
+		while (buckets != 0)
+		{
+			size_t priority = word * 64 + __builtin_ctzll(buckets);
+			for (uint32_t index = heads[priority]; index != NoItem; index = nextItems[index])
+			{
+				removeExtras(getId(items[index]));
+			}
+			buckets &= buckets - 1;
+		}
+	}
 	const std::vector<T>& getVec(const std::vector<std::vector<T>>& list, size_t index) const
 	{
 		return list[index];
@@ -137,10 +222,15 @@ private:
 	{
 		return item.target;
 	}
-	std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> activeQueues;
+	// first item of each bucket, only valid when the bucket's bit is set
+	std::vector<uint32_t> heads;
+	std::vector<uint64_t> nonEmptyBuckets;
+	std::vector<uint64_t> nonEmptyWords;
+	std::vector<T> items;
+	std::vector<uint32_t> nextItems;
 	typename std::conditional<SparseStorage, phmap::flat_hash_map<size_t, std::vector<T>>, std::vector<std::vector<T>>>::type extras;
-	std::vector<std::vector<T>> queues;
 	size_t numItems;
+	size_t minPriority;
 };
 
 #endif
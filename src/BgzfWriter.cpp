@@ -0,0 +1,171 @@
+#include <iostream>
+#include <cstring>
+#include <zlib.h>
+#include "BgzfWriter.h"
+#include "ThreadReadAssertion.h"
+
+// BGZF blocks are at most 64kb compressed, this much input still fits even if it doesn't compress at all
+static constexpr size_t BlockInputSize = 0xff00;
+static constexpr size_t MaxBlockSize = 65536;
+static constexpr size_t HeaderSize = 18;
+static constexpr size_t FooterSize = 8;
+// how many blocks may be compressing or waiting to be written per compression thread
+static constexpr size_t BlocksInFlightPerThread = 16;
+static const unsigned char EofMarker[28] = { 0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00, 0x42, 0x43, 0x02, 0x00, 0x1b, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+BgzfWriter::BgzfWriter(std::ostream& out, size_t numThreads) :
+	out(out),
+	mutex(),
+	workAvailable(),
+	blockDone(),
+	ordered(),
+	waitingForWorker(),
+	current(std::make_shared<Block>()),
+	threads(),
+	maxBlocks(BlocksInFlightPerThread * std::max((size_t)1, numThreads)),
+	stopping(false),
+	closed(false)
+{
+	current->uncompressed.reserve(BlockInputSize);
+	for (size_t i = 0; i < std::max((size_t)1, numThreads); i++)
+	{
+		threads.emplace_back([this]() { runWorker(); });
+	}
+}
+
+BgzfWriter::~BgzfWriter()
+{
+	Close();
+}
+
+void BgzfWriter::Write(const char* data, size_t size)
+{
+	assert(!closed);
+	while (size > 0)
+	{
+		size_t copied = std::min(size, BlockInputSize - current->uncompressed.size());
+		current->uncompressed.append(data, copied);
+		data += copied;
+		size -= copied;
+		if (current->uncompressed.size() == BlockInputSize) queueCurrentBlock();
+	}
+}
+
+void BgzfWriter::Close()
+{
+	if (closed) return;
+	if (current->uncompressed.size() > 0) queueCurrentBlock();
+	writeFinishedBlocks(0);
+	{
+		std::lock_guard<std::mutex> lock { mutex };
+		stopping = true;
+	}
+	workAvailable.notify_all();
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		threads[i].join();
+	}
+	threads.clear();
+	out.write((const char*)EofMarker, sizeof(EofMarker));
+	closed = true;
+}
+
+void BgzfWriter::compressBlock(Block& block)
+{
+	z_stream strm;
+	memset(&strm, 0, sizeof(strm));
+	// raw deflate, the gzip header and footer are written here since BGZF needs the extra field
+	if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		std::cerr << "Error writing compressed output: could not initialize zlib" << std::endl;
+		std::abort();
+	}
+	size_t bound = deflateBound(&strm, block.uncompressed.size());
+	block.compressed.resize(HeaderSize + bound + FooterSize);
+	strm.next_in = (Bytef*)block.uncompressed.data();
+	strm.avail_in = block.uncompressed.size();
+	strm.next_out = (Bytef*)block.compressed.data() + HeaderSize;
+	strm.avail_out = bound;
+	int result = deflate(&strm, Z_FINISH);
+	size_t deflatedSize = strm.total_out;
+	deflateEnd(&strm);
+	if (result != Z_STREAM_END)
+	{
+		std::cerr << "Error writing compressed output: compression failed" << std::endl;
+		std::abort();
+	}
+	size_t blockSize = HeaderSize + deflatedSize + FooterSize;
+	assert(blockSize <= MaxBlockSize);
+	block.compressed.resize(blockSize);
+	unsigned char* header = (unsigned char*)block.compressed.data();
+	const unsigned char fixedHeader[16] = { 0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00, 0x42, 0x43, 0x02, 0x00 };
+	memcpy(header, fixedHeader, sizeof(fixedHeader));
+	header[16] = (blockSize - 1) & 0xff;
+	header[17] = ((blockSize - 1) >> 8) & 0xff;
+	uint32_t crc = crc32(0, (const Bytef*)block.uncompressed.data(), block.uncompressed.size());
+	uint32_t inputSize = block.uncompressed.size();
+	unsigned char* footer = header + HeaderSize + deflatedSize;
+	for (size_t i = 0; i < 4; i++)
+	{
+		footer[i] = (crc >> (i * 8)) & 0xff;
+		footer[4+i] = (inputSize >> (i * 8)) & 0xff;
+	}
+	block.uncompressed.clear();
+	block.uncompressed.shrink_to_fit();
+}
+
+void BgzfWriter::runWorker()
+{
+	while (true)
+	{
+		std::shared_ptr<Block> block;
+		{
+			std::unique_lock<std::mutex> lock { mutex };
+			workAvailable.wait(lock, [this]() { return stopping || waitingForWorker.size() > 0; });
+			if (waitingForWorker.size() == 0) break;
+			block = waitingForWorker.front();
+			waitingForWorker.pop_front();
+		}
+		compressBlock(*block);
+		{
+			std::lock_guard<std::mutex> lock { mutex };
+			block->done = true;
+		}
+		blockDone.notify_all();
+	}
+}
+
+void BgzfWriter::queueCurrentBlock()
+{
+	{
+		std::lock_guard<std::mutex> lock { mutex };
+		ordered.push_back(current);
+		waitingForWorker.push_back(current);
+	}
+	workAvailable.notify_one();
+	current = std::make_shared<Block>();
+	current->uncompressed.reserve(BlockInputSize);
+	writeFinishedBlocks(maxBlocks);
+}
+
+// writes the finished blocks at the front, and waits until at most maxInFlight blocks are left
+void BgzfWriter::writeFinishedBlocks(size_t maxInFlight)
+{
+	while (true)
+	{
+		std::shared_ptr<Block> front;
+		{
+			std::unique_lock<std::mutex> lock { mutex };
+			if (ordered.size() == 0) return;
+			if (!ordered.front()->done)
+			{
+				if (ordered.size() <= maxInFlight) return;
+				blockDone.wait(lock, [this]() { return ordered.front()->done; });
+			}
+			front = ordered.front();
+			ordered.pop_front();
+		}
+		// only the writing thread touches the stream
+		out.write(front->compressed.data(), front->compressed.size());
+	}
+}
@@ -0,0 +1,50 @@
+#ifndef BgzfWriter_h
+#define BgzfWriter_h
+
+#include <string>
+#include <ostream>
+#include <memory>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// writes a BGZF file (concatenated gzip members of at most 64kb each, readable by gzip and seekable by bgzip/htslib)
+// blocks are compressed on helper threads and written to the stream in order by the thread calling Write
+class BgzfWriter
+{
+public:
+	BgzfWriter(std::ostream& out, size_t numThreads);
+	~BgzfWriter();
+	BgzfWriter(const BgzfWriter& other) = delete;
+	BgzfWriter& operator=(const BgzfWriter& other) = delete;
+	void Write(const char* data, size_t size);
+	// compresses and writes everything that is left and appends the BGZF end of file marker
+	void Close();
+private:
+	struct Block
+	{
+		std::string uncompressed;
+		std::string compressed;
+		bool done = false;
+	};
+	static void compressBlock(Block& block);
+	void runWorker();
+	void queueCurrentBlock();
+	void writeFinishedBlocks(size_t maxInFlight);
+	std::ostream& out;
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::condition_variable blockDone;
+	// in file order, the front is written when it's done
+	std::deque<std::shared_ptr<Block>> ordered;
+	std::deque<std::shared_ptr<Block>> waitingForWorker;
+	std::shared_ptr<Block> current;
+	std::vector<std::thread> threads;
+	size_t maxBlocks;
+	bool stopping;
+	bool closed;
+};
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef BoundedBlockingQueue_h
+#define BoundedBlockingQueue_h
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+#include <blockingconcurrentqueue.h> //https://github.com/cameron314/concurrentqueue
+#include "ThreadReadAssertion.h"
+
+// multi-producer multi-consumer queue of pointers on top of BlockingConcurrentQueue
+// producers block while the queue is full, consumers block while it is empty
+// end of stream is signalled with close() after all producers are finished
+template <typename T>
+class BoundedBlockingQueue
+{
+	static_assert(std::is_pointer<T>::value);
+public:
+	BoundedBlockingQueue(size_t capacity, size_t maxProducers) :
+		queue(capacity, maxProducers, 0),
+		capacity(capacity),
+		count(0),
+		waitingProducers(0),
+		closed(false),
+		producerWaitMicroseconds(0),
+		consumerWaitMicroseconds(0),
+		fullWaits(0),
+		emptyWaits(0)
+	{
+	}
+	BoundedBlockingQueue(const BoundedBlockingQueue& other) = delete;
+	BoundedBlockingQueue& operator=(const BoundedBlockingQueue& other) = delete;
+	void enqueue(moodycamel::ProducerToken& token, T item)
+	{
+		assert(item != nullptr);
+		waitForSpace();
+		queue.enqueue(token, item);
+	}
+	void enqueue(T item)
+	{
+		assert(item != nullptr);
+		waitForSpace();
+		queue.enqueue(item);
+	}
+	// false once the queue is closed and drained
+	bool dequeue(T& item)
+	{
+		return dequeue_bulk(&item, 1) == 1;
+	}
+	// 0 once the queue is closed and drained
+	size_t dequeue_bulk(T* items, size_t maxItems)
+	{
+		size_t got = queue.try_dequeue_bulk(items, maxItems);
+		if (got == 0 && !closed)
+		{
+			auto waitStart = std::chrono::steady_clock::now();
+			got = queue.wait_dequeue_bulk(items, maxItems);
+			consumerWaitMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - waitStart).count();
+			emptyWaits += 1;
+		}
+		size_t sentinels = removeSentinels(items, got);
+		if (sentinels > 0)
+		{
+			closed = true;
+			// the sentinels don't use any capacity so don't count them
+			got -= sentinels;
+		}
+		if (got == 0 && closed)
+		{
+			// producers are finished, so anything left from other producers' sub-queues can be taken without waiting
+			got = queue.try_dequeue_bulk(items, maxItems);
+			got -= removeSentinels(items, got);
+			// keep the end of stream visible to the other consumers
+			if (got == 0)
+			{
+				queue.enqueue(nullptr);
+				return 0;
+			}
+		}
+		released(got);
+		return got;
+	}
+	// all producers must be finished
+	void close()
+	{
+		queue.enqueue(nullptr);
+	}
+	size_t size_approx() const
+	{
+		return queue.size_approx();
+	}
+	uint64_t ProducerWaitMicroseconds() const
+	{
+		return producerWaitMicroseconds;
+	}
+	uint64_t ConsumerWaitMicroseconds() const
+	{
+		return consumerWaitMicroseconds;
+	}
+	uint64_t FullWaits() const
+	{
+		return fullWaits;
+	}
+	uint64_t EmptyWaits() const
+	{
+		return emptyWaits;
+	}
+	moodycamel::BlockingConcurrentQueue<T>& Underlying()
+	{
+		return queue;
+	}
+private:
+	size_t removeSentinels(T* items, size_t got)
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < got; i++)
+		{
+			if (items[i] == nullptr) continue;
+			items[kept] = items[i];
+			kept += 1;
+		}
+		return got - kept;
+	}
+	void waitForSpace()
+	{
+		if (count.load() < capacity)
+		{
+			count += 1;
+			return;
+		}
+		auto waitStart = std::chrono::steady_clock::now();
+		{
+			std::unique_lock<std::mutex> lock { mutex };
+			waitingProducers += 1;
+			notFull.wait(lock, [this]() { return count.load() < capacity; });
+			waitingProducers -= 1;
+		}
+		// several producers may wake up at once so the capacity is a soft limit
+		count += 1;
+		producerWaitMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - waitStart).count();
+		fullWaits += 1;
+	}
+	void released(size_t items)
+	{
+		if (items == 0) return;
+		count -= items;
+		if (waitingProducers.load() > 0)
+		{
+			std::lock_guard<std::mutex> lock { mutex };
+			notFull.notify_all();
+		}
+	}
+	moodycamel::BlockingConcurrentQueue<T> queue;
+	size_t capacity;
+	std::atomic<size_t> count;
+	std::atomic<size_t> waitingProducers;
+	std::atomic<bool> closed;
+	std::mutex mutex;
+	std::condition_variable notFull;
+	std::atomic<uint64_t> producerWaitMicroseconds;
+	std::atomic<uint64_t> consumerWaitMicroseconds;
+	std::atomic<uint64_t> fullWaits;
+	std::atomic<uint64_t> emptyWaits;
+};
+
+#endif
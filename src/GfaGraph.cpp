@@ -2,6 +2,12 @@
 #include <limits>
 #include <fstream>
 #include <sstream>
+#include <string_view>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <cctype>
+#include <algorithm>
 #include <zstr.hpp> //https://github.com/mateidavid/zstr
 #include "GfaGraph.h"
 #include "ThreadReadAssertion.h"
@@ -56,108 +62,331 @@ edges()
 }
 
 GfaGraph GfaGraph::LoadFromFile(std::string filename)
+{
+	return LoadFromFile(filename, 1);
+}
+
+GfaGraph GfaGraph::LoadFromFile(std::string filename, size_t numThreads)
 {
 	if (filename.substr(filename.size()-3) == ".gz")
 	{
 		assert(filename.substr(filename.size()-7) == ".gfa.gz");
 		zstr::ifstream file { filename };
-		return LoadFromStream(file);
+		return LoadFromStream(file, numThreads);
 	}
 	else
 	{
 		assert(filename.substr(filename.size()-4) == ".gfa");
 		std::ifstream file { filename };
-		return LoadFromStream(file);
+		return LoadFromStream(file, numThreads);
 	}
-	zstr::ifstream file { filename };
 }
 
-size_t getNameId(std::unordered_map<std::string, size_t>& assigned, const std::string& name, std::vector<DNAString>& nodeSeqs, std::vector<std::string>& originalNodeName)
+namespace
 {
-	auto found = assigned.find(name);
-	if (found == assigned.end())
-	{
-		assert(assigned.size() == nodeSeqs.size());
-		assert(assigned.size() == originalNodeName.size());
-		int result = assigned.size();
-		assigned[name] = result;
-		originalNodeName.emplace_back(name);
-		nodeSeqs.emplace_back();
-		return result;
+	// input is read in batches of line-aligned chunks, each chunk is parsed by one thread
+	constexpr size_t GfaChunkBytes = 8 * 1024 * 1024;
+	// name ids are temporarily stored as the location of the first occurrence in the current batch
+	constexpr size_t UnresolvedNameBit = (size_t)1 << 63;
+
+	struct GfaParsedSegment
+	{
+		size_t nameOccurrence;
+		std::string_view sequence;
+	};
+
+	struct GfaParsedLink
+	{
+		size_t fromOccurrence;
+		bool fromFw;
+		size_t toOccurrence;
+		bool toFw;
+		size_t overlap;
+	};
+
+	struct GfaChunk
+	{
+		std::string_view text;
+		// names in the order the serial parser would have looked them up
+		std::vector<std::string_view> names;
+		std::vector<std::vector<uint32_t>> namesPerShard;
+		std::vector<uint8_t> firstOccurrence;
+		std::vector<size_t> firstOccurrenceIds;
+		std::vector<size_t> nameIds;
+		std::vector<GfaParsedSegment> segments;
+		std::vector<GfaParsedLink> links;
+		std::vector<std::pair<size_t, DNAString>> nodes;
+		std::vector<std::tuple<NodePos, NodePos, size_t>> edges;
+		std::exception_ptr error;
+	};
+
+	template <typename F>
+	void runInParallel(size_t numThreads, size_t numItems, F f)
+	{
+		if (numThreads <= 1 || numItems <= 1)
+		{
+			for (size_t i = 0; i < numItems; i++) f(i);
+			return;
+		}
+		std::atomic<size_t> nextItem { 0 };
+		std::vector<std::thread> threads;
+		for (size_t thread = 0; thread < numThreads && thread < numItems; thread++)
+		{
+			threads.emplace_back([&nextItem, &f, numItems]()
+			{
+				while (true)
+				{
+					size_t i = nextItem++;
+					if (i >= numItems) break;
+					f(i);
+				}
+			});
+		}
+		for (size_t i = 0; i < threads.size(); i++)
+		{
+			threads[i].join();
+		}
 	}
-	assert(found->second < originalNodeName.size());
-	assert(name == originalNodeName[found->second]);
-	return found->second;
-}
 
-GfaGraph GfaGraph::LoadFromStream(std::istream& file)
-{
-	std::unordered_map<std::string, size_t> nameMapping;
-	GfaGraph result;
-	while (file.good())
+	// splits like operator>> on a stringstream
+	std::string_view nextToken(std::string_view line, size_t& pos)
+	{
+		while (pos < line.size() && std::isspace((unsigned char)line[pos])) pos++;
+		size_t start = pos;
+		while (pos < line.size() && !std::isspace((unsigned char)line[pos])) pos++;
+		return line.substr(start, pos - start);
+	}
+
+	size_t addNameOccurrence(GfaChunk& chunk, std::string_view name, size_t numShards)
 	{
-		std::string line = "";
-		std::getline(file, line);
-		if (line.size() == 0 && !file.good()) break;
-		if (line.size() == 0) continue;
-		if (line[0] != 'S' && line[0] != 'L') continue;
+		size_t index = chunk.names.size();
+		chunk.names.push_back(name);
+		chunk.namesPerShard[std::hash<std::string_view>{}(name) % numShards].push_back(index);
+		return index;
+	}
+
+	void parseGfaLine(GfaChunk& chunk, std::string_view line, size_t numShards)
+	{
+		if (line.size() == 0) return;
+		if (line[0] != 'S' && line[0] != 'L') return;
+		size_t pos = 0;
 		if (line[0] == 'S')
 		{
-			std::stringstream sstr {line};
-			std::string idstr;
-			std::string dummy;
-			std::string seq;
-			sstr >> dummy;
+			std::string_view dummy = nextToken(line, pos);
 			assert(dummy == "S");
-			sstr >> idstr;
-			size_t id = getNameId(nameMapping, idstr, result.nodes, result.originalNodeName);
-			sstr >> seq;
-			if (seq == "*") throw CommonUtils::InvalidGraphException { std::string { "Nodes without sequence (*) are not currently supported (nodeid " + idstr + ")" } };
+			std::string_view idstr = nextToken(line, pos);
+			size_t nameOccurrence = addNameOccurrence(chunk, idstr, numShards);
+			std::string_view seq = nextToken(line, pos);
+			if (seq == "*") throw CommonUtils::InvalidGraphException { std::string { "Nodes without sequence (*) are not currently supported (nodeid " + std::string { idstr } + ")" } };
 			assert(seq.size() >= 1);
-			result.nodes[id] = seq;
+			chunk.segments.push_back(GfaParsedSegment { nameOccurrence, seq });
 		}
 		if (line[0] == 'L')
 		{
-			std::stringstream sstr {line};
-			std::string fromstr;
-			std::string tostr;
-			std::string fromstart;
-			std::string toend;
-			std::string dummy;
-			std::string overlapstr;
-			int overlap = 0;
-			sstr >> dummy;
+			std::string_view dummy = nextToken(line, pos);
 			assert(dummy == "L");
-			sstr >> fromstr;
-			size_t from = getNameId(nameMapping, fromstr, result.nodes, result.originalNodeName);
-			sstr >> fromstart;
-			sstr >> tostr;
-			size_t to = getNameId(nameMapping, tostr, result.nodes, result.originalNodeName);
-			sstr >> toend;
+			std::string_view fromstr = nextToken(line, pos);
+			size_t fromOccurrence = addNameOccurrence(chunk, fromstr, numShards);
+			std::string_view fromstart = nextToken(line, pos);
+			std::string_view tostr = nextToken(line, pos);
+			size_t toOccurrence = addNameOccurrence(chunk, tostr, numShards);
+			std::string_view toend = nextToken(line, pos);
 			assert(fromstart == "+" || fromstart == "-");
 			assert(toend == "+" || toend == "-");
-			sstr >> overlapstr;
+			std::string overlapstr { nextToken(line, pos) };
 			if (overlapstr == "*")
 			{
 				throw CommonUtils::InvalidGraphException { "Unspecified edge overlaps (*) are not supported" };
 			}
 			if (overlapstr == "")
 			{
-				throw CommonUtils::InvalidGraphException { "Edge overlap missing between edges " + fromstr + " and " + tostr };
+				throw CommonUtils::InvalidGraphException { "Edge overlap missing between edges " + std::string { fromstr } + " and " + std::string { tostr } };
 			}
 			assert(overlapstr.size() >= 1);
 			size_t charAfterIndex = 0;
-			overlap = std::stol(overlapstr, &charAfterIndex, 10);
+			long overlap = std::stol(overlapstr, &charAfterIndex, 10);
 			if (charAfterIndex != overlapstr.size() - 1 || overlapstr.back() != 'M')
 			{
 				throw CommonUtils::InvalidGraphException { "Edge overlaps other than exact match are not supported (non supported overlap: " + overlapstr + ")" };
 			}
-			if (overlap < 0) throw CommonUtils::InvalidGraphException { std::string { "Edge overlap between nodes " + std::to_string(from) + " and " + std::to_string(to) + " is negative" } };
-			assert(overlap >= 0);
-			NodePos frompos {(int)from, fromstart == "+"};
-			NodePos topos {(int)to, toend == "+"};
-			result.edges.emplace_back(frompos, topos, overlap);
-			result.edges.emplace_back(topos.Reverse(), frompos.Reverse(), overlap);
+			if (overlap < 0) throw CommonUtils::InvalidGraphException { std::string { "Edge overlap between nodes " + std::string { fromstr } + " and " + std::string { tostr } + " is negative" } };
+			chunk.links.push_back(GfaParsedLink { fromOccurrence, fromstart == "+", toOccurrence, toend == "+", (size_t)overlap });
+		}
+	}
+
+	void parseGfaChunk(GfaChunk& chunk, size_t numShards)
+	{
+		chunk.namesPerShard.resize(numShards);
+		try
+		{
+			size_t lineStart = 0;
+			while (lineStart < chunk.text.size())
+			{
+				size_t lineEnd = chunk.text.find('\n', lineStart);
+				if (lineEnd == std::string_view::npos) lineEnd = chunk.text.size();
+				parseGfaLine(chunk, chunk.text.substr(lineStart, lineEnd - lineStart), numShards);
+				lineStart = lineEnd + 1;
+			}
+		}
+		catch (...)
+		{
+			chunk.error = std::current_exception();
+		}
+		// sized here so that the shard threads only write to their own elements
+		chunk.firstOccurrence.resize(chunk.names.size(), 0);
+		chunk.nameIds.resize(chunk.names.size());
+	}
+
+	// reads line-aligned text into buffer, keeping the unfinished last line for the next batch
+	bool readGfaBatch(std::istream& file, std::string& buffer, std::string& leftover, size_t batchBytes)
+	{
+		buffer.swap(leftover);
+		leftover.clear();
+		size_t oldSize = buffer.size();
+		buffer.resize(oldSize + batchBytes);
+		file.read(buffer.data() + oldSize, batchBytes);
+		buffer.resize(oldSize + file.gcount());
+		if (!file.good()) return buffer.size() > 0;
+		size_t lastNewline = buffer.rfind('\n');
+		if (lastNewline == std::string::npos)
+		{
+			leftover.swap(buffer);
+			buffer.clear();
+			return true;
+		}
+		leftover.assign(buffer.begin() + lastNewline + 1, buffer.end());
+		buffer.resize(lastNewline + 1);
+		return true;
+	}
+
+	std::vector<GfaChunk> splitGfaBatch(const std::string& buffer)
+	{
+		std::vector<GfaChunk> result;
+		size_t start = 0;
+		while (start < buffer.size())
+		{
+			size_t end = std::min(buffer.size(), start + GfaChunkBytes);
+			if (end < buffer.size())
+			{
+				end = buffer.find('\n', end);
+				if (end == std::string::npos) end = buffer.size(); else end += 1;
+			}
+			result.emplace_back();
+			result.back().text = std::string_view { buffer.data() + start, end - start };
+			start = end;
+		}
+		return result;
+	}
+}
+
+GfaGraph GfaGraph::LoadFromStream(std::istream& file)
+{
+	return LoadFromStream(file, 1);
+}
+
+GfaGraph GfaGraph::LoadFromStream(std::istream& file, size_t numThreads)
+{
+	if (numThreads < 1) numThreads = 1;
+	// node ids are assigned in order of first appearance in the file, same as a serial parse, regardless of thread count
+	const size_t numShards = numThreads;
+	std::vector<std::unordered_map<std::string, size_t>> nameShards;
+	nameShards.resize(numShards);
+	GfaGraph result;
+	std::string buffer;
+	std::string leftover;
+	while (readGfaBatch(file, buffer, leftover, GfaChunkBytes * numThreads * 2))
+	{
+		std::vector<GfaChunk> chunks = splitGfaBatch(buffer);
+		runInParallel(numThreads, chunks.size(), [&chunks, numShards](size_t i)
+		{
+			parseGfaChunk(chunks[i], numShards);
+		});
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			if (chunks[i].error) std::rethrow_exception(chunks[i].error);
+		}
+		// find first occurrences of new names, each shard of the name table is owned by one thread
+		runInParallel(numThreads, numShards, [&chunks, &nameShards](size_t shard)
+		{
+			std::string key;
+			for (size_t i = 0; i < chunks.size(); i++)
+			{
+				for (uint32_t occurrence : chunks[i].namesPerShard[shard])
+				{
+					key.assign(chunks[i].names[occurrence].data(), chunks[i].names[occurrence].size());
+					if (nameShards[shard].count(key) == 1) continue;
+					nameShards[shard][key] = UnresolvedNameBit + (i << 32) + occurrence;
+					chunks[i].firstOccurrence[occurrence] = 1;
+				}
+			}
+		});
+		size_t nextId = result.originalNodeName.size();
+		std::vector<size_t> chunkFirstId;
+		chunkFirstId.resize(chunks.size());
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			chunkFirstId[i] = nextId;
+			for (size_t j = 0; j < chunks[i].firstOccurrence.size(); j++)
+			{
+				nextId += chunks[i].firstOccurrence[j];
+			}
+		}
+		result.originalNodeName.resize(nextId);
+		result.nodes.resize(nextId);
+		runInParallel(numThreads, chunks.size(), [&chunks, &chunkFirstId, &result](size_t i)
+		{
+			size_t id = chunkFirstId[i];
+			chunks[i].firstOccurrenceIds.resize(chunks[i].names.size(), std::numeric_limits<size_t>::max());
+			for (size_t j = 0; j < chunks[i].names.size(); j++)
+			{
+				if (!chunks[i].firstOccurrence[j]) continue;
+				chunks[i].firstOccurrenceIds[j] = id;
+				result.originalNodeName[id] = std::string { chunks[i].names[j] };
+				id += 1;
+			}
+		});
+		runInParallel(numThreads, numShards, [&chunks, &nameShards](size_t shard)
+		{
+			std::string key;
+			for (size_t i = 0; i < chunks.size(); i++)
+			{
+				for (uint32_t occurrence : chunks[i].namesPerShard[shard])
+				{
+					key.assign(chunks[i].names[occurrence].data(), chunks[i].names[occurrence].size());
+					auto found = nameShards[shard].find(key);
+					assert(found != nameShards[shard].end());
+					if (found->second & UnresolvedNameBit)
+					{
+						size_t firstChunk = (found->second - UnresolvedNameBit) >> 32;
+						size_t firstOccurrence = found->second & 0xFFFFFFFF;
+						found->second = chunks[firstChunk].firstOccurrenceIds[firstOccurrence];
+					}
+					chunks[i].nameIds[occurrence] = found->second;
+				}
+			}
+		});
+		runInParallel(numThreads, chunks.size(), [&chunks](size_t i)
+		{
+			for (const auto& segment : chunks[i].segments)
+			{
+				chunks[i].nodes.emplace_back(chunks[i].nameIds[segment.nameOccurrence], DNAString { std::string { segment.sequence } });
+			}
+			for (const auto& link : chunks[i].links)
+			{
+				NodePos frompos { (int)chunks[i].nameIds[link.fromOccurrence], link.fromFw };
+				NodePos topos { (int)chunks[i].nameIds[link.toOccurrence], link.toFw };
+				chunks[i].edges.emplace_back(frompos, topos, link.overlap);
+				chunks[i].edges.emplace_back(topos.Reverse(), frompos.Reverse(), link.overlap);
+			}
+		});
+		// merge in file order so that repeated segments and the edge order behave like a serial parse
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			for (auto& node : chunks[i].nodes)
+			{
+				result.nodes[node.first] = std::move(node.second);
+			}
+			result.edges.insert(result.edges.end(), chunks[i].edges.begin(), chunks[i].edges.end());
 		}
 	}
 	for (size_t i = 0; i < result.nodes.size(); i++)
@@ -52,7 +52,9 @@ class GfaGraph
 public:
 	GfaGraph();
 	static GfaGraph LoadFromFile(std::string filename);
+	static GfaGraph LoadFromFile(std::string filename, size_t numThreads);
 	static GfaGraph LoadFromStream(std::istream& stream);
+	static GfaGraph LoadFromStream(std::istream& stream, size_t numThreads);
 	std::string OriginalNodeName(int nodeId) const;
 	size_t totalBp() const;
 	std::vector<DNAString> nodes;
@@ -47,6 +47,7 @@ public:
 		AlignmentResult result;
 		result.readName = seq_id;
 		std::string bwSequence = CommonUtils::ReverseComplement(sequence);
+		reusableState.eqVectors.build(sequence, bwSequence);
 		auto fw = fullstartOneWay(seq_id, reusableState, sequence, bwSequence, 0);
 		if (!fw.alignmentFailed()) result.alignments.emplace_back(std::move(fw));
 		if (DPRestartStride > 0)
@@ -71,6 +72,7 @@ public:
 				}
 			}
 		}
+		reusableState.eqVectors.clear();
 		return result;
 	}
 
@@ -81,6 +83,7 @@ public:
 		result.readName = seq_id;
 		assert(seedClusters.size() > 0);
 		std::string revSequence = CommonUtils::ReverseComplement(sequence);
+		reusableState.eqVectors.build(sequence, revSequence);
 		std::vector<ScoreType> sliceMaxScores;
 		sliceMaxScores.resize(sequence.size() / WordConfiguration<Word>::WordSize + 2, 0);
 		for (size_t i = 0; i < seedClusters.size(); i++)
@@ -98,10 +101,30 @@ public:
 			}
 		}
 		assertSetNoRead(seq_id);
+		reusableState.eqVectors.clear();
 
 		return result;
 	}
 
+	// one cluster of AlignClusters on its own, for aligning the clusters of a read in parallel
+	// the cluster doesn't see the scores of the other clusters, so the result doesn't depend on which clusters were aligned before it
+	std::vector<AlignmentResult::AlignmentItem> AlignCluster(const std::string& seq_id, const std::string& sequence, const std::string& revSequence, const SeedCluster& seedCluster, AlignerGraphsizedState& reusableState) const
+	{
+		assert(params.graph.Finalized());
+		assertSetNoRead(seq_id);
+		reusableState.eqVectors.build(sequence, revSequence);
+		std::vector<ScoreType> sliceMaxScores;
+		sliceMaxScores.resize(sequence.size() / WordConfiguration<Word>::WordSize + 2, 0);
+		auto alns = getAlignmentsFromMultiseeds(sequence, revSequence, seedCluster.hits, reusableState, sliceMaxScores);
+		for (auto& item : alns)
+		{
+			assert(!item.alignmentFailed());
+			item.seedGoodness = seedCluster.clusterGoodness;
+		}
+		reusableState.eqVectors.clear();
+		return alns;
+	}
+
 	void AddAlignment(const std::string& seq_id, const std::string& sequence, AlignmentResult::AlignmentItem& alignment) const
 	{
 		assert(alignment.trace->trace.size() > 0);
@@ -24,6 +24,8 @@ private:
 	using BV = GraphAlignerBitvectorCommon<LengthType, ScoreType, Word>;
 	using Common = GraphAlignerCommon<LengthType, ScoreType, Word>;
 	using AlignerGraphsizedState = typename Common::AlignerGraphsizedState;
+	using EqVectorTable = typename Common::EqVectorTable;
+	using NodeSliceMapPool = typename NodeSlice<LengthType, ScoreType, Word, false>::MapPool;
 	using Params = typename Common::Params;
 	using MatrixPosition = typename Common::MatrixPosition;
 	using Trace = typename Common::Trace;
@@ -110,7 +112,7 @@ public:
 		assert(originalSequence.size() > 1);
 		DPSlice startSlice;
 		startSlice.j = -WordConfiguration<Word>::WordSize;
-		startSlice.scores.addEmptyNodeMap(params.graph.NodeSize());
+		startSlice.scores.addEmptyNodeMap(params.graph.NodeSize(), reusableState.nodeSliceMaps);
 		startSlice.bandwidth = 1;
 		startSlice.minScore = 0;
 		startSlice.minScoreNode = 0;
@@ -221,7 +223,7 @@ private:
 
 #ifdef EXTRACORRECTNESSASSERTIONS
 	template <bool HasVectorMap, bool PreviousHasVectorMap>
-	void checkNodeBoundaryCorrectness(const NodeSlice<LengthType, ScoreType, Word, HasVectorMap>& currentSlice, const NodeSlice<LengthType, ScoreType, Word, PreviousHasVectorMap>& previousSlice, const std::string_view& sequence, size_t j, ScoreType maxScore, ScoreType previousMaxScore, const std::vector<bool>& hasSeedStart, const WordSlice seedstartSlice, const WordSlice fakeSlice) const
+	void checkNodeBoundaryCorrectness(const NodeSlice<LengthType, ScoreType, Word, HasVectorMap>& currentSlice, const NodeSlice<LengthType, ScoreType, Word, PreviousHasVectorMap>& previousSlice, const std::string_view& sequence, size_t j, ScoreType maxScore, ScoreType previousMaxScore, const ResettableBitvector& hasSeedStart, const WordSlice seedstartSlice, const WordSlice fakeSlice) const
 	{
 		assert(previousMaxScore <= maxScore || seedstartSlice.getScoreBeforeStart() <= maxScore);
 		for (auto pair : currentSlice)
@@ -282,7 +284,7 @@ private:
 #endif
 
 	template <bool HasVectorMap, bool PreviousHasVectorMap, typename PriorityQueue>
-	void addSeedHitToScoresAndQueue(const ProcessedSeedHit& seedHit, NodeSlice<LengthType, ScoreType, Word, HasVectorMap>& currentSlice, const NodeSlice<LengthType, ScoreType, Word, PreviousHasVectorMap>& previousSlice, std::vector<bool>& currentBand, const std::vector<bool>& previousBand, PriorityQueue& calculableQueue, const WordSlice extraSlice, phmap::flat_hash_map<size_t, ScoreType>& nodeMaxExactEndposScore, bool storeNodeExactEndposScores) const
+	void addSeedHitToScoresAndQueue(const ProcessedSeedHit& seedHit, NodeSlice<LengthType, ScoreType, Word, HasVectorMap>& currentSlice, const NodeSlice<LengthType, ScoreType, Word, PreviousHasVectorMap>& previousSlice, SliceBand& currentBand, const SliceBand& previousBand, PriorityQueue& calculableQueue, const WordSlice extraSlice, phmap::flat_hash_map<size_t, ScoreType>& nodeMaxExactEndposScore, bool storeNodeExactEndposScores) const
 	{
 #ifdef SLICEVERBOSE
 		std::cerr << " " << seedHit.alignmentGraphNodeId << "(" << params.graph.BigraphNodeID(seedHit.alignmentGraphNodeId) << ")";
@@ -298,7 +300,7 @@ private:
 	}
 
 	template <bool HasVectorMap, bool PreviousHasVectorMap, typename PriorityQueue>
-	NodeCalculationResult calculateSlice(const std::string_view& sequence, const size_t j, NodeSlice<LengthType, ScoreType, Word, HasVectorMap>& currentSlice, const NodeSlice<LengthType, ScoreType, Word, PreviousHasVectorMap>& previousSlice, std::vector<bool>& currentBand, const std::vector<bool>& previousBand, PriorityQueue& calculableQueue, ScoreType previousQuitScore, ScoreType bandwidth, ScoreType previousMinScore, const std::vector<ProcessedSeedHit>& seedHits, size_t seedhitStart, size_t seedhitEnd, const WordSlice seedstartSlice, std::vector<bool>& hasSeedStart, std::unordered_set<size_t>& seedstartNodes, phmap::flat_hash_map<size_t, ScoreType>& nodeMaxExactEndposScore, bool storeNodeExactEndposScores, const std::vector<bool>& allowedBigraphNodesThisSlice) const
+	NodeCalculationResult calculateSlice(const std::string_view& sequence, const size_t j, NodeSlice<LengthType, ScoreType, Word, HasVectorMap>& currentSlice, const NodeSlice<LengthType, ScoreType, Word, PreviousHasVectorMap>& previousSlice, SliceBand& currentBand, const SliceBand& previousBand, PriorityQueue& calculableQueue, ScoreType previousQuitScore, ScoreType bandwidth, ScoreType previousMinScore, const std::vector<ProcessedSeedHit>& seedHits, size_t seedhitStart, size_t seedhitEnd, const WordSlice seedstartSlice, ResettableBitvector& hasSeedStart, std::unordered_set<size_t>& seedstartNodes, phmap::flat_hash_map<size_t, ScoreType>& nodeMaxExactEndposScore, bool storeNodeExactEndposScores, const ResettableBitvector& allowedBigraphNodesThisSlice, const EqVectorTable& eqVectors) const
 	{
 		if (previousMinScore == std::numeric_limits<ScoreType>::max() - bandwidth - 1)
 		{
@@ -359,7 +361,7 @@ private:
 		result.nodesProcessed = 0;
 #endif
 
-		EqVector EqV = BV::getEqVector(sequence, j);
+		EqVector EqV = BV::getEqVector(eqVectors, sequence, j);
 
 		assert(previousSlice.size() > 0 || seedhitStart != std::numeric_limits<size_t>::max());
 		ScoreType zeroScore = previousMinScore*priorityMismatchPenalty - j - 64;
@@ -614,7 +616,7 @@ private:
 	}
 
 	template <typename PriorityQueue>
-	void fillDPSlice(const std::string_view& sequence, DPSlice& slice, const DPSlice& previousSlice, const std::vector<bool>& previousBand, std::vector<bool>& currentBand, PriorityQueue& calculableQueue, ScoreType bandwidth, const std::vector<ProcessedSeedHit>& seedHits, size_t seedhitStart, size_t seedhitEnd, const WordSlice extraSlice, std::vector<bool>& hasSeedStart, bool storeNodeExactEndposScores, const std::vector<bool>& allowedBigraphNodesThisSlice) const
+	void fillDPSlice(const std::string_view& sequence, DPSlice& slice, const DPSlice& previousSlice, const SliceBand& previousBand, SliceBand& currentBand, PriorityQueue& calculableQueue, ScoreType bandwidth, const std::vector<ProcessedSeedHit>& seedHits, size_t seedhitStart, size_t seedhitEnd, const WordSlice extraSlice, ResettableBitvector& hasSeedStart, bool storeNodeExactEndposScores, const ResettableBitvector& allowedBigraphNodesThisSlice, const EqVectorTable& eqVectors) const
 	{
 		NodeCalculationResult sliceResult;
 		assert((ScoreType)previousSlice.bandwidth < std::numeric_limits<ScoreType>::max());
@@ -624,18 +626,18 @@ private:
 		{
 			if (previousSlice.scoresVectorMap.hasVectorMapCurrently())
 			{
-				sliceResult = calculateSlice<true, true>(sequence, slice.j, slice.scoresVectorMap, previousSlice.scoresVectorMap, currentBand, previousBand, calculableQueue, previousSlice.minScore + previousSlice.bandwidth, bandwidth, previousSlice.minScore, seedHits, seedhitStart, seedhitEnd, extraSlice, hasSeedStart, slice.seedstartNodes, slice.nodeMaxExactEndposScore, storeNodeExactEndposScores, allowedBigraphNodesThisSlice);
+				sliceResult = calculateSlice<true, true>(sequence, slice.j, slice.scoresVectorMap, previousSlice.scoresVectorMap, currentBand, previousBand, calculableQueue, previousSlice.minScore + previousSlice.bandwidth, bandwidth, previousSlice.minScore, seedHits, seedhitStart, seedhitEnd, extraSlice, hasSeedStart, slice.seedstartNodes, slice.nodeMaxExactEndposScore, storeNodeExactEndposScores, allowedBigraphNodesThisSlice, eqVectors);
 			}
 			else
 			{
-				sliceResult = calculateSlice<true, false>(sequence, slice.j, slice.scoresVectorMap, previousSlice.scores, currentBand, previousBand, calculableQueue, previousSlice.minScore + previousSlice.bandwidth, bandwidth, previousSlice.minScore, seedHits, seedhitStart, seedhitEnd, extraSlice, hasSeedStart, slice.seedstartNodes, slice.nodeMaxExactEndposScore, storeNodeExactEndposScores, allowedBigraphNodesThisSlice);
+				sliceResult = calculateSlice<true, false>(sequence, slice.j, slice.scoresVectorMap, previousSlice.scores, currentBand, previousBand, calculableQueue, previousSlice.minScore + previousSlice.bandwidth, bandwidth, previousSlice.minScore, seedHits, seedhitStart, seedhitEnd, extraSlice, hasSeedStart, slice.seedstartNodes, slice.nodeMaxExactEndposScore, storeNodeExactEndposScores, allowedBigraphNodesThisSlice, eqVectors);
 			}
 			slice.scores = slice.scoresVectorMap.getMapSlice();
 		}
 		else
 		{
 			assert(!previousSlice.scoresVectorMap.hasVectorMapCurrently());
-			sliceResult = calculateSlice<false, false>(sequence, slice.j, slice.scores, previousSlice.scores, currentBand, previousBand, calculableQueue, previousSlice.minScore + previousSlice.bandwidth, bandwidth, previousSlice.minScore, seedHits, seedhitStart, seedhitEnd, extraSlice, hasSeedStart, slice.seedstartNodes, slice.nodeMaxExactEndposScore, storeNodeExactEndposScores, allowedBigraphNodesThisSlice);
+			sliceResult = calculateSlice<false, false>(sequence, slice.j, slice.scores, previousSlice.scores, currentBand, previousBand, calculableQueue, previousSlice.minScore + previousSlice.bandwidth, bandwidth, previousSlice.minScore, seedHits, seedhitStart, seedhitEnd, extraSlice, hasSeedStart, slice.seedstartNodes, slice.nodeMaxExactEndposScore, storeNodeExactEndposScores, allowedBigraphNodesThisSlice, eqVectors);
 		}
 		slice.cellsProcessed = sliceResult.cellsProcessed;
 		slice.minScoreNode = sliceResult.minScoreNode;
@@ -664,15 +666,136 @@ private:
 	}
 
 	template <typename PriorityQueue>
-	DPSlice pickMethodAndExtendFill(const std::string_view& sequence, const DPSlice& previous, const std::vector<bool>& previousBand, std::vector<bool>& currentBand, PriorityQueue& calculableQueue, ScoreType bandwidth, const std::vector<ProcessedSeedHit>& seedHits, size_t seedhitStart, size_t seedhitEnd, const WordSlice extraSlice, std::vector<bool>& hasSeedStart, bool storeNodeExactEndposScores, const std::vector<bool>& allowedBigraphNodesThisSlice) const
+	DPSlice pickMethodAndExtendFill(const std::string_view& sequence, const DPSlice& previous, const SliceBand& previousBand, SliceBand& currentBand, PriorityQueue& calculableQueue, ScoreType bandwidth, const std::vector<ProcessedSeedHit>& seedHits, size_t seedhitStart, size_t seedhitEnd, const WordSlice extraSlice, ResettableBitvector& hasSeedStart, bool storeNodeExactEndposScores, const ResettableBitvector& allowedBigraphNodesThisSlice, const EqVectorTable& eqVectors, NodeSliceMapPool& nodeSliceMaps) const
 	{
 		DPSlice bandTest;
-		bandTest.scores.addEmptyNodeMap(previous.scores.size());
+		bandTest.scores.addEmptyNodeMap(previous.scores.size(), nodeSliceMaps);
 		bandTest.j = previous.j + WordConfiguration<Word>::WordSize;
-		fillDPSlice(sequence, bandTest, previous, previousBand, currentBand, calculableQueue, bandwidth, seedHits, seedhitStart, seedhitEnd, extraSlice, hasSeedStart, storeNodeExactEndposScores, allowedBigraphNodesThisSlice);
+		fillDPSlice(sequence, bandTest, previous, previousBand, currentBand, calculableQueue, bandwidth, seedHits, seedhitStart, seedhitEnd, extraSlice, hasSeedStart, storeNodeExactEndposScores, allowedBigraphNodesThisSlice, eqVectors);
 		return bandTest;
 	}
 
+	// the per-slice decisions of getXdropSlices / getMultiseedSlices, so that slices whose scores were dropped can be calculated again identically
+	class SliceReplay
+	{
+	public:
+		bool multiseed;
+		bool useComponentQueue;
+		std::vector<size_t> seedhitStart;
+		std::vector<bool> seedReset;
+		// the nodes of the forbidden spans, and their allowance when the slice after each checkpoint was calculated
+		std::vector<size_t> allowanceNodes;
+		std::vector<std::pair<size_t, std::vector<bool>>> checkpointAllowance;
+		std::pair<std::vector<std::vector<size_t>>, std::vector<std::vector<size_t>>> nodeAllowanceVectors;
+	};
+
+	void initAllowanceReplay(SliceReplay& replay, const std::vector<std::tuple<size_t, int, int>>& forbiddenNodes) const
+	{
+		for (auto t : forbiddenNodes)
+		{
+			replay.allowanceNodes.push_back(std::get<0>(t));
+		}
+		std::sort(replay.allowanceNodes.begin(), replay.allowanceNodes.end());
+		replay.allowanceNodes.erase(std::unique(replay.allowanceNodes.begin(), replay.allowanceNodes.end()), replay.allowanceNodes.end());
+	}
+
+	// the checkpoints only get sparser, so every final checkpoint is recorded when its slice is calculated
+	void recordAllowance(SliceReplay& replay, const DPTable& table, size_t slice, const ResettableBitvector& allowedBigraphNodesThisSlice) const
+	{
+		if (replay.allowanceNodes.size() == 0 || slice % table.checkpointInterval != 0) return;
+		std::vector<bool> allowed;
+		allowed.reserve(replay.allowanceNodes.size());
+		for (size_t node : replay.allowanceNodes)
+		{
+			allowed.push_back(allowedBigraphNodesThisSlice[node]);
+		}
+		replay.checkpointAllowance.emplace_back(slice, std::move(allowed));
+	}
+
+	void dropNonCheckpointAllowance(SliceReplay& replay, const DPTable& table) const
+	{
+		size_t interval = table.checkpointInterval;
+		replay.checkpointAllowance.erase(std::remove_if(replay.checkpointAllowance.begin(), replay.checkpointAllowance.end(), [interval](const std::pair<size_t, std::vector<bool>>& item) { return item.first % interval != 0; }), replay.checkpointAllowance.end());
+	}
+
+	void resetMultiseedSlice(DPSlice& slice, const WordSlice& seedSlice, SliceBand& currentBand) const
+	{
+		currentBand.clear();
+		slice.minScore = seedSlice.getScoreBeforeStart();
+		slice.minScoreNode = std::numeric_limits<LengthType>::max();
+		slice.maxExactEndposScore = std::numeric_limits<ScoreType>::min();
+		slice.maxExactEndposNode = std::numeric_limits<LengthType>::max();
+		slice.nodeMaxExactEndposScore.clear();
+		slice.seedstartNodes.clear();
+		slice.scores.clear();
+	}
+
+	// calculates the slices first..last again starting from the full slice first-1. Uses the band and queue scratch space, which is unused during backtrace
+	std::vector<DPSlice> recalculateSlices(const std::string_view& sequence, const DPSlice& checkpoint, size_t first, size_t last, const std::vector<ProcessedSeedHit>& seedHits, const SliceReplay& replay, AlignerGraphsizedState& reusableState) const
+	{
+		assert(first > 0);
+		assert(last >= first);
+		std::vector<DPSlice> result;
+		// previous slices are referenced while the next one is calculated
+		result.reserve(last - first + 1);
+		// only the nodes of the forbidden spans change during the slices, the rest of the graph is as it was in the forward pass
+		std::vector<bool> allowedBefore;
+		if (replay.allowanceNodes.size() > 0)
+		{
+			auto checkpointAllowance = std::lower_bound(replay.checkpointAllowance.begin(), replay.checkpointAllowance.end(), first - 1, [](const std::pair<size_t, std::vector<bool>>& item, size_t slice) { return item.first < slice; });
+			assert(checkpointAllowance != replay.checkpointAllowance.end());
+			assert(checkpointAllowance->first == first - 1);
+			allowedBefore.reserve(replay.allowanceNodes.size());
+			for (size_t i = 0; i < replay.allowanceNodes.size(); i++)
+			{
+				allowedBefore.push_back(reusableState.allowedBigraphNodesThisSlice[replay.allowanceNodes[i]]);
+				reusableState.allowedBigraphNodesThisSlice[replay.allowanceNodes[i]] = (bool)checkpointAllowance->second[i];
+			}
+		}
+		for (auto node : checkpoint.scores)
+		{
+			assert(!reusableState.previousBand[node.first]);
+			reusableState.previousBand[node.first] = true;
+		}
+		std::vector<ProcessedSeedHit> fakeSeeds;
+		WordSlice fakeSlice { WordConfiguration<Word>::AllZeros, WordConfiguration<Word>::AllZeros, std::numeric_limits<ScoreType>::max() };
+		for (size_t i = first; i <= last; i++)
+		{
+			const DPSlice& previous = (i == first) ? checkpoint : result.back();
+			size_t slice = i - 1;
+			if (replay.allowanceNodes.size() > 0) fixAllowedNodes(reusableState.allowedBigraphNodesThisSlice, replay.nodeAllowanceVectors, slice);
+			DPSlice newSlice;
+			if (replay.multiseed)
+			{
+				WordSlice seedSlice = BV::getSeedSlice(previous.j + WordConfiguration<Word>::WordSize, sequence.size(), params);
+				newSlice = pickMethodAndExtendFill(sequence, previous, reusableState.previousBand, reusableState.currentBand, reusableState.componentQueue, params.alignmentBandwidth, seedHits, replay.seedhitStart[slice], replay.seedhitStart[slice+1], seedSlice, reusableState.hasSeedStart, true, reusableState.allowedBigraphNodesThisSlice, reusableState.eqVectors, reusableState.nodeSliceMaps);
+				if (replay.seedReset[slice]) resetMultiseedSlice(newSlice, seedSlice, reusableState.currentBand);
+			}
+			else if (replay.useComponentQueue)
+			{
+				newSlice = pickMethodAndExtendFill(sequence, previous, reusableState.previousBand, reusableState.currentBand, reusableState.componentQueue, params.alignmentBandwidth, fakeSeeds, std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::max(), fakeSlice, reusableState.hasSeedStart, false, reusableState.allowedBigraphNodesThisSlice, reusableState.eqVectors, reusableState.nodeSliceMaps);
+			}
+			else
+			{
+				newSlice = pickMethodAndExtendFill(sequence, previous, reusableState.previousBand, reusableState.currentBand, reusableState.calculableQueue, params.alignmentBandwidth, fakeSeeds, std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::max(), fakeSlice, reusableState.hasSeedStart, false, reusableState.allowedBigraphNodesThisSlice, reusableState.eqVectors, reusableState.nodeSliceMaps);
+			}
+			if (newSlice.cellsProcessed >= params.maxCellsPerSlice)
+			{
+				newSlice.scoresNotValid = true;
+			}
+			reusableState.previousBand.clear();
+			std::swap(reusableState.previousBand, reusableState.currentBand);
+			newSlice.scoresVectorMap.removeVectorArray();
+			result.push_back(std::move(newSlice));
+		}
+		reusableState.previousBand.clear();
+		for (size_t i = 0; i < allowedBefore.size(); i++)
+		{
+			reusableState.allowedBigraphNodesThisSlice[replay.allowanceNodes[i]] = (bool)allowedBefore[i];
+		}
+		return result;
+	}
+
 	DPTable getSlices(const std::string_view& sequence, const DPSlice& initialSlice, size_t numSlices, int Xdropcutoff, AlignerGraphsizedState& reusableState, const std::vector<std::tuple<size_t, int, int>>& forbiddenNodes) const
 	{
 		return getXdropSlices(sequence, initialSlice, numSlices, Xdropcutoff, forbiddenNodes, reusableState);
@@ -695,7 +818,6 @@ private:
 #ifndef NDEBUG
 		debugLastRowMinScore = 0;
 #endif
-		DPSlice lastSlice = initialSlice;
 		result.slices.push_back(initialSlice);
 		ScoreType bestXScore = initialSlice.maxExactEndposScore;
 		assert(bestXScore != std::numeric_limits<ScoreType>::min());
@@ -708,8 +830,14 @@ private:
 		std::vector<ProcessedSeedHit> fakeSeeds;
 		WordSlice fakeSlice { WordConfiguration<Word>::AllZeros, WordConfiguration<Word>::AllZeros, std::numeric_limits<ScoreType>::max() };
 		auto nodeAllowanceVectors = getNodeAllowanceVectors(forbiddenNodes, numSlices);
+		SliceReplay replay;
+		replay.multiseed = false;
+		replay.useComponentQueue = reusableState.componentQueue.valid();
+		if (params.maxDPTableBytes > 0) initAllowanceReplay(replay, forbiddenNodes);
 		for (size_t slice = 0; slice < numSlices; slice++)
 		{
+			// stays valid until newSlice is moved into the table at the end of the iteration
+			const DPSlice& lastSlice = result.slices.back();
 			int bandwidth = params.alignmentBandwidth;
 #ifndef NDEBUG
 			debugLastProcessedSlice = slice;
@@ -719,14 +847,15 @@ private:
 			auto timeStart = std::chrono::system_clock::now();
 #endif
 			DPSlice newSlice;
+			recordAllowance(replay, result, slice, reusableState.allowedBigraphNodesThisSlice);
 			fixAllowedNodes(reusableState.allowedBigraphNodesThisSlice, nodeAllowanceVectors, slice);
 			if (reusableState.componentQueue.valid())
 			{
-				newSlice = pickMethodAndExtendFill(sequence, lastSlice, reusableState.previousBand, reusableState.currentBand, reusableState.componentQueue, bandwidth, fakeSeeds, std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::max(), fakeSlice, reusableState.hasSeedStart, false, reusableState.allowedBigraphNodesThisSlice);
+				newSlice = pickMethodAndExtendFill(sequence, lastSlice, reusableState.previousBand, reusableState.currentBand, reusableState.componentQueue, bandwidth, fakeSeeds, std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::max(), fakeSlice, reusableState.hasSeedStart, false, reusableState.allowedBigraphNodesThisSlice, reusableState.eqVectors, reusableState.nodeSliceMaps);
 			}
 			else
 			{
-				newSlice = pickMethodAndExtendFill(sequence, lastSlice, reusableState.previousBand, reusableState.currentBand, reusableState.calculableQueue, bandwidth, fakeSeeds, std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::max(), fakeSlice, reusableState.hasSeedStart, false, reusableState.allowedBigraphNodesThisSlice);
+				newSlice = pickMethodAndExtendFill(sequence, lastSlice, reusableState.previousBand, reusableState.currentBand, reusableState.calculableQueue, bandwidth, fakeSeeds, std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::max(), fakeSlice, reusableState.hasSeedStart, false, reusableState.allowedBigraphNodesThisSlice, reusableState.eqVectors, reusableState.nodeSliceMaps);
 			}
 #ifdef SLICEVERBOSE
 			auto timeEnd = std::chrono::system_clock::now();
@@ -756,17 +885,8 @@ private:
 #ifndef NDEBUG
 				debugLastProcessedSlice = slice-1;
 #endif
-				for (auto node : lastSlice.scores)
-				{
-					assert(reusableState.previousBand[node.first]);
-					reusableState.previousBand[node.first] = false;
-				}
-				for (auto node : newSlice.scores)
-				{
-					assert(reusableState.currentBand[node.first]);
-					reusableState.currentBand[node.first] = false;
-				}
-				lastSlice.scoresVectorMap.removeVectorArray();
+				reusableState.previousBand.clear();
+				reusableState.currentBand.clear();
 				newSlice.scoresVectorMap.removeVectorArray();
 				break;
 			}
@@ -775,33 +895,34 @@ private:
 			std::cerr << std::endl;
 #endif
 
-			result.slices.push_back(newSlice.getMapSlice());
-			for (auto node : lastSlice.scores)
-			{
-				assert(reusableState.previousBand[node.first]);
-				reusableState.previousBand[node.first] = false;
-			}
+			reusableState.previousBand.clear();
 			assert(newSlice.minScore != std::numeric_limits<ScoreType>::max());
 			assert(newSlice.minScore >= lastSlice.minScore);
 			if (slice == numSlices - 1)
 			{
-				for (auto node : newSlice.scores)
-				{
-					assert(reusableState.currentBand[node.first]);
-					reusableState.currentBand[node.first] = false;
-				}
+				reusableState.currentBand.clear();
 			}
 			else
 			{
 				std::swap(reusableState.previousBand, reusableState.currentBand);
 			}
-			lastSlice.scoresVectorMap.removeVectorArray();
-			lastSlice = std::move(newSlice);
+			newSlice.scoresVectorMap.removeVectorArray();
+			result.addSlice(std::move(newSlice), params.maxDPTableBytes);
 		}
-		lastSlice.scoresVectorMap.removeVectorArray();
 
 		assert(result.slices.size() <= numSlices + 1);
 
+		if (result.hasDroppedScores())
+		{
+			replay.nodeAllowanceVectors = std::move(nodeAllowanceVectors);
+			dropNonCheckpointAllowance(replay, result);
+			result.recalculate = [this, sequence, &reusableState, replay=std::move(replay)](const DPSlice& checkpoint, size_t first, size_t last)
+			{
+				std::vector<ProcessedSeedHit> noSeeds;
+				return recalculateSlices(sequence, checkpoint, first, last, noSeeds, replay, reusableState);
+			};
+		}
+
 #ifdef EXTRACORRECTNESSASSERTIONS
 		assert(reusableState.calculableQueue.size() == 0);
 		for (size_t i = 0; i < reusableState.currentBand.size(); i++)
@@ -838,13 +959,13 @@ private:
 			size_t forbidslice = 0;
 			if (std::get<1>(t) >= 1)
 			{
-				forbidslice = (std::get<1>(t) + 63) / 64;
+				forbidslice = (std::get<1>(t) + WordConfiguration<Word>::WordSize - 1) / WordConfiguration<Word>::WordSize;
 				if (forbidslice >= numSlices) forbidslice = numSlices-1;
 			}
 			size_t allowslice = 0;
 			if (std::get<2>(t) >= 1)
 			{
-				allowslice = std::get<2>(t) / 64;
+				allowslice = std::get<2>(t) / WordConfiguration<Word>::WordSize;
 				if (allowslice >= numSlices) allowslice = numSlices-1;
 			}
 			if (forbidslice == allowslice) continue;
@@ -857,7 +978,7 @@ private:
 		return std::make_pair(std::move(newlyAllowed), std::move(newlyForbidden));
 	}
 
-	void fixAllowedNodes(std::vector<bool>& allowedBigraphNodesThisSlice, const std::pair<std::vector<std::vector<size_t>>, std::vector<std::vector<size_t>>>& nodeAllowanceVectors, const size_t slice) const
+	void fixAllowedNodes(ResettableBitvector& allowedBigraphNodesThisSlice, const std::pair<std::vector<std::vector<size_t>>, std::vector<std::vector<size_t>>>& nodeAllowanceVectors, const size_t slice) const
 	{
 		assert(slice < nodeAllowanceVectors.first.size());
 		assert(slice < nodeAllowanceVectors.second.size());
@@ -883,18 +1004,29 @@ private:
 		DPTable result;
 		result.slices.reserve(numSlices + 1);
 		size_t cellsProcessed = 0;
-		DPSlice lastSlice = initialSlice;
 		result.slices.push_back(initialSlice);
 		size_t lastSeedHit = 0;
 		ScoreType XDropCurrentBest = 0;
 		assert(params.Xdropcutoff > 0);
 		auto nodeAllowanceVectors = getNodeAllowanceVectors(forbiddenNodes, numSlices);
+		SliceReplay replay;
+		replay.multiseed = true;
+		replay.useComponentQueue = true;
+		if (params.maxDPTableBytes > 0)
+		{
+			replay.seedhitStart.reserve(numSlices + 1);
+			replay.seedReset.reserve(numSlices);
+			initAllowanceReplay(replay, forbiddenNodes);
+		}
 		for (size_t slice = 0; slice < numSlices; slice++)
 		{
+			// stays valid until newSlice is moved into the table at the end of the iteration
+			const DPSlice& lastSlice = result.slices.back();
 			int bandwidth = params.alignmentBandwidth;
 #ifdef SLICEVERBOSE
 			auto timeStart = std::chrono::system_clock::now();
 #endif
+			recordAllowance(replay, result, slice, reusableState.allowedBigraphNodesThisSlice);
 			fixAllowedNodes(reusableState.allowedBigraphNodesThisSlice, nodeAllowanceVectors, slice);
 			size_t nextSeedHit = lastSeedHit;
 			assert(nextSeedHit == seedHits.size() || seedHits[nextSeedHit].seqPos / WordConfiguration<Word>::WordSize >= (lastSlice.j + WordConfiguration<Word>::WordSize) / WordConfiguration<Word>::WordSize);
@@ -911,22 +1043,15 @@ private:
 			assert(possibleScoreRemaining > 0);
 			// // can't get an alignment which would be backtraced. fake set the seed set to be empty
 			// if (possibleScoreRemaining < sliceMaxScores[slice]) lastSeedHit = nextSeedHit;
-			DPSlice newSlice = pickMethodAndExtendFill(sequence, lastSlice, reusableState.previousBand, reusableState.currentBand, reusableState.componentQueue, bandwidth, seedHits, lastSeedHit, nextSeedHit, seedSlice, reusableState.hasSeedStart, true, reusableState.allowedBigraphNodesThisSlice);
+			DPSlice newSlice = pickMethodAndExtendFill(sequence, lastSlice, reusableState.previousBand, reusableState.currentBand, reusableState.componentQueue, bandwidth, seedHits, lastSeedHit, nextSeedHit, seedSlice, reusableState.hasSeedStart, true, reusableState.allowedBigraphNodesThisSlice, reusableState.eqVectors, reusableState.nodeSliceMaps);
+			if (params.maxDPTableBytes > 0) replay.seedhitStart.push_back(lastSeedHit);
 			lastSeedHit = nextSeedHit;
 			XDropCurrentBest = std::max(XDropCurrentBest, newSlice.maxExactEndposScore);
-			if (newSlice.maxExactEndposScore < XDropCurrentBest - params.Xdropcutoff)
+			bool reset = newSlice.maxExactEndposScore < XDropCurrentBest - params.Xdropcutoff;
+			if (params.maxDPTableBytes > 0) replay.seedReset.push_back(reset);
+			if (reset)
 			{
-				for (auto node : newSlice.scores)
-				{
-					reusableState.currentBand[node.first] = false;
-				}
-				newSlice.minScore = seedSlice.getScoreBeforeStart();
-				newSlice.minScoreNode = std::numeric_limits<LengthType>::max();
-				newSlice.maxExactEndposScore = std::numeric_limits<ScoreType>::min();
-				newSlice.maxExactEndposNode = std::numeric_limits<LengthType>::max();
-				newSlice.nodeMaxExactEndposScore.clear();
-				newSlice.seedstartNodes.clear();
-				newSlice.scores.clear();
+				resetMultiseedSlice(newSlice, seedSlice, reusableState.currentBand);
 				XDropCurrentBest = 0;
 			}
 #ifdef SLICEVERBOSE
@@ -948,32 +1073,33 @@ private:
 			std::cerr << std::endl;
 #endif
 
-			result.slices.push_back(newSlice.getMapSlice());
-			for (auto node : lastSlice.scores)
-			{
-				assert(reusableState.previousBand[node.first]);
-				reusableState.previousBand[node.first] = false;
-			}
+			reusableState.previousBand.clear();
 			if (slice == numSlices - 1)
 			{
-				for (auto node : newSlice.scores)
-				{
-					assert(reusableState.currentBand[node.first]);
-					reusableState.currentBand[node.first] = false;
-				}
+				reusableState.currentBand.clear();
 			}
 			else
 			{
 				std::swap(reusableState.previousBand, reusableState.currentBand);
 			}
-			lastSlice.scoresVectorMap.removeVectorArray();
-			lastSlice = std::move(newSlice);
+			newSlice.scoresVectorMap.removeVectorArray();
+			result.addSlice(std::move(newSlice), params.maxDPTableBytes);
 		}
 		assert(lastSeedHit == seedHits.size());
-		lastSlice.scoresVectorMap.removeVectorArray();
 
 		assert(result.slices.size() == numSlices + 1);
 
+		if (result.hasDroppedScores())
+		{
+			replay.seedhitStart.push_back(lastSeedHit);
+			replay.nodeAllowanceVectors = std::move(nodeAllowanceVectors);
+			dropNonCheckpointAllowance(replay, result);
+			result.recalculate = [this, sequence, &reusableState, &seedHits, replay=std::move(replay)](const DPSlice& checkpoint, size_t first, size_t last)
+			{
+				return recalculateSlices(sequence, checkpoint, first, last, seedHits, replay, reusableState);
+			};
+		}
+
 #ifdef EXTRACORRECTNESSASSERTIONS
 		assert(reusableState.calculableQueue.size() == 0);
 		for (size_t i = 0; i < reusableState.currentBand.size(); i++)
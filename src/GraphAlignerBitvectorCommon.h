@@ -6,6 +6,8 @@
 #include <vector>
 #include <cmath>
 #include <iostream>
+#include <functional>
+#include <tuple>
 #include "AlignmentGraph.h"
 #include "NodeSlice.h"
 #include "CommonUtils.h"
@@ -191,35 +193,124 @@ public:
 		size_t nodesProcessed;
 		size_t numCells;
 #endif
-		DPSlice getMapSlice() const
-		{
-			DPSlice result;
-			result.minScore = minScore;
-			result.minScoreNode = minScoreNode;
-			result.minScoreNodeOffset = minScoreNodeOffset;
-			result.maxExactEndposNode = maxExactEndposNode;
-			result.maxExactEndposScore = maxExactEndposScore;
-			result.scores = scores;
-			result.j = j;
-			result.cellsProcessed = cellsProcessed;
-			result.bandwidth = bandwidth;
-			result.scoresNotValid = scoresNotValid;
-			result.seedstartNodes = seedstartNodes;
-			result.nodeMaxExactEndposScore = nodeMaxExactEndposScore;
-#ifdef SLICEVERBOSE
-			result.nodesProcessed = nodesProcessed;
-			result.numCells = numCells;
-#endif
-			return result;
-		}
 	};
 	class DPTable
 	{
 	public:
 		DPTable() :
-		slices()
+		slices(),
+		checkpointInterval(1),
+		scoresDropped(),
+		recalculate(),
+		storedBytes(0),
+		allBytes(0),
+		sliceBytes(),
+		cachedBlocks(),
+		cachedBlockStart { std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::max() },
+		lastUsedCache(0)
 		{}
+		// the slice with its node scores. Slices whose scores were dropped are recalculated from the checkpoint before them.
+		// the two most recently used blocks are kept, so a slice and its neighbours stay valid together during a backtrace
+		const DPSlice& withScores(size_t index) const
+		{
+			assert(index < slices.size());
+			if (scoresDropped.size() == 0 || !scoresDropped[index]) return slices[index];
+			assert(checkpointInterval > 1);
+			size_t blockStart = index - index % checkpointInterval;
+			assert(!scoresDropped[blockStart]);
+			for (size_t i = 0; i < 2; i++)
+			{
+				if (cachedBlockStart[i] != blockStart) continue;
+				lastUsedCache = i;
+				return cachedBlocks[i][index - blockStart - 1];
+			}
+			size_t replace = 1 - lastUsedCache;
+			size_t blockEnd = std::min(blockStart + checkpointInterval, slices.size()) - 1;
+			// release the old block first so its node maps can be reused
+			cachedBlocks[replace].clear();
+			cachedBlocks[replace] = recalculate(slices[blockStart], blockStart + 1, blockEnd);
+			assert(cachedBlocks[replace].size() == blockEnd - blockStart);
+#ifndef NDEBUG
+			for (size_t i = 0; i < cachedBlocks[replace].size(); i++)
+			{
+				assert(cachedBlocks[replace][i].j == slices[blockStart + 1 + i].j);
+				assert(cachedBlocks[replace][i].minScore == slices[blockStart + 1 + i].minScore);
+				assert(cachedBlocks[replace][i].maxExactEndposScore == slices[blockStart + 1 + i].maxExactEndposScore);
+			}
+#endif
+			cachedBlockStart[replace] = blockStart;
+			lastUsedCache = replace;
+			return cachedBlocks[replace][index - blockStart - 1];
+		}
+		// appends a finished slice. If the full slices and the two recalculated blocks take more than maxBytes, the checkpoint interval
+		// is doubled and the scores of the slices between checkpoints are dropped. The last slice is never dropped since the next one is calculated from it
+		void addSlice(DPSlice&& slice, size_t maxBytes)
+		{
+			slices.emplace_back(std::move(slice));
+			if (maxBytes == 0) return;
+			// also covers slices which were added directly to slices
+			while (sliceBytes.size() < slices.size())
+			{
+				sliceBytes.push_back(estimateBytes(slices[sliceBytes.size()]));
+				scoresDropped.push_back(false);
+				storedBytes += sliceBytes.back();
+				allBytes += sliceBytes.back();
+			}
+			if (slices.size() >= 3 && (slices.size() - 2) % checkpointInterval != 0) dropScores(slices.size() - 2);
+			while (checkpointInterval < slices.size() && storedBytes + recalculatedBytes(checkpointInterval) > maxBytes)
+			{
+				size_t droppedBytes = 0;
+				for (size_t i = checkpointInterval; i + 1 < slices.size(); i += checkpointInterval * 2)
+				{
+					droppedBytes += sliceBytes[i];
+				}
+				// past this point longer blocks cost more than the dropped checkpoints save
+				if (recalculatedBytes(checkpointInterval * 2) >= recalculatedBytes(checkpointInterval) + droppedBytes) break;
+				checkpointInterval *= 2;
+				for (size_t i = checkpointInterval / 2; i + 1 < slices.size(); i += checkpointInterval)
+				{
+					dropScores(i);
+				}
+			}
+		}
+		bool hasDroppedScores() const
+		{
+			return checkpointInterval > 1;
+		}
 		std::vector<DPSlice> slices;
+		size_t checkpointInterval;
+		std::vector<bool> scoresDropped;
+		// recalculates the slices first..last given the full slice first-1
+		std::function<std::vector<DPSlice>(const DPSlice&, size_t, size_t)> recalculate;
+	private:
+		void dropScores(size_t index)
+		{
+			if (scoresDropped[index]) return;
+			slices[index].scores = NodeSlice<LengthType, ScoreType, Word, false> {};
+			slices[index].seedstartNodes = std::unordered_set<size_t> {};
+			slices[index].nodeMaxExactEndposScore = phmap::flat_hash_map<size_t, ScoreType> {};
+			scoresDropped[index] = true;
+			storedBytes -= sliceBytes[index];
+		}
+		// the two cached blocks of the backtrace, estimated from the average slice
+		size_t recalculatedBytes(size_t interval) const
+		{
+			return 2 * (interval - 1) * (allBytes / slices.size());
+		}
+		static size_t estimateBytes(const DPSlice& slice)
+		{
+			size_t result = sizeof(DPSlice);
+			result += slice.scores.size() * (sizeof(std::pair<size_t, typename NodeSlice<LengthType, ScoreType, Word, false>::MapItem>) + 2 * sizeof(uint32_t));
+			result += slice.nodeMaxExactEndposScore.size() * (sizeof(size_t) + sizeof(ScoreType) + 1);
+			result += slice.seedstartNodes.size() * (sizeof(size_t) + 2 * sizeof(void*));
+			return result;
+		}
+		size_t storedBytes;
+		size_t allBytes;
+		std::vector<size_t> sliceBytes;
+		mutable std::vector<DPSlice> cachedBlocks[2];
+		mutable size_t cachedBlockStart[2];
+		mutable size_t lastUsedCache;
 	};
 	class NodeCalculationResult
 	{
@@ -323,6 +414,23 @@ public:
 		return EqV;
 	}
 
+	static EqVector getEqVector(const AlignerGraphsizedState& reusableState, const std::string_view& sequence, size_t j)
+	{
+		return getEqVector(reusableState.eqVectors, sequence, j);
+	}
+
+	static EqVector getEqVector(const typename Common::EqVectorTable& eqVectors, const std::string_view& sequence, size_t j)
+	{
+		Word masks[4];
+		if (!eqVectors.get(sequence, j, masks)) return getEqVector(sequence, j);
+		EqVector EqV {masks[0], masks[3], masks[1], masks[2]};
+#ifdef EXTRACORRECTNESSASSERTIONS
+		EqVector debugEqV = getEqVector(sequence, j);
+		for (size_t i = 0; i < 4; i++) assert(EqV.getEqI(i) == debugEqV.getEqI(i));
+#endif
+		return EqV;
+	}
+
 	static WordSlice getSeedSlice(size_t j, size_t seqLen, const Params& params)
 	{
 		assert(j % WordConfiguration<Word>::WordSize == 0);
@@ -358,26 +466,23 @@ public:
 		return result;
 	}
 
+	// slice, node and its nodeMaxExactEndposScore, the score is carried along so comparisons don't need the slice's scores which might have been dropped
+	using PossibleStart = std::tuple<size_t, size_t, ScoreType>;
+
 	class StartComparer
 	{
 	public:
-		StartComparer(const DPTable& slice) :
-		slice(slice)
+		bool operator()(const PossibleStart& left, const PossibleStart& right) const
 		{
+			return std::get<2>(left) > std::get<2>(right);
 		}
-		bool operator()(const std::pair<size_t, size_t> left, const std::pair<size_t, size_t> right) const
-		{
-			return slice.slices[left.first].nodeMaxExactEndposScore.at(left.second) > slice.slices[right.first].nodeMaxExactEndposScore.at(right.second);
-		}
-	private:
-		const DPTable& slice;
 	};
 
 	static std::vector<OnewayTrace> getLocalMaximaTracesFromTable(const Params& params, const std::string_view& sequence, const DPTable& slice, AlignerGraphsizedState& reusableState, bool sliceConsistency, bool multiseed, std::vector<ScoreType>& sliceMaxScores)
 	{
 		std::vector<OnewayTrace> result;
 		assert(slice.slices.size() > 1);
-		assert(slice.slices[0].scores.size() == 0);
+		assert(slice.withScores(0).scores.size() == 0);
 		std::vector<ScoreType> localSliceMaxScores;
 		localSliceMaxScores.resize(slice.slices.size());
 		for (size_t i = 0; i < slice.slices.size(); i++)
@@ -385,45 +490,45 @@ public:
 			localSliceMaxScores[i] = slice.slices[i].maxExactEndposScore;
 		}
 		assert(localSliceMaxScores.size() <= sliceMaxScores.size());
-		std::vector<std::pair<size_t, size_t>> possibleStarts;
+		std::vector<PossibleStart> possibleStarts;
 		for (size_t currentSlice = slice.slices.size()-1; currentSlice > 0; currentSlice--)
 		{
-			assert(slice.slices[currentSlice].nodeMaxExactEndposScore.size() == slice.slices[currentSlice].scores.size());
+			assert(slice.withScores(currentSlice).nodeMaxExactEndposScore.size() == slice.withScores(currentSlice).scores.size());
 			if (slice.slices[currentSlice].maxExactEndposScore <= 0) continue;
-			std::priority_queue<std::pair<size_t, size_t>, std::vector<std::pair<size_t, size_t>>, StartComparer> possibleStartsQueue { StartComparer { slice } };
-			for (auto pair : slice.slices[currentSlice].scores)
+			std::priority_queue<PossibleStart, std::vector<PossibleStart>, StartComparer> possibleStartsQueue;
+			for (auto pair : slice.withScores(currentSlice).scores)
 			{
 				if (!pair.second.exists) continue;
 				auto node = pair.first;
-				assert(slice.slices[currentSlice].nodeMaxExactEndposScore.count(node) == 1);
-				ScoreType score = slice.slices[currentSlice].nodeMaxExactEndposScore.at(node);
+				assert(slice.withScores(currentSlice).nodeMaxExactEndposScore.count(node) == 1);
+				ScoreType score = slice.withScores(currentSlice).nodeMaxExactEndposScore.at(node);
 				if (score <= 0) continue;
 				if (score < localSliceMaxScores[currentSlice] * params.multimapScoreFraction) continue;
 				if (score < sliceMaxScores[currentSlice] * params.multimapScoreFraction) continue;
 				assert(currentSlice > 0);
-				if (slice.slices[currentSlice-1].nodeMaxExactEndposScore.count(node) == 1)
+				if (slice.withScores(currentSlice-1).nodeMaxExactEndposScore.count(node) == 1)
 				{
-					if (slice.slices[currentSlice-1].nodeMaxExactEndposScore.at(node) > score) continue;
+					if (slice.withScores(currentSlice-1).nodeMaxExactEndposScore.at(node) > score) continue;
 				}
-				if (currentSlice < slice.slices.size()-1 && slice.slices[currentSlice+1].nodeMaxExactEndposScore.count(node) == 1)
+				if (currentSlice < slice.slices.size()-1 && slice.withScores(currentSlice+1).nodeMaxExactEndposScore.count(node) == 1)
 				{
-					if (slice.slices[currentSlice+1].nodeMaxExactEndposScore.at(node) >= score) continue;
+					if (slice.withScores(currentSlice+1).nodeMaxExactEndposScore.at(node) >= score) continue;
 				}
 				bool notLocalMaximum = false;
 				for (auto neighbor : params.graph.InNeighbors(node))
 				{
-					if (slice.slices[currentSlice].nodeMaxExactEndposScore.count(neighbor) == 1)
+					if (slice.withScores(currentSlice).nodeMaxExactEndposScore.count(neighbor) == 1)
 					{
-						if (slice.slices[currentSlice].nodeMaxExactEndposScore.at(neighbor) > score)
+						if (slice.withScores(currentSlice).nodeMaxExactEndposScore.at(neighbor) > score)
 						{
 							notLocalMaximum = true;
 							break;
 						}
 					}
 					assert(currentSlice > 0);
-					if (slice.slices[currentSlice-1].nodeMaxExactEndposScore.count(neighbor) == 1)
+					if (slice.withScores(currentSlice-1).nodeMaxExactEndposScore.count(neighbor) == 1)
 					{
-						if (slice.slices[currentSlice-1].nodeMaxExactEndposScore.at(neighbor) > score)
+						if (slice.withScores(currentSlice-1).nodeMaxExactEndposScore.at(neighbor) > score)
 						{
 							notLocalMaximum = true;
 							break;
@@ -432,17 +537,17 @@ public:
 				}
 				for (auto neighbor : params.graph.OutNeighbors(node))
 				{
-					if (slice.slices[currentSlice].nodeMaxExactEndposScore.count(neighbor) == 1)
+					if (slice.withScores(currentSlice).nodeMaxExactEndposScore.count(neighbor) == 1)
 					{
-						if (slice.slices[currentSlice].nodeMaxExactEndposScore.at(neighbor) > score)
+						if (slice.withScores(currentSlice).nodeMaxExactEndposScore.at(neighbor) > score)
 						{
 							notLocalMaximum = true;
 							break;
 						}
 					}
-					if (currentSlice < slice.slices.size()-1 && slice.slices[currentSlice+1].nodeMaxExactEndposScore.count(neighbor) == 1)
+					if (currentSlice < slice.slices.size()-1 && slice.withScores(currentSlice+1).nodeMaxExactEndposScore.count(neighbor) == 1)
 					{
-						if (slice.slices[currentSlice+1].nodeMaxExactEndposScore.at(neighbor) > score)
+						if (slice.withScores(currentSlice+1).nodeMaxExactEndposScore.at(neighbor) > score)
 						{
 							notLocalMaximum = true;
 							break;
@@ -452,14 +557,14 @@ public:
 				if (notLocalMaximum) continue;
 				if (possibleStartsQueue.size() < params.maxTraceCount)
 				{
-					possibleStartsQueue.emplace(currentSlice, node);
+					possibleStartsQueue.emplace(currentSlice, node, score);
 				}
 				else
 				{
-					if (slice.slices[currentSlice].nodeMaxExactEndposScore.at(node) > slice.slices[possibleStartsQueue.top().first].nodeMaxExactEndposScore.at(possibleStartsQueue.top().second))
+					if (score > std::get<2>(possibleStartsQueue.top()))
 					{
 						possibleStartsQueue.pop();
-						possibleStartsQueue.emplace(currentSlice, node);
+						possibleStartsQueue.emplace(currentSlice, node, score);
 					}
 				}
 			}
@@ -470,20 +575,20 @@ public:
 				possibleStartsQueue.pop();
 			}
 		}
-		std::sort(possibleStarts.begin(), possibleStarts.end(), [&slice](const std::pair<size_t, size_t> left, const std::pair<size_t, size_t> right) { return slice.slices[left.first].nodeMaxExactEndposScore.at(left.second) > slice.slices[right.first].nodeMaxExactEndposScore.at(right.second); } );
+		std::sort(possibleStarts.begin(), possibleStarts.end(), StartComparer{});
 		std::vector<OnewayTrace> fakeTraces;
 		for (size_t starti = 0; starti < possibleStarts.size(); starti++)
 		{
-			assert(starti == 0 || slice.slices[possibleStarts[starti].first].nodeMaxExactEndposScore.at(possibleStarts[starti].second) <= slice.slices[possibleStarts[starti-1].first].nodeMaxExactEndposScore.at(possibleStarts[starti-1].second));
-			size_t currentSlice = possibleStarts[starti].first;
-			size_t node = possibleStarts[starti].second;
-			ScoreType score = slice.slices[currentSlice].nodeMaxExactEndposScore.at(node);
+			assert(starti == 0 || std::get<2>(possibleStarts[starti]) <= std::get<2>(possibleStarts[starti-1]));
+			size_t currentSlice = std::get<0>(possibleStarts[starti]);
+			size_t node = std::get<1>(possibleStarts[starti]);
+			ScoreType score = std::get<2>(possibleStarts[starti]);
 			if (score < localSliceMaxScores[currentSlice] * params.multimapScoreFraction) continue;
 			typename NodeSlice<LengthType, ScoreType, Word, false>::NodeSliceMapItem previous;
 			assert(currentSlice > 0);
-			if (slice.slices[currentSlice-1].scores.hasNode(node))
+			if (slice.withScores(currentSlice-1).scores.hasNode(node))
 			{
-				previous = slice.slices[currentSlice-1].scores.node(node);
+				previous = slice.withScores(currentSlice-1).scores.node(node);
 			}
 			else
 			{
@@ -493,11 +598,11 @@ public:
 					previous.HN[i] = WordConfiguration<Word>::AllZeros;
 				}
 			}
-			EqVector EqV = getEqVector(sequence, slice.slices[currentSlice].j);
+			EqVector EqV = getEqVector(reusableState, sequence, slice.slices[currentSlice].j);
 			WordSlice fakeSlice { WordConfiguration<Word>::AllZeros, WordConfiguration<Word>::AllZeros, std::numeric_limits<ScoreType>::max() };
 			WordSlice seedstartSlice = getSeedSlice(slice.slices[currentSlice].j, sequence.size(), params);
-			WordSlice extraSlice = slice.slices[currentSlice].seedstartNodes.count(node) == 1 ? seedstartSlice : fakeSlice;
-			const typename NodeSlice<LengthType, ScoreType, Word, false>::NodeSliceMapItem& nodeInfo = slice.slices[currentSlice].scores.node(node);
+			WordSlice extraSlice = slice.withScores(currentSlice).seedstartNodes.count(node) == 1 ? seedstartSlice : fakeSlice;
+			const typename NodeSlice<LengthType, ScoreType, Word, false>::NodeSliceMapItem& nodeInfo = slice.withScores(currentSlice).scores.node(node);
 			std::vector<WordSlice> nodeSlices = recalcNodeWordslice(params, node, nodeInfo, EqV, previous, sliceConsistency, extraSlice, slice.slices[currentSlice].j);
 			assert(nodeSlices[0].scoreEnd == nodeInfo.startSlice.scoreEnd);
 			assert(nodeSlices[0].VP == nodeInfo.startSlice.VP);
@@ -589,9 +694,9 @@ public:
 		auto node = slice.slices[bestIndex].maxExactEndposNode;
 		auto score = slice.slices[bestIndex].maxExactEndposScore;
 		typename NodeSlice<LengthType, ScoreType, Word, false>::NodeSliceMapItem previous;
-		if (slice.slices[bestIndex-1].scores.hasNode(node))
+		if (slice.withScores(bestIndex-1).scores.hasNode(node))
 		{
-			previous = slice.slices[bestIndex-1].scores.node(node);
+			previous = slice.withScores(bestIndex-1).scores.node(node);
 		}
 		else
 		{
@@ -602,12 +707,12 @@ public:
 			}
 		}
 
-		EqVector EqV = getEqVector(sequence, slice.slices[bestIndex].j);
+		EqVector EqV = getEqVector(reusableState, sequence, slice.slices[bestIndex].j);
 		WordSlice fakeSlice { WordConfiguration<Word>::AllZeros, WordConfiguration<Word>::AllZeros, std::numeric_limits<ScoreType>::max() };
 		WordSlice seedstartSlice { WordConfiguration<Word>::AllZeros, WordConfiguration<Word>::AllZeros, std::numeric_limits<ScoreType>::max() };
 		if (multiseed) seedstartSlice = getSeedSlice(slice.slices[bestIndex].j, sequence.size(), params);
-		WordSlice extraSlice = slice.slices[bestIndex].seedstartNodes.count(node) == 1 ? seedstartSlice : fakeSlice;
-		std::vector<WordSlice> nodeSlices = recalcNodeWordslice(params, node, slice.slices[bestIndex].scores.node(node), EqV, previous, sliceConsistency, extraSlice, slice.slices[bestIndex].j);
+		WordSlice extraSlice = slice.withScores(bestIndex).seedstartNodes.count(node) == 1 ? seedstartSlice : fakeSlice;
+		std::vector<WordSlice> nodeSlices = recalcNodeWordslice(params, node, slice.withScores(bestIndex).scores.node(node), EqV, previous, sliceConsistency, extraSlice, slice.slices[bestIndex].j);
 
 		size_t nodeOffset = std::numeric_limits<size_t>::max();
 		size_t bvOffset = std::numeric_limits<size_t>::max();
@@ -667,7 +772,7 @@ public:
 		result.trace.emplace_back(startPos, false, sequence, params.graph);
 		LengthType currentNode = std::numeric_limits<LengthType>::max();
 		std::vector<WordSlice> nodeSlices;
-		EqVector EqV = getEqVector(sequence, slice.slices[currentSlice].j);
+		EqVector EqV = getEqVector(reusableState, sequence, slice.slices[currentSlice].j);
 		WordSlice extraSlice;
 		ScoreType lastScore = std::numeric_limits<ScoreType>::max()-1;
 		std::vector<size_t> otherTracePoses;
@@ -711,15 +816,15 @@ public:
 			LengthType newNode = result.trace.back().DPposition.node;
 			if (newSlice != currentSlice || newNode != currentNode)
 			{
-				if (newSlice != currentSlice) EqV = getEqVector(sequence, slice.slices[newSlice].j);
+				if (newSlice != currentSlice) EqV = getEqVector(reusableState, sequence, slice.slices[newSlice].j);
 				currentSlice = newSlice;
 				currentNode = newNode;
-				assert(slice.slices[currentSlice].scores.hasNode(currentNode));
+				assert(slice.withScores(currentSlice).scores.hasNode(currentNode));
 				assert(currentSlice > 0);
 				typename NodeSlice<LengthType, ScoreType, Word, false>::NodeSliceMapItem previous;
-				if (slice.slices[currentSlice-1].scores.hasNode(currentNode))
+				if (slice.withScores(currentSlice-1).scores.hasNode(currentNode))
 				{
-					previous = slice.slices[currentSlice-1].scores.node(currentNode);
+					previous = slice.withScores(currentSlice-1).scores.node(currentNode);
 				}
 				else
 				{
@@ -732,10 +837,10 @@ public:
 				extraSlice.VP = WordConfiguration<Word>::AllZeros;
 				extraSlice.VN = WordConfiguration<Word>::AllZeros;
 				extraSlice.scoreEnd = std::numeric_limits<ScoreType>::max();
-				if (slice.slices[currentSlice].seedstartNodes.count(currentNode) == 1) extraSlice = getSeedSlice(slice.slices[currentSlice].j, sequence.size(), params);
-				nodeSlices = recalcNodeWordslice(params, currentNode, slice.slices[currentSlice].scores.node(currentNode), EqV, previous, sliceConsistency && !slice.slices[currentSlice].scoresNotValid && !slice.slices[currentSlice-1].scoresNotValid, extraSlice, slice.slices[currentSlice].j);
+				if (slice.withScores(currentSlice).seedstartNodes.count(currentNode) == 1) extraSlice = getSeedSlice(slice.slices[currentSlice].j, sequence.size(), params);
+				nodeSlices = recalcNodeWordslice(params, currentNode, slice.withScores(currentSlice).scores.node(currentNode), EqV, previous, sliceConsistency && !slice.slices[currentSlice].scoresNotValid && !slice.slices[currentSlice-1].scoresNotValid, extraSlice, slice.slices[currentSlice].j);
 #ifdef SLICEVERBOSE
-				std::cerr << "j " << slice.slices[currentSlice].j << " firstbt-calc " << slice.slices[currentSlice].scores.node(currentNode).firstSlicesCalcedWhenCalced << " lastbt-calc " << slice.slices[currentSlice].scores.node(currentNode).slicesCalcedWhenCalced << std::endl;
+				std::cerr << "j " << slice.slices[currentSlice].j << " firstbt-calc " << slice.withScores(currentSlice).scores.node(currentNode).firstSlicesCalcedWhenCalced << " lastbt-calc " << slice.withScores(currentSlice).scores.node(currentNode).slicesCalcedWhenCalced << std::endl;
 #endif
 			}
 			assert(result.trace.back().DPposition.node == currentNode);
@@ -753,7 +858,7 @@ public:
 			}
 			if (result.trace.back().DPposition.seqPos % WordConfiguration<Word>::WordSize == 0 && result.trace.back().DPposition.nodeOffset == 0)
 			{
-				auto bt = pickBacktraceCorner(params, slice.slices[currentSlice].scores, slice.slices[currentSlice-1].scores, currentNode, slice.slices[currentSlice].j, sequence, slice.slices[currentSlice].minScore + slice.slices[currentSlice].bandwidth, slice.slices[currentSlice].scoresNotValid, slice.slices[currentSlice-1].minScore + slice.slices[currentSlice-1].bandwidth, slice.slices[currentSlice-1].scoresNotValid, extraSlice);
+				auto bt = pickBacktraceCorner(params, slice.withScores(currentSlice).scores, slice.withScores(currentSlice-1).scores, currentNode, slice.slices[currentSlice].j, sequence, slice.slices[currentSlice].minScore + slice.slices[currentSlice].bandwidth, slice.slices[currentSlice].scoresNotValid, slice.slices[currentSlice-1].minScore + slice.slices[currentSlice-1].bandwidth, slice.slices[currentSlice-1].scoresNotValid, extraSlice);
 				if (result.trace.size() > 0 && bt.first == result.trace.back().DPposition && !bt.second && nodeSlices[bt.first.nodeOffset].getValue(bt.first.seqPos % WordConfiguration<Word>::WordSize) == extraSlice.getValue(bt.first.seqPos % WordConfiguration<Word>::WordSize))
 				{
 					break;
@@ -770,7 +875,7 @@ public:
 			{
 				assert(currentSlice > 0);
 				assert(result.trace.back().DPposition.nodeOffset > 0);
-				if (!slice.slices[currentSlice-1].scores.hasNode(currentNode))
+				if (!slice.withScores(currentSlice-1).scores.hasNode(currentNode))
 				{
 					for (size_t i = result.trace.back().DPposition.nodeOffset-1; i > 0; i--)
 					{
@@ -779,7 +884,7 @@ public:
 					result.trace.emplace_back(MatrixPosition {currentNode, 0, result.trace.back().DPposition.seqPos}, false, sequence, params.graph);
 					continue;
 				}
-				auto crossing = pickBacktraceVerticalCrossing(params, slice.slices[currentSlice].scores, slice.slices[currentSlice-1].scores, nodeSlices, slice.slices[currentSlice].j, currentNode, result.trace.back().DPposition, sequence, slice.slices[currentSlice].minScore + slice.slices[currentSlice].bandwidth, slice.slices[currentSlice].scoresNotValid, slice.slices[currentSlice-1].minScore + slice.slices[currentSlice-1].bandwidth, slice.slices[currentSlice-1].scoresNotValid, extraSlice);
+				auto crossing = pickBacktraceVerticalCrossing(params, slice.withScores(currentSlice).scores, slice.withScores(currentSlice-1).scores, nodeSlices, slice.slices[currentSlice].j, currentNode, result.trace.back().DPposition, sequence, slice.slices[currentSlice].minScore + slice.slices[currentSlice].bandwidth, slice.slices[currentSlice].scoresNotValid, slice.slices[currentSlice-1].minScore + slice.slices[currentSlice-1].bandwidth, slice.slices[currentSlice-1].scoresNotValid, extraSlice);
 				if (result.trace.size() > 0 && crossing.second.first.seqPos == result.trace.back().DPposition.seqPos && crossing.second.first.node == result.trace.back().DPposition.node && nodeSlices[crossing.second.first.nodeOffset].getValue(crossing.second.first.seqPos % WordConfiguration<Word>::WordSize) == extraSlice.getValue(crossing.second.first.seqPos % WordConfiguration<Word>::WordSize))
 				{
 					break;
@@ -804,7 +909,7 @@ public:
 			if (result.trace.back().DPposition.nodeOffset == 0)
 			{
 				assert(result.trace.back().DPposition.seqPos % WordConfiguration<Word>::WordSize != 0);
-				auto crossing = pickBacktraceHorizontalCrossing(params, slice.slices[currentSlice].scores, slice.slices[currentSlice-1].scores, slice.slices[currentSlice].j, currentNode, result.trace.back().DPposition, sequence, slice.slices[currentSlice].minScore + slice.slices[currentSlice].bandwidth, slice.slices[currentSlice].scoresNotValid, slice.slices[currentSlice-1].minScore + slice.slices[currentSlice-1].bandwidth, slice.slices[currentSlice-1].scoresNotValid, extraSlice);
+				auto crossing = pickBacktraceHorizontalCrossing(params, slice.withScores(currentSlice).scores, slice.withScores(currentSlice-1).scores, slice.slices[currentSlice].j, currentNode, result.trace.back().DPposition, sequence, slice.slices[currentSlice].minScore + slice.slices[currentSlice].bandwidth, slice.slices[currentSlice].scoresNotValid, slice.slices[currentSlice-1].minScore + slice.slices[currentSlice-1].bandwidth, slice.slices[currentSlice-1].scoresNotValid, extraSlice);
 				if (result.trace.size() > 0 && crossing.second.first.node == result.trace.back().DPposition.node && !crossing.second.second && nodeSlices[crossing.second.first.nodeOffset].getValue(crossing.second.first.seqPos % WordConfiguration<Word>::WordSize) == extraSlice.getValue(crossing.second.first.seqPos % WordConfiguration<Word>::WordSize))
 				{
 					break;
@@ -850,8 +955,8 @@ public:
 		{
 			if (multiseed) break;
 			assert(result.trace.back().DPposition.seqPos == (size_t)-1);
-			assert(slice.slices[0].scores.hasNode(result.trace.back().DPposition.node));
-			auto node = slice.slices[0].scores.node(result.trace.back().DPposition.node);
+			assert(slice.withScores(0).scores.hasNode(result.trace.back().DPposition.node));
+			auto node = slice.withScores(0).scores.node(result.trace.back().DPposition.node);
 			std::vector<ScoreType> beforeSliceScores;
 			beforeSliceScores.resize(params.graph.NodeLength(result.trace.back().DPposition.node));
 			beforeSliceScores[0] = node.startSlice.scoreEnd;
@@ -872,7 +977,7 @@ public:
 				bool found = false;
 				for (auto neighbor : params.graph.InNeighbors(result.trace.back().DPposition.node))
 				{
-					if (slice.slices[0].scores.hasNode(neighbor) && slice.slices[0].scores.node(neighbor).endSlice.getScoreBeforeStart() == beforeSliceScores[result.trace.back().DPposition.nodeOffset] - 1)
+					if (slice.withScores(0).scores.hasNode(neighbor) && slice.withScores(0).scores.node(neighbor).endSlice.getScoreBeforeStart() == beforeSliceScores[result.trace.back().DPposition.nodeOffset] - 1)
 					{
 						result.trace.emplace_back(MatrixPosition {neighbor, params.graph.NodeLength(neighbor)-1, result.trace.back().DPposition.seqPos}, true, sequence, params.graph);
 						found = true;
@@ -1233,7 +1338,7 @@ public:
 #ifdef NDEBUG
 	__attribute__((always_inline))
 #endif
-	static NodeCalculationResult calculateNodeClipPrecise(const Params& params, size_t i, typename NodeSlice<LengthType, ScoreType, Word, true>::NodeSliceMapItem& slice, const EqVector& EqV, typename NodeSlice<LengthType, ScoreType, Word, true>::NodeSliceMapItem previousSlice, const std::vector<EdgeWithPriority>& incoming, const std::vector<bool>& previousBand, NodeChunkType nodeChunks, const WordSlice extraSlice, ScoreType seqOffset)
+	static NodeCalculationResult calculateNodeClipPrecise(const Params& params, size_t i, typename NodeSlice<LengthType, ScoreType, Word, true>::NodeSliceMapItem& slice, const EqVector& EqV, typename NodeSlice<LengthType, ScoreType, Word, true>::NodeSliceMapItem previousSlice, const std::vector<EdgeWithPriority>& incoming, const SliceBand& previousBand, NodeChunkType nodeChunks, const WordSlice extraSlice, ScoreType seqOffset)
 	{
 		return calculateNodeInner<true>(params, i, slice, EqV, previousSlice, incoming, [&previousBand](size_t pos) { return previousBand[pos]; }, nodeChunks, extraSlice, [](const WordSlice& slice){}, seqOffset);
 	}
@@ -1542,11 +1647,11 @@ public:
 		if (!previousSlice.exists) forceEq ^= 1;
 		size_t smallChunk = 0;
 		size_t offset = 1;
-		pos = smallChunk * (WordConfiguration<Word>::WordSize / 2) + offset;
+		pos = smallChunk * AlignmentGraph::BP_IN_CHUNK + offset;
 		for (; smallChunk < params.graph.CHUNKS_IN_NODE; smallChunk++)
 		{
-			size_t bigChunk = smallChunk / 2;
-			size_t bigChunkOffset = (smallChunk % 2) * (WordConfiguration<Word>::WordSize / 2);
+			size_t bigChunk = smallChunk * AlignmentGraph::BP_IN_CHUNK / WordConfiguration<Word>::WordSize;
+			size_t bigChunkOffset = (smallChunk * AlignmentGraph::BP_IN_CHUNK) % WordConfiguration<Word>::WordSize;
 			Word HP = fixedHP[bigChunk] >> bigChunkOffset;
 			Word HN = fixedHN[bigChunk] >> bigChunkOffset;
 			auto charChunk = nodeChunks[smallChunk];
@@ -1554,7 +1659,7 @@ public:
 			HN >>= offset;
 			charChunk >>= offset * 2;
 			forceMask >>= offset;
-			for (; offset < WordConfiguration<Word>::WordSize / 2 && pos < nodeLength; offset++)
+			for (; offset < AlignmentGraph::BP_IN_CHUNK && pos < nodeLength; offset++)
 			{
 				Eq = EqV.getEqI(charChunk & 3);
 				Eq &= forceEq;
@@ -2,12 +2,102 @@
 #define GraphAlignerCommon_h
 
 #include <vector>
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "AlignmentGraph.h"
 #include "ArrayPriorityQueue.h"
 #include "ComponentPriorityQueue.h"
+#include "ResettableBitvector.h"
+#include "SliceBand.h"
 #include "NodeSlice.h"
 #include "WordSlice.h"
 
+//the traces don't depend on the DP word width, so aligners with different words produce the same trace types
+template <typename ScoreType>
+class GraphAlignerTrace
+{
+public:
+	struct TraceItem
+	{
+		TraceItem() :
+		DPposition(),
+		nodeSwitch(false),
+		sequenceCharacter('-'),
+		graphCharacter('-')
+		{}
+		TraceItem(AlignmentGraph::MatrixPosition DPposition, bool nodeSwitch, char sequenceCharacter, char graphCharacter) :
+		DPposition(DPposition),
+		nodeSwitch(nodeSwitch),
+		sequenceCharacter(sequenceCharacter),
+		graphCharacter(graphCharacter)
+		{}
+		TraceItem(AlignmentGraph::MatrixPosition DPposition, bool nodeSwitch, const std::string& seq, const AlignmentGraph& graph) :
+		DPposition(DPposition),
+		nodeSwitch(nodeSwitch),
+		sequenceCharacter(DPposition.seqPos < seq.size() ? seq[DPposition.seqPos] : '-'),
+		graphCharacter(graph.NodeSequences(DPposition.node, DPposition.nodeOffset))
+		{}
+		TraceItem(AlignmentGraph::MatrixPosition DPposition, bool nodeSwitch, const std::string_view& seq, const AlignmentGraph& graph) :
+		DPposition(DPposition),
+		nodeSwitch(nodeSwitch),
+		sequenceCharacter(DPposition.seqPos < seq.size() ? seq[DPposition.seqPos] : '-'),
+		graphCharacter(graph.NodeSequences(DPposition.node, DPposition.nodeOffset))
+		{}
+		bool operator==(const TraceItem& other) const
+		{
+			return DPposition == other.DPposition && nodeSwitch == other.nodeSwitch && sequenceCharacter == other.sequenceCharacter && graphCharacter == other.graphCharacter;
+		}
+		AlignmentGraph::MatrixPosition DPposition;
+		bool nodeSwitch;
+		char sequenceCharacter;
+		char graphCharacter;
+	};
+	class OnewayTrace
+	{
+	public:
+		OnewayTrace() :
+		trace(),
+		score(0)
+		{
+		}
+		// force move semantics because copying is very slow and unnecessary
+		OnewayTrace(const OnewayTrace& other) = delete;
+		OnewayTrace(OnewayTrace&& other) = default;
+		OnewayTrace& operator=(const OnewayTrace& other) = delete;
+		OnewayTrace& operator=(OnewayTrace&& other) = default;
+		static OnewayTrace TraceFailed()
+		{
+			OnewayTrace result;
+			result.score = std::numeric_limits<ScoreType>::max();
+			return result;
+		}
+		bool failed() const
+		{
+			return score == std::numeric_limits<ScoreType>::max();
+		}
+		ScoreType alignmentXScore(ScoreType XscoreErrorCost) const
+		{
+			if (failed()) return 0;
+			assert(trace.size() > 0);
+			assert(trace[0].DPposition.seqPos >= trace.back().DPposition.seqPos);
+			return (ScoreType)(trace[0].DPposition.seqPos - trace.back().DPposition.seqPos + 1)*100 - XscoreErrorCost * (ScoreType)score;
+		}
+		std::vector<TraceItem> trace;
+		ScoreType score;
+	};
+	class Trace
+	{
+	public:
+		OnewayTrace forward;
+		OnewayTrace backward;
+	};
+};
+
 template <typename LengthType, typename ScoreType, typename Word>
 class GraphAlignerCommon
 {
@@ -49,6 +139,167 @@ public:
 		size_t slice;
 		bool forceCalculation;
 	};
+	// A/C/G/T match bitvectors of a whole read and its reverse complement, built once per read
+	// getEqVector picks the words for any view into those strings from here instead of going through the characters again
+	class EqVectorTable
+	{
+	public:
+		EqVectorTable() :
+		strands()
+		{
+		}
+		void build(const std::string& forward, const std::string& backward)
+		{
+			strands[0].build(forward);
+			strands[1].build(backward);
+		}
+		void clear()
+		{
+			strands[0].clear();
+			strands[1].clear();
+		}
+		// false if the view isn't inside the sequences of the current read, then the caller has to calculate the masks itself
+		bool get(const std::string_view& view, size_t j, Word (&masks)[4]) const
+		{
+			for (size_t i = 0; i < 2; i++)
+			{
+				if (!strands[i].contains(view)) continue;
+				strands[i].get(view, j, masks);
+				return true;
+			}
+			return false;
+		}
+	private:
+		class Strand
+		{
+		public:
+			Strand() :
+			start(nullptr),
+			size(0),
+			blocks()
+			{
+			}
+			void build(const std::string& sequence)
+			{
+				start = sequence.data();
+				size = sequence.size();
+				// one extra block of zeros so a shifted read of the last block can always look at the next one
+				blocks.assign((size / 64 + 2) * 4, 0);
+				for (size_t i = 0; i < size; i += 64)
+				{
+					buildBlock(sequence.data() + i, std::min((size_t)64, size - i), blocks.data() + (i / 64) * 4);
+				}
+			}
+			void clear()
+			{
+				start = nullptr;
+				size = 0;
+				blocks.clear();
+			}
+			bool contains(const std::string_view& view) const
+			{
+				if (start == nullptr) return false;
+				return view.data() >= start && view.data() + view.size() <= start + size;
+			}
+			void get(const std::string_view& view, size_t j, Word (&masks)[4]) const
+			{
+				for (size_t c = 0; c < 4; c++) masks[c] = WordConfiguration<Word>::AllZeros;
+				if (j >= view.size()) return;
+				size_t pos = (view.data() - start) + j;
+				for (size_t piece = 0; piece < WordConfiguration<Word>::WordSize / 64; piece++)
+				{
+					for (size_t c = 0; c < 4; c++)
+					{
+						masks[c] |= ((Word)getBits(pos + piece * 64, c)) << (piece * 64);
+					}
+				}
+				if (view.size() - j < WordConfiguration<Word>::WordSize)
+				{
+					Word valid = (((Word)1) << (view.size() - j)) - 1;
+					for (size_t c = 0; c < 4; c++) masks[c] &= valid;
+				}
+			}
+		private:
+			uint64_t getBits(size_t pos, size_t c) const
+			{
+				if (pos >= size) return 0;
+				size_t block = pos / 64;
+				size_t shift = pos % 64;
+				uint64_t result = blocks[block * 4 + c] >> shift;
+				if (shift > 0) result |= blocks[(block + 1) * 4 + c] << (64 - shift);
+				return result;
+			}
+			// masks in the order A C G T
+			static void buildBlock(const char* chars, size_t length, uint64_t* masks)
+			{
+				assert(length <= 64);
+				uint64_t known = 0;
+#ifdef __SSE2__
+				alignas(16) char padded[64] = {};
+				memcpy(padded, chars, length);
+				for (size_t i = 0; i < 64; i += 16)
+				{
+					__m128i x = _mm_load_si128((const __m128i*)(padded + i));
+					uint64_t a = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('A')), _mm_cmpeq_epi8(x, _mm_set1_epi8('a'))));
+					uint64_t c = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('C')), _mm_cmpeq_epi8(x, _mm_set1_epi8('c'))));
+					uint64_t g = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('G')), _mm_cmpeq_epi8(x, _mm_set1_epi8('g'))));
+					uint64_t t = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('T')), _mm_cmpeq_epi8(x, _mm_set1_epi8('t'))));
+					uint64_t gap = _mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8('-')));
+					masks[0] |= a << i;
+					masks[1] |= c << i;
+					masks[2] |= g << i;
+					masks[3] |= t << i;
+					known |= (a | c | g | t | gap) << i;
+				}
+#else
+				for (size_t i = 0; i < length; i++)
+				{
+					uint64_t bit = ((uint64_t)1) << i;
+					switch(chars[i])
+					{
+						case 'a':
+						case 'A':
+							masks[0] |= bit;
+							known |= bit;
+							break;
+						case 'c':
+						case 'C':
+							masks[1] |= bit;
+							known |= bit;
+							break;
+						case 'g':
+						case 'G':
+							masks[2] |= bit;
+							known |= bit;
+							break;
+						case 't':
+						case 'T':
+							masks[3] |= bit;
+							known |= bit;
+							break;
+						case '-':
+							known |= bit;
+							break;
+					}
+				}
+#endif
+				// ambiguous characters are rare, match them one at a time
+				for (size_t i = 0; i < length; i++)
+				{
+					if (known & (((uint64_t)1) << i)) continue;
+					uint64_t bit = ((uint64_t)1) << i;
+					if (characterMatch(chars[i], 'A')) masks[0] |= bit;
+					if (characterMatch(chars[i], 'C')) masks[1] |= bit;
+					if (characterMatch(chars[i], 'G')) masks[2] |= bit;
+					if (characterMatch(chars[i], 'T')) masks[3] |= bit;
+				}
+			}
+			const char* start;
+			size_t size;
+			std::vector<uint64_t> blocks;
+		};
+		Strand strands[2];
+	};
 	class AlignerGraphsizedState
 	{
 	public:
@@ -59,12 +310,14 @@ public:
 		previousBand(),
 		hasSeedStart(),
 		allowedBigraphNodesThisSlice(),
-		bigraphNodeForbiddenSpans()
+		bigraphNodeForbiddenSpans(),
+		eqVectors(),
+		nodeSliceMaps()
 		{
 			componentQueue.initialize(graph.ComponentSize());
 			calculableQueue.initialize(WordConfiguration<Word>::WordSize * (WordConfiguration<Word>::WordSize + maxBandwidth + 1) + maxBandwidth + 1, graph.NodeSize());
-			currentBand.resize(graph.NodeSize(), false);
-			previousBand.resize(graph.NodeSize(), false);
+			currentBand.resize(graph.NodeSize());
+			previousBand.resize(graph.NodeSize());
 			hasSeedStart.resize(graph.NodeSize(), false);
 			allowedBigraphNodesThisSlice.resize(graph.BigraphNodeCount(), true);
 		}
@@ -72,25 +325,28 @@ public:
 		{
 			componentQueue.clear();
 			calculableQueue.clear();
-			currentBand.assign(currentBand.size(), false);
-			previousBand.assign(previousBand.size(), false);
-			hasSeedStart.assign(hasSeedStart.size(), false);
-			allowedBigraphNodesThisSlice.assign(allowedBigraphNodesThisSlice.size(), true);
+			currentBand.clear();
+			previousBand.clear();
+			hasSeedStart.reset();
+			allowedBigraphNodesThisSlice.reset();
 			bigraphNodeForbiddenSpans.clear();
+			eqVectors.clear();
 		}
 		ComponentPriorityQueue<EdgeWithPriority, true> componentQueue;
 		ArrayPriorityQueue<EdgeWithPriority, true> calculableQueue;
-		std::vector<bool> currentBand;
-		std::vector<bool> previousBand;
-		std::vector<bool> hasSeedStart;
-		std::vector<bool> allowedBigraphNodesThisSlice;
+		SliceBand currentBand;
+		SliceBand previousBand;
+		ResettableBitvector hasSeedStart;
+		ResettableBitvector allowedBigraphNodesThisSlice;
 		std::vector<std::tuple<size_t, int, int>> bigraphNodeForbiddenSpans;
+		EqVectorTable eqVectors;
+		typename NodeSlice<LengthType, ScoreType, Word, false>::MapPool nodeSliceMaps;
 	};
 	using MatrixPosition = AlignmentGraph::MatrixPosition;
 	class Params
 	{
 	public:
-		Params(LengthType alignmentBandwidth, const AlignmentGraph& graph, size_t maxCellsPerSlice, bool quietMode, double preciseClippingIdentityCutoff, ScoreType Xdropcutoff, double multimapScoreFraction, ScoreType clipAmbiguousEnds, size_t maxTraceCount) :
+		Params(LengthType alignmentBandwidth, const AlignmentGraph& graph, size_t maxCellsPerSlice, bool quietMode, double preciseClippingIdentityCutoff, ScoreType Xdropcutoff, double multimapScoreFraction, ScoreType clipAmbiguousEnds, size_t maxTraceCount, size_t maxDPTableBytes) :
 		alignmentBandwidth(alignmentBandwidth),
 		graph(graph),
 		maxCellsPerSlice(maxCellsPerSlice),
@@ -100,7 +356,8 @@ public:
 		multimapScoreFraction(multimapScoreFraction),
 		clipAmbiguousEnds(clipAmbiguousEnds),
 		discardCigar(false),
-		maxTraceCount(maxTraceCount)
+		maxTraceCount(maxTraceCount),
+		maxDPTableBytes(maxDPTableBytes)
 		{
 		}
 		const LengthType alignmentBandwidth;
@@ -112,82 +369,13 @@ public:
 		const double multimapScoreFraction;
 		const ScoreType clipAmbiguousEnds;
 		const size_t maxTraceCount;
+		// 0 for no limit
+		const size_t maxDPTableBytes;
 		bool discardCigar;
 	};
-	struct TraceItem
-	{
-		TraceItem() :
-		DPposition(),
-		nodeSwitch(false),
-		sequenceCharacter('-'),
-		graphCharacter('-')
-		{}
-		TraceItem(MatrixPosition DPposition, bool nodeSwitch, char sequenceCharacter, char graphCharacter) :
-		DPposition(DPposition),
-		nodeSwitch(nodeSwitch),
-		sequenceCharacter(sequenceCharacter),
-		graphCharacter(graphCharacter)
-		{}
-		TraceItem(MatrixPosition DPposition, bool nodeSwitch, const std::string& seq, const AlignmentGraph& graph) :
-		DPposition(DPposition),
-		nodeSwitch(nodeSwitch),
-		sequenceCharacter(DPposition.seqPos < seq.size() ? seq[DPposition.seqPos] : '-'),
-		graphCharacter(graph.NodeSequences(DPposition.node, DPposition.nodeOffset))
-		{}
-		TraceItem(MatrixPosition DPposition, bool nodeSwitch, const std::string_view& seq, const AlignmentGraph& graph) :
-		DPposition(DPposition),
-		nodeSwitch(nodeSwitch),
-		sequenceCharacter(DPposition.seqPos < seq.size() ? seq[DPposition.seqPos] : '-'),
-		graphCharacter(graph.NodeSequences(DPposition.node, DPposition.nodeOffset))
-		{}
-		bool operator==(const TraceItem& other) const
-		{
-			return DPposition == other.DPposition && nodeSwitch == other.nodeSwitch && sequenceCharacter == other.sequenceCharacter && graphCharacter == other.graphCharacter;
-		}
-		MatrixPosition DPposition;
-		bool nodeSwitch;
-		char sequenceCharacter;
-		char graphCharacter;
-	};
-	class OnewayTrace
-	{
-	public:
-		OnewayTrace() :
-		trace(),
-		score(0)
-		{
-		}
-		// force move semantics because copying is very slow and unnecessary
-		OnewayTrace(const OnewayTrace& other) = delete;
-		OnewayTrace(OnewayTrace&& other) = default;
-		OnewayTrace& operator=(const OnewayTrace& other) = delete;
-		OnewayTrace& operator=(OnewayTrace&& other) = default;
-		static OnewayTrace TraceFailed()
-		{
-			OnewayTrace result;
-			result.score = std::numeric_limits<ScoreType>::max();
-			return result;
-		}
-		bool failed() const
-		{
-			return score == std::numeric_limits<ScoreType>::max();
-		}
-		ScoreType alignmentXScore(ScoreType XscoreErrorCost) const
-		{
-			if (failed()) return 0;
-			assert(trace.size() > 0);
-			assert(trace[0].DPposition.seqPos >= trace.back().DPposition.seqPos);
-			return (ScoreType)(trace[0].DPposition.seqPos - trace.back().DPposition.seqPos + 1)*100 - XscoreErrorCost * (ScoreType)score;
-		}
-		std::vector<TraceItem> trace;
-		ScoreType score;
-	};
-	class Trace
-	{
-	public:
-		OnewayTrace forward;
-		OnewayTrace backward;
-	};
+	using TraceItem = typename GraphAlignerTrace<ScoreType>::TraceItem;
+	using OnewayTrace = typename GraphAlignerTrace<ScoreType>::OnewayTrace;
+	using Trace = typename GraphAlignerTrace<ScoreType>::Trace;
 #ifdef NDEBUG
 	__attribute__((always_inline))
 #endif
@@ -5,49 +5,120 @@
 #include "GraphAligner.h"
 #include "ThreadReadAssertion.h"
 
+template <typename Word>
+using GraphsizedState = typename GraphAlignerCommon<size_t, int64_t, Word>::AlignerGraphsizedState;
+
 size_t SeedCluster::size() const
 {
 	return hits.size();
 }
 
-AlignmentResult AlignOneWay(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t alignmentBandwidth, bool quietMode, ReusableStateType& reusableState, double preciseClippingIdentityCutoff, int Xdropcutoff, size_t DPRestartStride, int clipAmbiguousEnds)
+template <typename Word>
+AlignmentResult alignOneWay(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t alignmentBandwidth, bool quietMode, GraphsizedState<Word>& reusableState, double preciseClippingIdentityCutoff, int Xdropcutoff, size_t DPRestartStride, int clipAmbiguousEnds, size_t maxDPTableBytes)
 {
-	GraphAlignerCommon<size_t, int64_t, uint64_t>::Params params {alignmentBandwidth, graph, std::numeric_limits<size_t>::max(), quietMode, preciseClippingIdentityCutoff, Xdropcutoff, 0, clipAmbiguousEnds, std::numeric_limits<size_t>::max()};
-	GraphAligner<size_t, int64_t, uint64_t> aligner {params};
+	typename GraphAlignerCommon<size_t, int64_t, Word>::Params params {alignmentBandwidth, graph, std::numeric_limits<size_t>::max(), quietMode, preciseClippingIdentityCutoff, Xdropcutoff, 0, clipAmbiguousEnds, std::numeric_limits<size_t>::max(), maxDPTableBytes};
+	GraphAligner<size_t, int64_t, Word> aligner {params};
 	return aligner.AlignOneWay(seq_id, sequence, reusableState, DPRestartStride);
 }
 
-AlignmentResult AlignClusters(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t alignmentBandwidth, size_t maxCellsPerSlice, bool quietMode, const std::vector<SeedCluster>& seedHits, ReusableStateType& reusableState, double preciseClippingIdentityCutoff, int Xdropcutoff, double multimapScoreFraction, int clipAmbiguousEnds, size_t maxTraceCount)
+template <typename Word>
+AlignmentResult alignClusters(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t alignmentBandwidth, size_t maxCellsPerSlice, bool quietMode, const std::vector<SeedCluster>& seedHits, GraphsizedState<Word>& reusableState, double preciseClippingIdentityCutoff, int Xdropcutoff, double multimapScoreFraction, int clipAmbiguousEnds, size_t maxTraceCount, size_t maxDPTableBytes)
 {
-	GraphAlignerCommon<size_t, int64_t, uint64_t>::Params params {alignmentBandwidth, graph, maxCellsPerSlice, quietMode, preciseClippingIdentityCutoff, Xdropcutoff, multimapScoreFraction, clipAmbiguousEnds, maxTraceCount};
-	GraphAligner<size_t, int64_t, uint64_t> aligner {params};
+	typename GraphAlignerCommon<size_t, int64_t, Word>::Params params {alignmentBandwidth, graph, maxCellsPerSlice, quietMode, preciseClippingIdentityCutoff, Xdropcutoff, multimapScoreFraction, clipAmbiguousEnds, maxTraceCount, maxDPTableBytes};
+	GraphAligner<size_t, int64_t, Word> aligner {params};
 	return aligner.AlignClusters(seq_id, sequence, seedHits, reusableState);
 }
 
+template <typename Word>
+AlignmentResult alignClustersParallel(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t alignmentBandwidth, size_t maxCellsPerSlice, bool quietMode, const std::vector<SeedCluster>& seedHits, GraphsizedState<Word>& reusableState, WorkStealingPool<GraphsizedState<Word>>& pool, size_t worker, double preciseClippingIdentityCutoff, int Xdropcutoff, double multimapScoreFraction, int clipAmbiguousEnds, size_t maxTraceCount, size_t maxDPTableBytes)
+{
+	typename GraphAlignerCommon<size_t, int64_t, Word>::Params params {alignmentBandwidth, graph, maxCellsPerSlice, quietMode, preciseClippingIdentityCutoff, Xdropcutoff, multimapScoreFraction, clipAmbiguousEnds, maxTraceCount, maxDPTableBytes};
+	GraphAligner<size_t, int64_t, Word> aligner {params};
+	std::string revSequence = CommonUtils::ReverseComplement(sequence);
+	// tasks may run on other workers' states, which don't have this read's forbidden nodes
+	std::vector<std::tuple<size_t, int, int>> forbiddenSpans = reusableState.bigraphNodeForbiddenSpans;
+	std::vector<std::vector<AlignmentResult::AlignmentItem>> clusterAlignments;
+	clusterAlignments.resize(seedHits.size());
+	typename WorkStealingPool<GraphsizedState<Word>>::TaskGroup group;
+	for (size_t i = 0; i < seedHits.size(); i++)
+	{
+		pool.submit(worker, group, [&aligner, &seq_id, &sequence, &revSequence, &seedHits, &forbiddenSpans, &clusterAlignments, i](GraphsizedState<Word>& state)
+		{
+			std::vector<std::tuple<size_t, int, int>> stateSpans = forbiddenSpans;
+			std::swap(state.bigraphNodeForbiddenSpans, stateSpans);
+			clusterAlignments[i] = aligner.AlignCluster(seq_id, sequence, revSequence, seedHits[i], state);
+			std::swap(state.bigraphNodeForbiddenSpans, stateSpans);
+		});
+	}
+	pool.wait(worker, reusableState, group);
+	assertSetNoRead(seq_id);
+	AlignmentResult result;
+	result.readName = seq_id;
+	for (size_t i = 0; i < clusterAlignments.size(); i++)
+	{
+		result.seedsExtended += 1;
+		for (auto& item : clusterAlignments[i])
+		{
+			result.alignments.emplace_back(std::move(item));
+		}
+	}
+	return result;
+}
+
+AlignmentResult AlignOneWay(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t alignmentBandwidth, bool quietMode, ReusableStateType& reusableState, double preciseClippingIdentityCutoff, int Xdropcutoff, size_t DPRestartStride, int clipAmbiguousEnds, size_t maxDPTableBytes)
+{
+	return alignOneWay<uint64_t>(graph, seq_id, sequence, alignmentBandwidth, quietMode, reusableState, preciseClippingIdentityCutoff, Xdropcutoff, DPRestartStride, clipAmbiguousEnds, maxDPTableBytes);
+}
+
+AlignmentResult AlignClusters(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t alignmentBandwidth, size_t maxCellsPerSlice, bool quietMode, const std::vector<SeedCluster>& seedHits, ReusableStateType& reusableState, double preciseClippingIdentityCutoff, int Xdropcutoff, double multimapScoreFraction, int clipAmbiguousEnds, size_t maxTraceCount, size_t maxDPTableBytes)
+{
+	return alignClusters<uint64_t>(graph, seq_id, sequence, alignmentBandwidth, maxCellsPerSlice, quietMode, seedHits, reusableState, preciseClippingIdentityCutoff, Xdropcutoff, multimapScoreFraction, clipAmbiguousEnds, maxTraceCount, maxDPTableBytes);
+}
+
+AlignmentResult AlignClustersParallel(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t alignmentBandwidth, size_t maxCellsPerSlice, bool quietMode, const std::vector<SeedCluster>& seedHits, ReusableStateType& reusableState, ClusterTaskPool& pool, size_t worker, double preciseClippingIdentityCutoff, int Xdropcutoff, double multimapScoreFraction, int clipAmbiguousEnds, size_t maxTraceCount, size_t maxDPTableBytes)
+{
+	return alignClustersParallel<uint64_t>(graph, seq_id, sequence, alignmentBandwidth, maxCellsPerSlice, quietMode, seedHits, reusableState, pool, worker, preciseClippingIdentityCutoff, Xdropcutoff, multimapScoreFraction, clipAmbiguousEnds, maxTraceCount, maxDPTableBytes);
+}
+
+AlignmentResult AlignOneWay(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t alignmentBandwidth, bool quietMode, WideReusableStateType& reusableState, double preciseClippingIdentityCutoff, int Xdropcutoff, size_t DPRestartStride, int clipAmbiguousEnds, size_t maxDPTableBytes)
+{
+	return alignOneWay<__uint128_t>(graph, seq_id, sequence, alignmentBandwidth, quietMode, reusableState, preciseClippingIdentityCutoff, Xdropcutoff, DPRestartStride, clipAmbiguousEnds, maxDPTableBytes);
+}
+
+AlignmentResult AlignClusters(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t alignmentBandwidth, size_t maxCellsPerSlice, bool quietMode, const std::vector<SeedCluster>& seedHits, WideReusableStateType& reusableState, double preciseClippingIdentityCutoff, int Xdropcutoff, double multimapScoreFraction, int clipAmbiguousEnds, size_t maxTraceCount, size_t maxDPTableBytes)
+{
+	return alignClusters<__uint128_t>(graph, seq_id, sequence, alignmentBandwidth, maxCellsPerSlice, quietMode, seedHits, reusableState, preciseClippingIdentityCutoff, Xdropcutoff, multimapScoreFraction, clipAmbiguousEnds, maxTraceCount, maxDPTableBytes);
+}
+
+AlignmentResult AlignClustersParallel(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t alignmentBandwidth, size_t maxCellsPerSlice, bool quietMode, const std::vector<SeedCluster>& seedHits, WideReusableStateType& reusableState, WideClusterTaskPool& pool, size_t worker, double preciseClippingIdentityCutoff, int Xdropcutoff, double multimapScoreFraction, int clipAmbiguousEnds, size_t maxTraceCount, size_t maxDPTableBytes)
+{
+	return alignClustersParallel<__uint128_t>(graph, seq_id, sequence, alignmentBandwidth, maxCellsPerSlice, quietMode, seedHits, reusableState, pool, worker, preciseClippingIdentityCutoff, Xdropcutoff, multimapScoreFraction, clipAmbiguousEnds, maxTraceCount, maxDPTableBytes);
+}
+
 void AddAlignment(const std::string& seq_id, const std::string& sequence, AlignmentResult::AlignmentItem& alignment)
 {
-	GraphAlignerCommon<size_t, int64_t, uint64_t>::Params params {1, AlignmentGraph::DummyGraph(), 1, true, .5, 0, 0, 0, 0};
+	GraphAlignerCommon<size_t, int64_t, uint64_t>::Params params {1, AlignmentGraph::DummyGraph(), 1, true, .5, 0, 0, 0, 0, 0};
 	GraphAligner<size_t, int64_t, uint64_t> aligner {params};
 	aligner.AddAlignment(seq_id, sequence, alignment);
 }
 
 void AddGAFLine(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, AlignmentResult::AlignmentItem& alignment, bool cigarMatchMismatchMerge, bool includeCigar)
 {
-	GraphAlignerCommon<size_t, int64_t, uint64_t>::Params params {1, graph, 1, true, .5, 0, 0, 0, 0};
+	GraphAlignerCommon<size_t, int64_t, uint64_t>::Params params {1, graph, 1, true, .5, 0, 0, 0, 0, 0};
 	GraphAligner<size_t, int64_t, uint64_t> aligner {params};
 	aligner.AddGAFLine(seq_id, sequence, alignment, cigarMatchMismatchMerge, includeCigar);
 }
 
 void AddCorrected(AlignmentResult::AlignmentItem& alignment)
 {
-	GraphAlignerCommon<size_t, int64_t, uint64_t>::Params params {1, AlignmentGraph::DummyGraph(), 1, true, .5, 0, 0, 0, 0};
+	GraphAlignerCommon<size_t, int64_t, uint64_t>::Params params {1, AlignmentGraph::DummyGraph(), 1, true, .5, 0, 0, 0, 0, 0};
 	GraphAligner<size_t, int64_t, uint64_t> aligner {params};
 	aligner.AddCorrected(alignment);
 }
 
 std::vector<SeedCluster> ClusterSeeds(const AlignmentGraph& graph, const std::vector<SeedHit>& seedHits, const size_t seedClusterMinSize)
 {
-	GraphAlignerCommon<size_t, int64_t, uint64_t>::Params params {1, graph, 1, true, .5, 0, 0, 0, 0};
+	GraphAlignerCommon<size_t, int64_t, uint64_t>::Params params {1, graph, 1, true, .5, 0, 0, 0, 0, 0};
 	GraphAligner<size_t, int64_t, uint64_t> aligner {params};
 	return aligner.clusterSeeds(seedHits, seedClusterMinSize);
 }
@@ -0,0 +1,176 @@
+#ifndef MappedArray_h
+#define MappedArray_h
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include "ThreadReadAssertion.h"
+
+// array which either owns its elements like a vector, or points into a read-only file mapping which it keeps alive
+// the operations which modify the array first copy a mapped array into owned memory, since the mapping is read-only
+template <typename T>
+class MappedArray
+{
+public:
+	using value_type = T;
+	using const_iterator = const T*;
+	MappedArray() :
+		owned(),
+		mapping(),
+		start(nullptr),
+		count(0)
+	{
+	}
+	MappedArray(const MappedArray& other) :
+		owned(other.owned),
+		mapping(other.mapping),
+		start(other.start),
+		count(other.count)
+	{
+		if (mapping == nullptr) sync();
+	}
+	MappedArray(MappedArray&& other) :
+		owned(std::move(other.owned)),
+		mapping(std::move(other.mapping)),
+		start(other.start),
+		count(other.count)
+	{
+		if (mapping == nullptr) sync();
+		other.clear();
+	}
+	MappedArray& operator=(const MappedArray& other)
+	{
+		owned = other.owned;
+		mapping = other.mapping;
+		start = other.start;
+		count = other.count;
+		if (mapping == nullptr) sync();
+		return *this;
+	}
+	MappedArray& operator=(MappedArray&& other)
+	{
+		owned = std::move(other.owned);
+		mapping = std::move(other.mapping);
+		start = other.start;
+		count = other.count;
+		if (mapping == nullptr) sync();
+		other.clear();
+		return *this;
+	}
+	MappedArray& operator=(std::vector<T>&& vec)
+	{
+		owned = std::move(vec);
+		mapping.reset();
+		sync();
+		return *this;
+	}
+	// points to count elements at data, which are kept valid by mapping
+	void map(std::shared_ptr<const char> newMapping, const T* data, size_t newCount)
+	{
+		std::vector<T>{}.swap(owned);
+		mapping = std::move(newMapping);
+		start = data;
+		count = newCount;
+	}
+	size_t size() const
+	{
+		return count;
+	}
+	bool empty() const
+	{
+		return count == 0;
+	}
+	const T* data() const
+	{
+		return start;
+	}
+	const T* begin() const
+	{
+		return start;
+	}
+	const T* end() const
+	{
+		return start + count;
+	}
+	const T& back() const
+	{
+		assert(count > 0);
+		return start[count-1];
+	}
+	const T& operator[](size_t index) const
+	{
+		assert(index < count);
+		return start[index];
+	}
+	T& operator[](size_t index)
+	{
+		assert(index < count);
+		if (mapping != nullptr) copyMapping();
+		return owned[index];
+	}
+	void clear()
+	{
+		owned.clear();
+		mapping.reset();
+		sync();
+	}
+	void reserve(size_t newCapacity)
+	{
+		if (mapping != nullptr) copyMapping();
+		owned.reserve(newCapacity);
+		sync();
+	}
+	void resize(size_t newSize)
+	{
+		if (mapping != nullptr) copyMapping();
+		owned.resize(newSize);
+		sync();
+	}
+	void resize(size_t newSize, const T& value)
+	{
+		if (mapping != nullptr) copyMapping();
+		owned.resize(newSize, value);
+		sync();
+	}
+	void push_back(const T& value)
+	{
+		if (mapping != nullptr) copyMapping();
+		owned.push_back(value);
+		sync();
+	}
+	template <typename... Args>
+	void emplace_back(Args&&... args)
+	{
+		if (mapping != nullptr) copyMapping();
+		owned.emplace_back(std::forward<Args>(args)...);
+		sync();
+	}
+	template <typename Iterator>
+	void insert(const T* position, Iterator first, Iterator last)
+	{
+		size_t offset = position - start;
+		if (mapping != nullptr) copyMapping();
+		owned.insert(owned.begin() + offset, first, last);
+		sync();
+	}
+private:
+	void copyMapping()
+	{
+		std::vector<T> copy { start, start + count };
+		owned = std::move(copy);
+		mapping.reset();
+		sync();
+	}
+	void sync()
+	{
+		start = owned.data();
+		count = owned.size();
+	}
+	std::vector<T> owned;
+	std::shared_ptr<const char> mapping;
+	const T* start;
+	size_t count;
+};
+
+#endif
@@ -1,9 +1,23 @@
 #include <queue>
+#include <map>
+#include <array>
+#include <type_traits>
 #include <thread>
 #include <cmath>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <condition_variable>
+#include <unistd.h>
 #include <concurrentqueue.h>
 #include "CommonUtils.h"
 #include "MinimizerSeeder.h"
+#include "Serialize.h"
+#include "SeedingKernel.h"
+
+constexpr uint64_t MinimizerIndexMagic = 0x3158444e494e494d; // "MININDX1"
+constexpr uint64_t MinimizerIndexVersion = 2;
 
 size_t charToInt(char c)
 {
@@ -55,6 +69,16 @@ uint64_t hash(uint64_t key) {
 
 std::vector<bool> validChar = getValidChars();
 
+// encodes into a buffer which the thread reuses, so iterating a node or a read doesn't allocate once the buffer has grown to the longest sequence
+// the codes are followed by one InvalidBase. They are valid until the thread's next call, so the iterations using this must not be nested
+const uint8_t* encodeIntoThreadBuffer(const std::string& str)
+{
+	thread_local std::vector<uint8_t> codes;
+	if (codes.size() < str.size() + 1) codes.resize(str.size() + 1);
+	SeedingKernel::EncodeBases(str.data(), str.size(), codes.data());
+	codes[str.size()] = SeedingKernel::InvalidBase;
+	return codes.data();
+}
 
 template <typename CallbackF>
 void iterateKmers(const std::string& str, size_t kmerLength, size_t windowSize, CallbackF callback)
@@ -64,34 +88,35 @@ void iterateKmers(const std::string& str, size_t kmerLength, size_t windowSize,
 	if (str.size() < kmerLength) return;
 	const size_t mask = ~(0xFFFFFFFFFFFFFFFF << (kmerLength * 2));
 	assert(mask == pow(4, kmerLength)-1);
+	const uint8_t* codes = encodeIntoThreadBuffer(str);
 	size_t offset = 0;
 start:
-	while (offset < str.size() && !validChar[str[offset]]) offset++;
+	while (offset < str.size() && codes[offset] == SeedingKernel::InvalidBase) offset++;
 	if (offset + kmerLength > str.size()) return;
 	size_t kmer = 0;
 	for (size_t i = 0; i < kmerLength; i++)
 	{
-		if (!validChar[str[offset+i]])
+		if (codes[offset+i] == SeedingKernel::InvalidBase)
 		{
 			offset += i;
 			goto start;
 		}
 		kmer <<= 2;
-		kmer |= charToInt(str[offset+i]);
+		kmer |= codes[offset+i];
 	}
 	callback(offset + kmerLength-1, kmer);
 	size_t lastKmer = kmer;
 	size_t lastPos = offset + kmerLength-1;
 	for (size_t i = kmerLength; offset+i < str.size(); i++)
 	{
-		if (!validChar[str[offset+i]])
+		if (codes[offset+i] == SeedingKernel::InvalidBase)
 		{
 			offset += i;
 			goto start;
 		}
 		kmer <<= 2;
 		kmer &= mask;
-		kmer |= charToInt(str[offset + i]);
+		kmer |= codes[offset + i];
 		if (lastKmer != kmer || lastPos <= offset + i - realWindow)
 		{
 			callback(offset + i, kmer);
@@ -101,8 +126,83 @@ start:
 	}
 }
 
-template <typename CallbackF>
-void iterateMinimizersReal(const std::string& str, size_t minimizerLength, size_t windowSize, CallbackF callback)
+// monotone queue of the k-mers in a minimizer window in a ring buffer, so that sliding the window doesn't allocate
+// Capacity is a power of two at least the window size, or 0 to size the buffer at runtime for unusually large windows
+template <size_t Capacity>
+class MinimizerWindow
+{
+public:
+	struct Item
+	{
+		size_t pos;
+		size_t kmer;
+		size_t hash;
+	};
+	MinimizerWindow(size_t windowSize) :
+	items(),
+	start(0),
+	count(0)
+	{
+		if constexpr (Capacity == 0)
+		{
+			size_t capacity = 1;
+			while (capacity < windowSize) capacity *= 2;
+			items.resize(capacity);
+		}
+		assert(windowSize <= items.size());
+		assert((items.size() & (items.size() - 1)) == 0);
+	}
+	void clear()
+	{
+		start = 0;
+		count = 0;
+	}
+	bool empty() const
+	{
+		return count == 0;
+	}
+	size_t size() const
+	{
+		return count;
+	}
+	const Item& operator[](size_t index) const
+	{
+		assert(index < count);
+		return items[(start + index) & (items.size() - 1)];
+	}
+	const Item& front() const
+	{
+		return (*this)[0];
+	}
+	const Item& back() const
+	{
+		return (*this)[count-1];
+	}
+	void push_back(size_t pos, size_t kmer, size_t hash)
+	{
+		assert(count < items.size());
+		items[(start + count) & (items.size() - 1)] = Item { pos, kmer, hash };
+		count += 1;
+	}
+	void pop_back()
+	{
+		assert(count > 0);
+		count -= 1;
+	}
+	void pop_front()
+	{
+		assert(count > 0);
+		start = (start + 1) & (items.size() - 1);
+		count -= 1;
+	}
+private:
+	typename std::conditional<Capacity == 0, std::vector<Item>, std::array<Item, Capacity>>::type items;
+	size_t start;
+	size_t count;
+};
+
+template <size_t Capacity, typename CallbackF>
+void iterateMinimizersWindow(const std::string& str, size_t minimizerLength, size_t windowSize, CallbackF callback)
 {
 	assert(minimizerLength * 2 <= sizeof(size_t) * 8);
 	assert(minimizerLength <= windowSize);
@@ -110,84 +210,107 @@ void iterateMinimizersReal(const std::string& str, size_t minimizerLength, size_
 	const size_t realWindow = windowSize - minimizerLength + 1;
 	const size_t mask = ~(0xFFFFFFFFFFFFFFFF << (minimizerLength * 2));
 	assert(mask == pow(4, minimizerLength)-1);
+	// filling the first window looks at one base past the end of a string of exactly windowSize bases, where the codes end with an invalid base like the string's terminator
+	const uint8_t* codes = encodeIntoThreadBuffer(str);
 	size_t offset = 0;
-	std::deque<std::tuple<size_t, size_t, size_t>> window;
+	// the first window has realWindow + 1 k-mers
+	MinimizerWindow<Capacity> window { realWindow + 1 };
 start:
-	while (offset < str.size() && !validChar[str[offset]]) offset++;
+	while (offset < str.size() && codes[offset] == SeedingKernel::InvalidBase) offset++;
 	if (offset + windowSize > str.size()) return;
 	size_t kmer = 0;
 	for (size_t i = 0; i < minimizerLength; i++)
 	{
-		if (!validChar[str[offset+i]])
+		if (codes[offset+i] == SeedingKernel::InvalidBase)
 		{
 			offset += i;
 			goto start;
 		}
 		kmer <<= 2;
-		kmer |= charToInt(str[offset+i]);
+		kmer |= codes[offset+i];
 	}
 	window.clear();
-	window.emplace_back(offset+minimizerLength-1, kmer, hash(kmer));
+	window.push_back(offset+minimizerLength-1, kmer, hash(kmer));
 	for (size_t i = minimizerLength; i < minimizerLength + realWindow; i++)
 	{
-		if (!validChar[str[offset + i]])
+		if (codes[offset + i] == SeedingKernel::InvalidBase)
 		{
 			offset += i;
 			goto start;
 		}
 		kmer <<= 2;
 		kmer &= mask;
-		kmer |= charToInt(str[offset + i]);
+		kmer |= codes[offset + i];
 		auto hashed = hash(kmer);
-		while (!window.empty() && std::get<2>(window.back()) > hashed) window.pop_back();
-		window.emplace_back(offset+i, kmer, hashed);
+		while (!window.empty() && window.back().hash > hashed) window.pop_back();
+		window.push_back(offset+i, kmer, hashed);
 	}
-	auto iter = window.begin();
-	while (iter != window.end() && std::get<2>(*iter) == std::get<2>(window.front()))
+	for (size_t j = 0; j < window.size() && window[j].hash == window.front().hash; j++)
 	{
-		callback(std::get<0>(*iter), std::get<1>(*iter));
-		++iter;
+		callback(window[j].pos, window[j].kmer);
 	}
 	for (size_t i = minimizerLength + realWindow; offset+i < str.size(); i++)
 	{
-		if (!validChar[str[offset+i]])
+		if (codes[offset+i] == SeedingKernel::InvalidBase)
 		{
 			offset += i;
 			goto start;
 		}
 		kmer <<= 2;
 		kmer &= mask;
-		kmer |= charToInt(str[offset + i]);
+		kmer |= codes[offset + i];
 		auto hashed = hash(kmer);
-		size_t oldMinimum = std::get<2>(window.front());
+		size_t oldMinimum = window.front().hash;
 		bool frontPopped = false;
-		while (!window.empty() && std::get<0>(window.front()) <= offset + i - realWindow)
+		while (!window.empty() && window.front().pos <= offset + i - realWindow)
 		{
 			frontPopped = true;
 			window.pop_front();
 		}
 		if (frontPopped)
 		{
-			while (window.size() >= 2 && std::get<2>(window.front()) == std::get<2>(*(window.begin()+1))) window.pop_front();
+			while (window.size() >= 2 && window.front().hash == window[1].hash) window.pop_front();
 		}
-		while (!window.empty() && std::get<2>(window.back()) > hashed) window.pop_back();
-		window.emplace_back(offset+i, kmer, hashed);
-		if (std::get<2>(window.front()) != oldMinimum)
+		while (!window.empty() && window.back().hash > hashed) window.pop_back();
+		window.push_back(offset+i, kmer, hashed);
+		if (window.front().hash != oldMinimum)
 		{
-			auto iter = window.begin();
-			while (iter != window.end() && std::get<2>(*iter) == std::get<2>(window.front()))
+			for (size_t j = 0; j < window.size() && window[j].hash == window.front().hash; j++)
 			{
-				callback(std::get<0>(*iter), std::get<1>(*iter));
-				++iter;
+				callback(window[j].pos, window[j].kmer);
 			}
 		}
-		else if (std::get<2>(window.back()) == std::get<2>(window.front()))
+		else if (window.back().hash == window.front().hash)
 		{
-			callback(std::get<0>(window.back()), std::get<1>(window.back()));
+			callback(window.back().pos, window.back().kmer);
 		}
 	}
 }
 
+// the window lives on the stack for the window sizes of the presets
+template <typename CallbackF>
+void iterateMinimizersReal(const std::string& str, size_t minimizerLength, size_t windowSize, CallbackF callback)
+{
+	assert(minimizerLength <= windowSize);
+	const size_t realWindow = windowSize - minimizerLength + 1;
+	if (realWindow + 1 <= 16)
+	{
+		iterateMinimizersWindow<16>(str, minimizerLength, windowSize, callback);
+	}
+	else if (realWindow + 1 <= 32)
+	{
+		iterateMinimizersWindow<32>(str, minimizerLength, windowSize, callback);
+	}
+	else if (realWindow + 1 <= 64)
+	{
+		iterateMinimizersWindow<64>(str, minimizerLength, windowSize, callback);
+	}
+	else
+	{
+		iterateMinimizersWindow<0>(str, minimizerLength, windowSize, callback);
+	}
+}
+
 #ifndef EXTRACORRECTNESSASSERTIONS
 
 template <typename CallbackF>
@@ -283,19 +406,333 @@ void iterateMinimizers(const std::string& str, size_t minimizerLength, size_t wi
 
 #endif
 
-MinimizerSeeder::MinimizerSeeder(const AlignmentGraph& graph, size_t minimizerLength, size_t windowSize, size_t numThreads, double keepLeastFrequentFraction) :
+MinimizerSeeder::MinimizerSeeder(const AlignmentGraph& graph, size_t minimizerLength, size_t windowSize, size_t numThreads, double keepLeastFrequentFraction, bool useHashTable, size_t indexMemoryLimit) :
+graph(graph),
+buckets(),
+table(),
+tablePositions(),
+useHashTable(useHashTable),
+minimizerLength(minimizerLength),
+windowSize(windowSize),
+maxCount(0)
+{
+	assert(minimizerLength * 2 <= sizeof(size_t) * 8);
+	assert(minimizerLength <= windowSize);
+	if (indexMemoryLimit > 0)
+	{
+		initMinimizersExternal(numThreads, indexMemoryLimit);
+	}
+	else
+	{
+		initMinimizers(numThreads);
+	}
+	if (useHashTable) buildTable();
+	initMaxCount(keepLeastFrequentFraction);
+}
+
+MinimizerSeeder::MinimizerSeeder(const AlignmentGraph& graph, const std::string& indexFile, size_t minimizerLength, size_t windowSize, double keepLeastFrequentFraction, bool useHashTable) :
 graph(graph),
 buckets(),
+table(),
+tablePositions(),
+useHashTable(useHashTable),
 minimizerLength(minimizerLength),
 windowSize(windowSize),
 maxCount(0)
 {
 	assert(minimizerLength * 2 <= sizeof(size_t) * 8);
 	assert(minimizerLength <= windowSize);
-	initMinimizers(numThreads);
+	loadFrom(indexFile);
 	initMaxCount(keepLeastFrequentFraction);
 }
 
+// covers everything the minimizer positions depend on: the node split, the edges which decide where a node's minimizers start, and the sequences
+uint64_t graphFingerprint(const AlignmentGraph& graph)
+{
+	uint64_t result = hash(graph.NodeSize());
+	auto add = [&result](uint64_t value) { result = hash(result ^ value); };
+	for (size_t i = 0; i < graph.NodeSize(); i++)
+	{
+		add(graph.BigraphNodeID(i));
+		add(graph.NodeOffset(i));
+		add(graph.NodeLength(i));
+		add(graph.Reverse(i) ? 1 : 0);
+		for (auto neighbor : graph.InNeighbors(i))
+		{
+			add(neighbor);
+		}
+		if (i < graph.FirstAmbiguous())
+		{
+			auto chunks = graph.NodeChunks(i);
+			for (size_t j = 0; j < AlignmentGraph::CHUNKS_IN_NODE; j++)
+			{
+				add(chunks[j]);
+			}
+		}
+		else
+		{
+			auto chunks = graph.AmbiguousNodeChunks(i);
+			add(chunks.A);
+			add(chunks.C);
+			add(chunks.G);
+			add(chunks.T);
+		}
+	}
+	return result;
+}
+
+void MinimizerSeeder::saveTo(const std::string& filename) const
+{
+	// written under a temporary name and renamed so that other processes sharing the index never see a partial file
+	std::string tmpFilename = filename + ".tmp." + std::to_string(getpid());
+	std::ofstream file { tmpFilename, std::ios::binary };
+	if (!file.good())
+	{
+		std::cerr << "Cannot write minimizer index to file: " << tmpFilename << std::endl;
+		std::abort();
+	}
+	serialize(file, MinimizerIndexMagic);
+	serialize(file, MinimizerIndexVersion);
+	serialize(file, (uint64_t)minimizerLength);
+	serialize(file, (uint64_t)windowSize);
+	serialize(file, graphFingerprint(graph));
+	serialize(file, (uint64_t)(useHashTable ? 1 : 0));
+	if (useHashTable)
+	{
+		serialize(file, (uint64_t)table.size());
+		file.write((const char*)table.data(), table.size() * sizeof(KmerTableBucket));
+		tablePositions.serialize(file);
+	}
+	else
+	{
+		serialize(file, (uint64_t)buckets.size());
+		for (const auto& bucket : buckets)
+		{
+			assert(bucket.locator != nullptr);
+			bucket.locator->save(file);
+			bucket.kmerCheck.serialize(file);
+			bucket.startPos.serialize(file);
+			bucket.positions.serialize(file);
+		}
+	}
+	file.close();
+	if (!file.good() || rename(tmpFilename.c_str(), filename.c_str()) != 0)
+	{
+		std::cerr << "Cannot write minimizer index to file: " << filename << std::endl;
+		remove(tmpFilename.c_str());
+		std::abort();
+	}
+}
+
+void MinimizerSeeder::loadFrom(const std::string& filename)
+{
+	std::ifstream file { filename, std::ios::binary };
+	if (!file.good()) throw CommonUtils::InvalidGraphException { "Cannot read minimizer index from file: " + filename };
+	uint64_t magic = 0;
+	uint64_t version = 0;
+	uint64_t fileMinimizerLength = 0;
+	uint64_t fileWindowSize = 0;
+	uint64_t fingerprint = 0;
+	uint64_t fileUsesHashTable = 0;
+	uint64_t bucketCount = 0;
+	deserialize(file, magic);
+	if (!file.good() || magic != MinimizerIndexMagic) throw CommonUtils::InvalidGraphException { "Not a minimizer index file: " + filename };
+	deserialize(file, version);
+	if (version != MinimizerIndexVersion) throw CommonUtils::InvalidGraphException { "Minimizer index was built by a different version, rebuild it: " + filename };
+	deserialize(file, fileMinimizerLength);
+	deserialize(file, fileWindowSize);
+	if (fileMinimizerLength != minimizerLength || fileWindowSize != windowSize) throw CommonUtils::InvalidGraphException { "Minimizer index was built with minimizer length " + std::to_string(fileMinimizerLength) + " and window size " + std::to_string(fileWindowSize) + " but the parameters have " + std::to_string(minimizerLength) + " and " + std::to_string(windowSize) + ": " + filename };
+	deserialize(file, fingerprint);
+	if (fingerprint != graphFingerprint(graph)) throw CommonUtils::InvalidGraphException { "Minimizer index was built from a different graph: " + filename };
+	deserialize(file, fileUsesHashTable);
+	if (fileUsesHashTable != (useHashTable ? 1 : 0)) throw CommonUtils::InvalidGraphException { std::string { "Minimizer index was built " } + (fileUsesHashTable ? "with" : "without") + " the hash table layout but the parameters " + (useHashTable ? "use" : "don't use") + " it: " + filename };
+	deserialize(file, bucketCount);
+	if (!file.good() || bucketCount == 0) throw CommonUtils::InvalidGraphException { "Minimizer index is corrupted: " + filename };
+	if (useHashTable)
+	{
+		if ((bucketCount & (bucketCount - 1)) != 0) throw CommonUtils::InvalidGraphException { "Minimizer index is corrupted: " + filename };
+		table.resize(bucketCount);
+		file.read((char*)table.data(), table.size() * sizeof(KmerTableBucket));
+		if (file.good()) tablePositions.load(file);
+		if (!file.good()) throw CommonUtils::InvalidGraphException { "Minimizer index is truncated: " + filename };
+		bool hasEmptySlot = false;
+		for (const auto& bucket : table)
+		{
+			for (size_t slot = 0; slot < KmerTableBucket::Slots; slot++)
+			{
+				if (bucket.location[slot] == 0)
+				{
+					hasEmptySlot = true;
+					continue;
+				}
+				size_t start = bucket.location[slot] & KmerTableBucket::OffsetMask;
+				size_t count = bucket.location[slot] >> (64 - KmerTableBucket::CountBits);
+				if (count == 0 || start + count > tablePositions.size()) throw CommonUtils::InvalidGraphException { "Minimizer index is corrupted: " + filename };
+			}
+		}
+		if (!hasEmptySlot) throw CommonUtils::InvalidGraphException { "Minimizer index is corrupted: " + filename };
+		if (file.peek() != std::ifstream::traits_type::eof()) throw CommonUtils::InvalidGraphException { "Minimizer index has trailing data: " + filename };
+		return;
+	}
+	buckets.resize(bucketCount);
+	for (auto& bucket : buckets)
+	{
+		bucket.locator = new KmerBucket::boophf_t;
+		bucket.locator->load(file);
+		if (file.good()) bucket.kmerCheck.load(file);
+		if (file.good()) bucket.startPos.load(file);
+		if (file.good()) bucket.positions.load(file);
+		if (!file.good()) throw CommonUtils::InvalidGraphException { "Minimizer index is truncated: " + filename };
+		if (bucket.kmerCheck.size() != bucket.locator->nbKeys() || bucket.startPos.size() != bucket.locator->nbKeys() + 1 || bucket.startPos[bucket.startPos.size()-1] != bucket.positions.size())
+		{
+			throw CommonUtils::InvalidGraphException { "Minimizer index is corrupted: " + filename };
+		}
+	}
+	if (file.peek() != std::ifstream::traits_type::eof()) throw CommonUtils::InvalidGraphException { "Minimizer index has trailing data: " + filename };
+}
+
+std::unordered_map<size_t, size_t> MinimizerSeeder::getNodeMinimizerStarts() const
+{
+	std::unordered_map<size_t, size_t> nodeMinimizerStart;
+	for (size_t i = 0; i < graph.NodeSize(); i++)
+	{
+		nodeMinimizerStart[graph.BigraphNodeID(i)] = std::max(nodeMinimizerStart[graph.BigraphNodeID(i)], (size_t)0);
+		bool skipStart = false;
+		for (auto n : graph.InNeighbors(i))
+		{
+			if (graph.BigraphNodeID(n) != graph.BigraphNodeID(i))
+			{
+				skipStart = true;
+				break;
+			}
+		}
+		if (skipStart)
+		{
+			nodeMinimizerStart[graph.BigraphNodeID(i)] = std::max(nodeMinimizerStart[graph.BigraphNodeID(i)], graph.NodeOffset(i));
+		}
+	}
+	return nodeMinimizerStart;
+}
+
+// calls callback(kmer, position) for the minimizers of a bigraph node, position is the split node shifted by 6 plus the offset in it
+template <typename F>
+void MinimizerSeeder::iterateNodeMinimizers(size_t nodeId, const std::unordered_map<size_t, size_t>& nodeMinimizerStart, F callback) const
+{
+	std::string sequence = graph.BigraphNodeSeq(nodeId);
+	assert(sequence.size() == graph.BigraphNodeSize(nodeId));
+	size_t minimizerStart = nodeMinimizerStart.at(nodeId);
+	iterateMinimizers(sequence, minimizerLength, windowSize, [this, minimizerStart, nodeId, &callback](size_t pos, size_t kmer)
+	{
+		if (pos < minimizerStart) return;
+		size_t splitNode = graph.GetDigraphNode(nodeId, pos);
+		assert(splitNode < graph.NodeSize());
+		size_t remainingOffset = pos - graph.NodeOffset(splitNode);
+		assert(remainingOffset < 64);
+		uint64_t position = splitNode;
+		position <<= 6;
+		position += remainingOffset;
+		callback(kmer, position);
+	});
+}
+
+void MinimizerSeeder::buildBucket(size_t bucket, const sdsl::int_vector<0>& kmers, const sdsl::int_vector<0>& positions)
+{
+	if (useHashTable)
+	{
+		buildSortedBucket(bucket, kmers, positions);
+		return;
+	}
+	{
+		std::vector<uint64_t> locatorKeys;
+		{
+			sdsl::int_vector<0> sortedKmers;
+			sortedKmers = kmers;
+			std::sort(sortedKmers.begin(), sortedKmers.end(), [](uint64_t left, uint64_t right) { return left < right; });
+			size_t current = std::numeric_limits<size_t>::max();
+			for (uint64_t kmer : sortedKmers)
+			{
+				assert(getBucket(kmer) == bucket);
+				if (kmer == current)
+				{
+					continue;
+				}
+				current = kmer;
+				locatorKeys.push_back(current);
+			}
+		}
+		buckets[bucket].locator = new boomphf::mphf<uint64_t,KmerBucket::hasher_t>(locatorKeys.size(), locatorKeys, 1, 2, true, false);
+	}
+	buckets[bucket].startPos.width(log2(std::max(kmers.size(), (size_t)1))+1);
+	buckets[bucket].startPos.resize(buckets[bucket].locator->nbKeys() + 1);
+	buckets[bucket].kmerCheck.width(minimizerLength * 2);
+	buckets[bucket].kmerCheck.resize(buckets[bucket].locator->nbKeys());
+	sdsl::util::set_to_value(buckets[bucket].startPos, 0);
+	for (size_t i = 0; i < kmers.size(); i++)
+	{
+		uint64_t kmer = kmers[i];
+		size_t index = buckets[bucket].locator->lookup(kmer);
+		buckets[bucket].startPos[index] += 1;
+		buckets[bucket].kmerCheck[index] = kmer;
+	}
+	if (buckets[bucket].startPos.size() > 0)
+	{
+		for (size_t i = 1; i < buckets[bucket].startPos.size(); i++)
+		{
+			buckets[bucket].startPos[i] += buckets[bucket].startPos[i-1];
+		}
+		assert(buckets[bucket].startPos[buckets[bucket].startPos.size()-1] == kmers.size());
+		buckets[bucket].positions.resize(kmers.size());
+		for (size_t i = 0; i < kmers.size(); i++)
+		{
+			size_t kmer = kmers[i];
+			size_t index = buckets[bucket].locator->lookup(kmer);
+			assert(buckets[bucket].startPos[index] > 0);
+			buckets[bucket].startPos[index] -= 1;
+			size_t pos = buckets[bucket].startPos[index];
+			uint64_t insert = positions[i];
+			buckets[bucket].positions[pos] = insert;
+		};
+	}
+}
+
+// for the hash table layout, which doesn't need the locator: the bucket keeps only the sorted distinct k-mers in kmerCheck with their start positions for buildTable
+// the positions of a k-mer are in the same order as with the locator
+void MinimizerSeeder::buildSortedBucket(size_t bucket, const sdsl::int_vector<0>& kmers, const sdsl::int_vector<0>& positions)
+{
+	std::vector<std::pair<uint64_t, uint64_t>> order;
+	order.reserve(kmers.size());
+	for (size_t i = 0; i < kmers.size(); i++)
+	{
+		assert(getBucket(kmers[i]) == bucket);
+		order.emplace_back(kmers[i], i);
+	}
+	// later occurrences first, like filling the locator's ranges backwards
+	std::sort(order.begin(), order.end(), [](std::pair<uint64_t, uint64_t> left, std::pair<uint64_t, uint64_t> right) { return left.first < right.first || (left.first == right.first && left.second > right.second); });
+	size_t numKmers = 0;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		if (i == 0 || order[i].first != order[i-1].first) numKmers += 1;
+	}
+	buckets[bucket].startPos.width(log2(std::max(kmers.size(), (size_t)1))+1);
+	buckets[bucket].startPos.resize(numKmers + 1);
+	buckets[bucket].kmerCheck.width(minimizerLength * 2);
+	buckets[bucket].kmerCheck.resize(numKmers);
+	buckets[bucket].positions.resize(kmers.size());
+	size_t kmerIndex = 0;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		if (i == 0 || order[i].first != order[i-1].first)
+		{
+			buckets[bucket].kmerCheck[kmerIndex] = order[i].first;
+			buckets[bucket].startPos[kmerIndex] = i;
+			kmerIndex += 1;
+		}
+		buckets[bucket].positions[i] = positions[order[i].second];
+	}
+	assert(kmerIndex == numKmers);
+	buckets[bucket].startPos[numKmers] = kmers.size();
+}
+
 void MinimizerSeeder::initMinimizers(size_t numThreads)
 {
 	size_t positionSize = log2(graph.NodeSize()) + 1;
@@ -319,24 +756,7 @@ void MinimizerSeeder::initMinimizers(size_t numThreads)
 		buckets[i].positions.width(positionSize + 6);
 	}
 
-	std::unordered_map<size_t, size_t> nodeMinimizerStart;
-	for (size_t i = 0; i < graph.NodeSize(); i++)
-	{
-		nodeMinimizerStart[graph.BigraphNodeID(i)] = std::max(nodeMinimizerStart[graph.BigraphNodeID(i)], (size_t)0);
-		bool skipStart = false;
-		for (auto n : graph.InNeighbors(i))
-		{
-			if (graph.BigraphNodeID(n) != graph.BigraphNodeID(i))
-			{
-				skipStart = true;
-				break;
-			}
-		}
-		if (skipStart)
-		{
-			nodeMinimizerStart[graph.BigraphNodeID(i)] = std::max(nodeMinimizerStart[graph.BigraphNodeID(i)], graph.NodeOffset(i));
-		}
-	}
+	std::unordered_map<size_t, size_t> nodeMinimizerStart = getNodeMinimizerStarts();
 
 	size_t nodeI = 0;
 	for (size_t thread = 0; thread < numThreads; thread++)
@@ -355,15 +775,8 @@ void MinimizerSeeder::initMinimizers(size_t numThreads)
 					if (nodeI != graph.BigraphNodeCount()) ++nodeI;
 				}
 				if (nodeId == graph.BigraphNodeCount()) break;
-				std::string sequence = graph.BigraphNodeSeq(nodeId);
-				assert(sequence.size() == graph.BigraphNodeSize(nodeId));
-				iterateMinimizers(sequence, minimizerLength, windowSize, [this, &nodeMinimizerStart, &positionDistributor, &kmerPerBucket, &positionPerBucket, &vecPos, positionSize, thread, nodeId](size_t pos, size_t kmer)
+				iterateNodeMinimizers(nodeId, nodeMinimizerStart, [this, &positionDistributor, &kmerPerBucket, &positionPerBucket, &vecPos, thread](size_t kmer, uint64_t position)
 				{
-					if (pos < nodeMinimizerStart.at(nodeId)) return;
-					size_t splitNode = graph.GetDigraphNode(nodeId, pos);
-					assert(splitNode < (size_t)1 << positionSize);
-					size_t remainingOffset = pos - graph.NodeOffset(splitNode);
-					assert(remainingOffset < 64);
 					std::pair<uint64_t, uint64_t> readThis;
 					while (positionDistributor[thread].try_dequeue(readThis))
 					{
@@ -382,9 +795,7 @@ void MinimizerSeeder::initMinimizers(size_t numThreads)
 					std::pair<uint64_t, uint64_t> storeThis;
 					storeThis.first = kmer;
 					size_t bucket = getBucket(kmer);
-					storeThis.second = splitNode;
-					storeThis.second <<= 6;
-					storeThis.second += remainingOffset;
+					storeThis.second = position;
 					positionDistributor[bucket].enqueue(storeThis);
 				});
 			}
@@ -423,57 +834,7 @@ void MinimizerSeeder::initMinimizers(size_t numThreads)
 			}
 			kmerPerBucket[thread].resize(vecPos);
 			positionPerBucket[thread].resize(vecPos);
-			{
-				std::vector<uint64_t> locatorKeys;
-				{
-					sdsl::int_vector<0> sortedKmers;
-					sortedKmers = kmerPerBucket[thread];
-					std::sort(sortedKmers.begin(), sortedKmers.end(), [positionSize](uint64_t left, uint64_t right) { return left < right; });
-					size_t current = std::numeric_limits<size_t>::max();
-					for (uint64_t kmer : sortedKmers)
-					{
-						assert(getBucket(kmer) == thread);
-						if (kmer == current)
-						{
-							continue;
-						}
-						current = kmer;
-						locatorKeys.push_back(current);
-					}
-				}
-				buckets[thread].locator = new boomphf::mphf<uint64_t,KmerBucket::hasher_t>(locatorKeys.size(), locatorKeys, 1, 2, true, false);
-			}
-			buckets[thread].startPos.width(log2(kmerPerBucket[thread].size())+1);
-			buckets[thread].startPos.resize(buckets[thread].locator->nbKeys() + 1);
-			buckets[thread].kmerCheck.width(minimizerLength * 2);
-			buckets[thread].kmerCheck.resize(buckets[thread].locator->nbKeys());
-			sdsl::util::set_to_value(buckets[thread].startPos, 0);
-			for (size_t i = 0; i < kmerPerBucket[thread].size(); i++)
-			{
-				uint64_t kmer = kmerPerBucket[thread][i];
-				size_t index = buckets[thread].locator->lookup(kmer);
-				buckets[thread].startPos[index] += 1;
-				buckets[thread].kmerCheck[index] = kmer;
-			}
-			if (buckets[thread].startPos.size() > 0)
-			{
-				for (size_t i = 1; i < buckets[thread].startPos.size(); i++)
-				{
-					buckets[thread].startPos[i] += buckets[thread].startPos[i-1];
-				}
-				assert(buckets[thread].startPos[buckets[thread].startPos.size()-1] == kmerPerBucket[thread].size());
-				buckets[thread].positions.resize(kmerPerBucket[thread].size());
-				for (size_t i = 0; i < kmerPerBucket[thread].size(); i++)
-				{
-					size_t kmer = kmerPerBucket[thread][i];
-					size_t index = buckets[thread].locator->lookup(kmer);
-					assert(buckets[thread].startPos[index] > 0);
-					buckets[thread].startPos[index] -= 1;
-					size_t pos = buckets[thread].startPos[index];
-					uint64_t insert = positionPerBucket[thread][i];
-					buckets[thread].positions[pos] = insert;
-				};
-			}
+			buildBucket(thread, kmerPerBucket[thread], positionPerBucket[thread]);
 		});
 	}
 
@@ -503,7 +864,7 @@ void MinimizerSeeder::addMinimizers(std::vector<SeedHit>& result, std::vector<st
 		allowedCount = end - start;
 		for (size_t i = start; i < end; i++)
 		{
-			size_t mergepos = buckets[bucket].positions[i];
+			size_t mergepos = getPosition(bucket, i);
 			size_t nodeId = mergepos >> 6;
 			size_t offset = mergepos & 63;
 			result.push_back(matchToSeedHit(nodeId, offset, std::get<0>(match), std::get<3>(match)));
@@ -515,20 +876,67 @@ void MinimizerSeeder::addMinimizers(std::vector<SeedHit>& result, std::vector<st
 std::vector<SeedHit> MinimizerSeeder::getSeeds(const std::string& sequence, double density) const
 {
 	std::vector<std::tuple<size_t, size_t, size_t, size_t>> matchIndices;
-	iterateKmers(sequence, minimizerLength, windowSize, [this, &matchIndices](size_t pos, size_t kmer)
+	// the locator lookups of a batch don't depend on each other so their cache misses overlap,
+	// and the kmerCheck and startPos words of the found k-mers are prefetched before they are read
+	size_t batchPos[LookupBatchSize];
+	size_t batchKmer[LookupBatchSize];
+	size_t batchBucket[LookupBatchSize];
+	uint64_t batchIndex[LookupBatchSize];
+	size_t batchSize = 0;
+	auto lookupBatch = [this, &matchIndices, &batchPos, &batchKmer, &batchBucket, &batchIndex, &batchSize]()
 	{
-		size_t bucket = getBucket(kmer);
-		assert(bucket < buckets.size());
-		size_t index = buckets[bucket].locator->lookup(kmer);
-		if (index == ULLONG_MAX) return;
-		assert(index < buckets[bucket].kmerCheck.size());
-		if (buckets[bucket].kmerCheck[(size_t)index] != kmer) return;
-		size_t start = getStart(bucket, index);
-		size_t end = getStart(bucket, index+1);
-		size_t count = end - start;
-		if (count >= maxCount) return;
-		matchIndices.emplace_back(pos, bucket, start, count);
+		if (useHashTable)
+		{
+			// a lookup is usually one cache line, fetch the lines of the whole batch first
+			for (size_t i = 0; i < batchSize; i++)
+			{
+				batchBucket[i] = getTableBucket(batchKmer[i]);
+				__builtin_prefetch(table.data() + batchBucket[i]);
+			}
+			for (size_t i = 0; i < batchSize; i++)
+			{
+				size_t start = 0;
+				size_t count = 0;
+				if (!tableLookup(batchKmer[i], start, count)) continue;
+				if (count >= maxCount) continue;
+				matchIndices.emplace_back(batchPos[i], 0, start, count);
+			}
+			batchSize = 0;
+			return;
+		}
+		for (size_t i = 0; i < batchSize; i++)
+		{
+			size_t bucket = getBucket(batchKmer[i]);
+			assert(bucket < buckets.size());
+			batchBucket[i] = bucket;
+			batchIndex[i] = buckets[bucket].locator->lookup(batchKmer[i]);
+			if (batchIndex[i] == ULLONG_MAX) continue;
+			prefetchEntry(buckets[bucket].kmerCheck, batchIndex[i]);
+			prefetchEntry(buckets[bucket].startPos, batchIndex[i]);
+		}
+		for (size_t i = 0; i < batchSize; i++)
+		{
+			size_t bucket = batchBucket[i];
+			size_t index = batchIndex[i];
+			if (index == ULLONG_MAX) continue;
+			assert(index < buckets[bucket].kmerCheck.size());
+			if (buckets[bucket].kmerCheck[index] != batchKmer[i]) continue;
+			size_t start = getStart(bucket, index);
+			size_t end = getStart(bucket, index+1);
+			size_t count = end - start;
+			if (count >= maxCount) continue;
+			matchIndices.emplace_back(batchPos[i], bucket, start, count);
+		}
+		batchSize = 0;
+	};
+	iterateKmers(sequence, minimizerLength, windowSize, [&batchPos, &batchKmer, &batchSize, &lookupBatch](size_t pos, size_t kmer)
+	{
+		batchPos[batchSize] = pos;
+		batchKmer[batchSize] = kmer;
+		batchSize += 1;
+		if (batchSize == LookupBatchSize) lookupBatch();
 	});
+	lookupBatch();
 	std::vector<SeedHit> result;
 	size_t maxHits = sequence.size() * density;
 	if (density == -1) maxHits = std::numeric_limits<size_t>::max();
@@ -544,23 +952,219 @@ SeedHit MinimizerSeeder::matchToSeedHit(int nodeId, size_t nodeOffset, size_t se
 	return result;
 }
 
+FILE* createTemporaryFile()
+{
+	const char* tmpDir = getenv("TMPDIR");
+	std::string pattern = std::string { tmpDir != nullptr ? tmpDir : "/tmp" } + "/GraphAligner_minimizers_XXXXXX";
+	std::vector<char> filename { pattern.begin(), pattern.end() };
+	filename.push_back(0);
+	int fd = mkstemp(filename.data());
+	if (fd == -1)
+	{
+		std::cerr << "Could not create a temporary file " << pattern << " for the minimizer index construction" << std::endl;
+		std::abort();
+	}
+	// the file is removed when it is closed, also if the program crashes
+	unlink(filename.data());
+	FILE* result = fdopen(fd, "w+b");
+	if (result == nullptr)
+	{
+		std::cerr << "Could not open a temporary file for the minimizer index construction" << std::endl;
+		std::abort();
+	}
+	return result;
+}
+
+// same index as initMinimizers, except that there are enough buckets that several of them can be built within memoryLimit
+// the minimizers are first written to one temporary file per bucket, then the buckets are built from the files
+// if there are too many buckets to keep their files open, this is done in several passes over the graph, each handling a range of the buckets
+// the memory limit doesn't include the finished index
+void MinimizerSeeder::initMinimizersExternal(size_t numThreads, size_t memoryLimit)
+{
+	size_t positionSize = log2(graph.NodeSize()) + 1;
+	assert(positionSize + 6 < 64);
+	assert(minimizerLength * 2 < 64);
+	size_t totalBases = 0;
+	for (size_t i = 0; i < graph.BigraphNodeCount(); i++)
+	{
+		totalBases += graph.BigraphNodeSize(i);
+	}
+	// random sequence has 2/(w+1) minimizers per base, leave some room for repeats
+	const size_t realWindow = windowSize - minimizerLength + 1;
+	size_t estimatedMinimizers = totalBases * 2 / (realWindow + 1) * 5 / 4 + 1;
+	size_t numPartitions = (estimatedMinimizers * BuildBytesPerMinimizer * PartitionsPerMemoryLimit + memoryLimit - 1) / memoryLimit;
+	numPartitions = std::max(numPartitions, MinPartitions);
+	// each thread buffers pairs of (kmer, position) for every partition of the pass
+	size_t partitionsPerPass = memoryLimit / (numThreads * MinBufferPairs * sizeof(uint64_t) * 2);
+	partitionsPerPass = std::min(partitionsPerPass, MaxOpenPartitionFiles);
+	partitionsPerPass = std::max(partitionsPerPass, (size_t)1);
+	size_t bufferPairs = memoryLimit / (numThreads * std::min(partitionsPerPass, numPartitions) * sizeof(uint64_t) * 2);
+	bufferPairs = std::min(bufferPairs, (size_t)65536);
+	bufferPairs = std::max(bufferPairs, (size_t)16);
+	buckets.resize(numPartitions);
+	for (size_t i = 0; i < numPartitions; i++)
+	{
+		buckets[i].positions.width(positionSize + 6);
+	}
+
+	std::unordered_map<size_t, size_t> nodeMinimizerStart = getNodeMinimizerStarts();
+	std::vector<FILE*> partitionFiles(numPartitions, nullptr);
+	std::vector<std::mutex> partitionMutex(numPartitions);
+	std::vector<size_t> partitionSize(numPartitions, 0);
+	for (size_t passStart = 0; passStart < numPartitions; passStart += partitionsPerPass)
+	{
+		size_t passEnd = std::min(passStart + partitionsPerPass, numPartitions);
+		for (size_t i = passStart; i < passEnd; i++)
+		{
+			partitionFiles[i] = createTemporaryFile();
+		}
+		std::vector<std::thread> threads;
+		std::atomic<size_t> nextNode;
+		nextNode = 0;
+		for (size_t thread = 0; thread < numThreads; thread++)
+		{
+			threads.emplace_back([this, &nodeMinimizerStart, &partitionFiles, &partitionMutex, &partitionSize, &nextNode, passStart, passEnd, bufferPairs]()
+			{
+				std::vector<std::vector<uint64_t>> buffers;
+				buffers.resize(passEnd - passStart);
+				auto flush = [&partitionFiles, &partitionMutex, &partitionSize, &buffers, passStart](size_t partition)
+				{
+					std::vector<uint64_t>& buffer = buffers[partition - passStart];
+					std::lock_guard<std::mutex> lock { partitionMutex[partition] };
+					if (fwrite(buffer.data(), sizeof(uint64_t), buffer.size(), partitionFiles[partition]) != buffer.size())
+					{
+						std::cerr << "Could not write to a temporary file in the minimizer index construction" << std::endl;
+						std::abort();
+					}
+					partitionSize[partition] += buffer.size() / 2;
+					buffer.clear();
+				};
+				while (true)
+				{
+					size_t nodeId = nextNode++;
+					if (nodeId >= graph.BigraphNodeCount()) break;
+					iterateNodeMinimizers(nodeId, nodeMinimizerStart, [this, &buffers, &flush, passStart, passEnd, bufferPairs](size_t kmer, uint64_t position)
+					{
+						size_t partition = getBucket(kmer);
+						if (partition < passStart || partition >= passEnd) return;
+						std::vector<uint64_t>& buffer = buffers[partition - passStart];
+						buffer.push_back(kmer);
+						buffer.push_back(position);
+						if (buffer.size() == bufferPairs * 2) flush(partition);
+					});
+				}
+				for (size_t i = passStart; i < passEnd; i++)
+				{
+					if (buffers[i - passStart].size() > 0) flush(i);
+				}
+			});
+		}
+		for (size_t i = 0; i < threads.size(); i++)
+		{
+			threads[i].join();
+		}
+		threads.clear();
+
+		// partitions are built concurrently as long as their estimated memory use fits in the limit
+		// a partition bigger than the whole limit is built alone
+		std::mutex budgetMutex;
+		std::condition_variable budgetCondition;
+		size_t budgetUsed = 0;
+		std::atomic<size_t> nextPartition;
+		nextPartition = passStart;
+		for (size_t thread = 0; thread < numThreads; thread++)
+		{
+			threads.emplace_back([this, &partitionFiles, &partitionSize, &nextPartition, &budgetMutex, &budgetCondition, &budgetUsed, passEnd, memoryLimit, positionSize]()
+			{
+				std::vector<uint64_t> readBuffer;
+				readBuffer.resize(65536 * 2);
+				while (true)
+				{
+					size_t partition = nextPartition++;
+					if (partition >= passEnd) break;
+					size_t needed = partitionSize[partition] * BuildBytesPerMinimizer;
+					{
+						std::unique_lock<std::mutex> lock { budgetMutex };
+						budgetCondition.wait(lock, [&budgetUsed, needed, memoryLimit]() { return budgetUsed == 0 || budgetUsed + needed <= memoryLimit; });
+						budgetUsed += needed;
+					}
+					sdsl::int_vector<0> kmers;
+					sdsl::int_vector<0> positions;
+					kmers.width(minimizerLength * 2);
+					positions.width(positionSize + 6);
+					kmers.resize(partitionSize[partition]);
+					positions.resize(partitionSize[partition]);
+					rewind(partitionFiles[partition]);
+					size_t pairsRead = 0;
+					while (pairsRead < partitionSize[partition])
+					{
+						size_t readNow = std::min(readBuffer.size() / 2, partitionSize[partition] - pairsRead);
+						if (fread(readBuffer.data(), sizeof(uint64_t), readNow * 2, partitionFiles[partition]) != readNow * 2)
+						{
+							std::cerr << "Could not read a temporary file in the minimizer index construction" << std::endl;
+							std::abort();
+						}
+						for (size_t i = 0; i < readNow; i++)
+						{
+							kmers[pairsRead + i] = readBuffer[i * 2];
+							positions[pairsRead + i] = readBuffer[i * 2 + 1];
+						}
+						pairsRead += readNow;
+					}
+					fclose(partitionFiles[partition]);
+					partitionFiles[partition] = nullptr;
+					buildBucket(partition, kmers, positions);
+					{
+						std::lock_guard<std::mutex> lock { budgetMutex };
+						budgetUsed -= needed;
+					}
+					budgetCondition.notify_all();
+				}
+			});
+		}
+		for (size_t i = 0; i < threads.size(); i++)
+		{
+			threads[i].join();
+		}
+	}
+}
+
 void MinimizerSeeder::initMaxCount(double keepLeastFrequentFraction)
 {
 	maxCount = 0;
-	std::vector<size_t> counts;
+	// a histogram instead of a list of all counts, most k-mers have one of a few small counts
+	std::map<size_t, size_t> countHistogram;
+	size_t numCounts = 0;
+	for (const auto& bucket : table)
+	{
+		for (size_t slot = 0; slot < KmerTableBucket::Slots; slot++)
+		{
+			if (bucket.location[slot] == 0) continue;
+			countHistogram[bucket.location[slot] >> (64 - KmerTableBucket::CountBits)] += 1;
+			numCounts += 1;
+		}
+	}
 	for (size_t bucket = 0; bucket < buckets.size(); bucket++)
 	{
 		if (buckets[bucket].locator->nbKeys() == 0) continue;
 		for (size_t i = 0; i < buckets[bucket].locator->nbKeys()-1; i++)
 		{
-			counts.push_back(getStart(bucket, i+1) - getStart(bucket, i));
+			countHistogram[getStart(bucket, i+1) - getStart(bucket, i)] += 1;
+			numCounts += 1;
 		}
 	}
-	std::sort(counts.begin(), counts.end());
-	if (counts.size() == 0) return;
-	size_t index = counts.size() * keepLeastFrequentFraction;
-	if (index == counts.size()) index = counts.size()-1;
-	maxCount = counts[index];
+	if (numCounts == 0) return;
+	size_t index = numCounts * keepLeastFrequentFraction;
+	if (index == numCounts) index = numCounts-1;
+	for (auto pair : countHistogram)
+	{
+		if (index < pair.second)
+		{
+			maxCount = pair.first;
+			break;
+		}
+		index -= pair.second;
+	}
 	maxCount += 1;
 }
 
@@ -569,6 +1173,96 @@ size_t MinimizerSeeder::getStart(size_t bucket, size_t index) const
 	return buckets[bucket].startPos[index];
 }
 
+size_t MinimizerSeeder::getPosition(size_t bucket, size_t index) const
+{
+	if (useHashTable) return tablePositions[index];
+	return buckets[bucket].positions[index];
+}
+
+size_t MinimizerSeeder::getTableBucket(uint64_t kmer) const
+{
+	return hash(kmer) & (table.size() - 1);
+}
+
+bool MinimizerSeeder::tableLookup(uint64_t kmer, size_t& start, size_t& count) const
+{
+	size_t index = getTableBucket(kmer);
+	while (true)
+	{
+		const KmerTableBucket& bucket = table[index];
+		for (size_t slot = 0; slot < KmerTableBucket::Slots; slot++)
+		{
+			if (bucket.location[slot] == 0) return false;
+			if (bucket.kmer[slot] != kmer) continue;
+			start = bucket.location[slot] & KmerTableBucket::OffsetMask;
+			count = bucket.location[slot] >> (64 - KmerTableBucket::CountBits);
+			return true;
+		}
+		index = (index + 1) & (table.size() - 1);
+	}
+}
+
+// moves the k-mers of the sorted buckets to one open addressing table which keeps the k-mer, its count and the offset of its positions in the same cache line
+// k-mers with more than 2^24-2 positions keep only that many. They are far over any frequency cutoff so they're never used as seeds unless all minimizers are kept
+void MinimizerSeeder::buildTable()
+{
+	const size_t maxTableCount = ((size_t)1 << KmerTableBucket::CountBits) - 2;
+	size_t numKmers = 0;
+	size_t numPositions = 0;
+	for (const auto& bucket : buckets)
+	{
+		numKmers += bucket.kmerCheck.size();
+		for (size_t i = 0; i < bucket.kmerCheck.size(); i++)
+		{
+			numPositions += std::min(maxTableCount, (size_t)(bucket.startPos[i+1] - bucket.startPos[i]));
+		}
+	}
+	// at most 3/4 of the slots are used so that probes stay short and there is always an empty slot
+	size_t tableSize = 1;
+	while (tableSize * KmerTableBucket::Slots * 3 < numKmers * 4 + 4) tableSize *= 2;
+	table.resize(tableSize);
+	for (auto& bucket : table)
+	{
+		for (size_t slot = 0; slot < KmerTableBucket::Slots; slot++)
+		{
+			bucket.kmer[slot] = 0;
+			bucket.location[slot] = 0;
+		}
+	}
+	tablePositions.width(buckets.size() > 0 ? buckets[0].positions.width() : 64);
+	tablePositions.resize(numPositions);
+	size_t offset = 0;
+	for (const auto& bucket : buckets)
+	{
+		for (size_t i = 0; i < bucket.kmerCheck.size(); i++)
+		{
+			uint64_t kmer = bucket.kmerCheck[i];
+			size_t start = bucket.startPos[i];
+			size_t count = std::min(maxTableCount, (size_t)(bucket.startPos[i+1] - start));
+			assert(count > 0);
+			assert(offset <= KmerTableBucket::OffsetMask);
+			for (size_t j = 0; j < count; j++)
+			{
+				tablePositions[offset + j] = bucket.positions[start + j];
+			}
+			size_t index = getTableBucket(kmer);
+			while (table[index].location[KmerTableBucket::Slots-1] != 0) index = (index + 1) & (table.size() - 1);
+			size_t slot = 0;
+			while (table[index].location[slot] != 0) slot += 1;
+			table[index].kmer[slot] = kmer;
+			table[index].location[slot] = ((uint64_t)count << (64 - KmerTableBucket::CountBits)) + offset;
+			offset += count;
+		}
+	}
+	assert(offset == numPositions);
+	buckets.clear();
+}
+
+void MinimizerSeeder::prefetchEntry(const sdsl::int_vector<0>& vec, size_t index)
+{
+	__builtin_prefetch(vec.data() + index * vec.width() / 64);
+}
+
 size_t MinimizerSeeder::getBucket(size_t hash) const
 {
 	return hash % buckets.size();
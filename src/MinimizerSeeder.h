@@ -4,6 +4,7 @@
 #include <random>
 #include <vector>
 #include <string>
+#include <unordered_map>
 #include <sdsl/int_vector.hpp>
 #include <sdsl/select_support_mcl.hpp>
 #include <ParallelBB.h>
@@ -28,19 +29,58 @@ class MinimizerSeeder
 		sdsl::int_vector<0> startPos;
 		sdsl::int_vector<0> positions;
 	};
+	// one cache line of the open addressing table used instead of the buckets with useHashTable
+	// slots are filled in order and never removed, so an empty slot ends the probe
+	struct alignas(64) KmerTableBucket
+	{
+		static constexpr size_t Slots = 4;
+		// count in the top CountBits bits and offset to tablePositions in the rest, 0 for an empty slot
+		static constexpr size_t CountBits = 24;
+		static constexpr uint64_t OffsetMask = ((uint64_t)1 << (64 - CountBits)) - 1;
+		uint64_t kmer[Slots];
+		uint64_t location[Slots];
+	};
 public:
-	MinimizerSeeder(const AlignmentGraph& graph, size_t minimizerLength, size_t windowSize, size_t numThreads, double keepLeastFrequentFraction);
+	MinimizerSeeder(const AlignmentGraph& graph, size_t minimizerLength, size_t windowSize, size_t numThreads, double keepLeastFrequentFraction, bool useHashTable, size_t indexMemoryLimit);
+	// loads an index written by saveTo, throws CommonUtils::InvalidGraphException if it doesn't match the graph or the parameters
+	MinimizerSeeder(const AlignmentGraph& graph, const std::string& indexFile, size_t minimizerLength, size_t windowSize, double keepLeastFrequentFraction, bool useHashTable);
+	void saveTo(const std::string& filename) const;
 	std::vector<SeedHit> getSeeds(const std::string& sequence, double density) const;
 	bool canSeed() const;
 private:
+	static constexpr size_t LookupBatchSize = 16;
+	// upper estimate of the construction memory per minimizer occurrence of a partition, used with the index memory limit
+	static constexpr size_t BuildBytesPerMinimizer = 40;
+	// the partitions are sized so that this many of them can be built at once within the memory limit
+	static constexpr size_t PartitionsPerMemoryLimit = 16;
+	static constexpr size_t MinPartitions = 64;
+	// at most this many temporary files are open at once, more partitions are written in several passes over the graph
+	static constexpr size_t MaxOpenPartitionFiles = 256;
+	// smallest per-thread write buffer for one partition, fewer partitions are written per pass if the memory limit doesn't fit these
+	static constexpr size_t MinBufferPairs = 4096;
+	static void prefetchEntry(const sdsl::int_vector<0>& vec, size_t index);
 	void addMinimizers(std::vector<SeedHit>& result, std::vector<std::tuple<size_t, size_t, size_t, size_t>>& matchIndices, size_t maxCount) const;
 	size_t getStart(size_t bucket, size_t index) const;
+	size_t getPosition(size_t bucket, size_t index) const;
+	size_t getTableBucket(uint64_t kmer) const;
+	bool tableLookup(uint64_t kmer, size_t& start, size_t& count) const;
+	void buildTable();
 	size_t getBucket(size_t hash) const;
 	SeedHit matchToSeedHit(int nodeId, size_t nodeOffset, size_t seqPos, int count) const;
+	std::unordered_map<size_t, size_t> getNodeMinimizerStarts() const;
+	template <typename F>
+	void iterateNodeMinimizers(size_t nodeId, const std::unordered_map<size_t, size_t>& nodeMinimizerStart, F callback) const;
+	void buildBucket(size_t bucket, const sdsl::int_vector<0>& kmers, const sdsl::int_vector<0>& positions);
+	void buildSortedBucket(size_t bucket, const sdsl::int_vector<0>& kmers, const sdsl::int_vector<0>& positions);
 	void initMinimizers(size_t numThreads);
+	void initMinimizersExternal(size_t numThreads, size_t memoryLimit);
 	void initMaxCount(double keepLeastFrequentFraction);
+	void loadFrom(const std::string& filename);
 	const AlignmentGraph& graph;
 	std::vector<KmerBucket> buckets;
+	std::vector<KmerTableBucket> table;
+	sdsl::int_vector<0> tablePositions;
+	bool useHashTable;
 	size_t minimizerLength;
 	size_t windowSize;
 	size_t maxCount;
@@ -5,7 +5,8 @@
 #include <limits>
 #include <vector>
 #include <type_traits>
-#include <phmap.h>
+#include <algorithm>
+#include <cstdint>
 #include "AlignmentGraph.h"
 #include "ThreadReadAssertion.h"
 #include "WordSlice.h"
@@ -45,12 +46,170 @@ struct NodeSliceMapItemStruct
 #endif
 };
 
+// node index -> item map of one slice
+// items are stored densely in insertion order and found with an open addressed index of positions
+// clear() keeps the allocations so a recycled map doesn't grow or rehash again for similarly sized slices
+template <typename Item>
+class NodeSliceMap
+{
+public:
+	using value_type = std::pair<size_t, Item>;
+	using iterator = typename std::vector<value_type>::iterator;
+	using const_iterator = typename std::vector<value_type>::const_iterator;
+	NodeSliceMap() :
+	items(),
+	index(),
+	indexBits(0)
+	{
+	}
+	void reserve(size_t size)
+	{
+		items.reserve(size);
+		if (size * 2 > indexCapacity()) rebuildIndex(size * 2);
+	}
+	void resize(size_t size)
+	{
+		reserve(size);
+	}
+	void clear()
+	{
+		items.clear();
+		// only the part of the index the previous slice used is dirty
+		std::fill(index.begin(), index.begin() + indexCapacity(), 0);
+	}
+	size_t size() const
+	{
+		return items.size();
+	}
+	size_t capacity() const
+	{
+		return items.capacity();
+	}
+	Item& operator[](size_t key)
+	{
+		if ((items.size() + 1) * 2 > indexCapacity()) rebuildIndex((items.size() + 1) * 2);
+		size_t slot = findSlot(key);
+		if (index[slot] != 0) return items[index[slot]-1].second;
+		items.emplace_back(key, Item{});
+		index[slot] = items.size();
+		return items.back().second;
+	}
+	iterator find(size_t key)
+	{
+		if (items.size() == 0) return items.end();
+		size_t slot = findSlot(key);
+		if (index[slot] == 0) return items.end();
+		return items.begin() + (index[slot]-1);
+	}
+	const_iterator find(size_t key) const
+	{
+		if (items.size() == 0) return items.end();
+		size_t slot = findSlot(key);
+		if (index[slot] == 0) return items.end();
+		return items.begin() + (index[slot]-1);
+	}
+	iterator begin()
+	{
+		return items.begin();
+	}
+	iterator end()
+	{
+		return items.end();
+	}
+	const_iterator begin() const
+	{
+		return items.begin();
+	}
+	const_iterator end() const
+	{
+		return items.end();
+	}
+private:
+	static constexpr size_t MinIndexBits = 4;
+	size_t indexCapacity() const
+	{
+		if (indexBits == 0) return 0;
+		return ((size_t)1) << indexBits;
+	}
+	size_t findSlot(size_t key) const
+	{
+		assert(indexBits > 0);
+		size_t mask = indexCapacity() - 1;
+		size_t slot = (key * 0x9E3779B97F4A7C15ull) >> (64 - indexBits);
+		while (index[slot] != 0 && items[index[slot]-1].first != key)
+		{
+			slot = (slot + 1) & mask;
+		}
+		return slot;
+	}
+	void rebuildIndex(size_t minCapacity)
+	{
+		size_t bits = std::max(indexBits, MinIndexBits);
+		while ((((size_t)1) << bits) < minCapacity) bits++;
+		if (indexCapacity() > 0) std::fill(index.begin(), index.begin() + indexCapacity(), 0);
+		indexBits = bits;
+		if (index.size() < indexCapacity()) index.resize(indexCapacity(), 0);
+		for (size_t i = 0; i < items.size(); i++)
+		{
+			index[findSlot(items[i].first)] = i+1;
+		}
+	}
+	std::vector<value_type> items;
+	// position+1 in items, 0 is an empty slot
+	std::vector<uint32_t> index;
+	size_t indexBits;
+};
+
+// hands out slice maps and takes them back when the last slice sharing one is gone
+// the maps keep their memory in between so the allocations are reused over slices and reads
+// a finished DP table returns all of its maps at once, so only a limited number of normal sized maps are kept
+template <typename Item>
+class NodeSliceMapPool
+{
+public:
+	static constexpr size_t MaxFreeMaps = 256;
+	static constexpr size_t MaxPooledCapacity = 1024;
+	NodeSliceMapPool() :
+	freeMaps(std::make_shared<std::vector<std::unique_ptr<NodeSliceMap<Item>>>>())
+	{
+	}
+	std::shared_ptr<NodeSliceMap<Item>> get(size_t size)
+	{
+		std::unique_ptr<NodeSliceMap<Item>> result;
+		if (freeMaps->size() > 0)
+		{
+			result = std::move(freeMaps->back());
+			freeMaps->pop_back();
+		}
+		else
+		{
+			result = std::make_unique<NodeSliceMap<Item>>();
+		}
+		result->reserve(size);
+		// the deleter holds the free list itself, so maps that outlive the pool are still deleted correctly
+		auto returnTo = freeMaps;
+		return std::shared_ptr<NodeSliceMap<Item>>(result.release(), [returnTo](NodeSliceMap<Item>* map)
+		{
+			if (returnTo->size() >= MaxFreeMaps || map->capacity() > MaxPooledCapacity)
+			{
+				delete map;
+				return;
+			}
+			map->clear();
+			returnTo->emplace_back(map);
+		});
+	}
+private:
+	std::shared_ptr<std::vector<std::unique_ptr<NodeSliceMap<Item>>>> freeMaps;
+};
+
 template <typename LengthType, typename ScoreType, typename Word, bool UseVectorMap>
 class NodeSlice
 {
 public:
 	using NodeSliceMapItem = NodeSliceMapItemStruct<LengthType, ScoreType, Word>;
-	using MapType = phmap::flat_hash_map<size_t, NodeSliceMapItem>;
+	using MapType = NodeSliceMap<NodeSliceMapItem>;
+	using MapPool = NodeSliceMapPool<NodeSliceMapItem>;
 	using MapItem = NodeSliceMapItem;
 	class NodeSliceIterator : std::iterator<std::forward_iterator_tag, std::pair<size_t, MapItem>>
 	{
@@ -203,6 +362,11 @@ public:
 		nodes = std::make_shared<MapType>();
 		nodes->reserve(size);
 	}
+	void addEmptyNodeMap(size_t size, MapPool& pool)
+	{
+		assert(nodes == nullptr);
+		nodes = pool.get(size);
+	}
 	template <bool HasVectorMap = UseVectorMap>
 	typename std::enable_if<HasVectorMap, NodeSlice<LengthType, ScoreType, Word, false>>::type getMapSlice() const
 	{
@@ -0,0 +1,111 @@
+#ifndef ResettableBitvector_h
+#define ResettableBitvector_h
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include "ThreadReadAssertion.h"
+
+// graph-sized bitvector which remembers the indices that were changed from the default value
+// so that reset() costs time proportional to the changes instead of the size
+class ResettableBitvector
+{
+public:
+	class reference
+	{
+	public:
+		reference(ResettableBitvector& vec, size_t index) :
+		vec(vec),
+		index(index)
+		{
+		}
+		operator bool() const
+		{
+			return vec.bits[index];
+		}
+		reference& operator=(bool value)
+		{
+			vec.set(index, value);
+			return *this;
+		}
+		reference& operator=(const reference& other)
+		{
+			vec.set(index, (bool)other);
+			return *this;
+		}
+	private:
+		ResettableBitvector& vec;
+		size_t index;
+	};
+	ResettableBitvector() :
+	bits(),
+	touched(),
+	defaultValue(false),
+	compactSize(MinCompactSize)
+	{
+	}
+	void resize(size_t size, bool value)
+	{
+		assert(touched.size() == 0);
+		defaultValue = value;
+		bits.resize(size, value);
+	}
+	size_t size() const
+	{
+		return bits.size();
+	}
+	bool operator[](size_t index) const
+	{
+		return bits[index];
+	}
+	reference operator[](size_t index)
+	{
+		return reference { *this, index };
+	}
+	void set(size_t index, bool value)
+	{
+		bool wasDefault = bits[index] == defaultValue;
+		bits[index] = value;
+		if (value != defaultValue && wasDefault)
+		{
+			touched.push_back(index);
+			if (touched.size() >= compactSize) compact();
+		}
+	}
+	// sets every bit back to the default value
+	void reset()
+	{
+		for (auto index : touched)
+		{
+			bits[index] = defaultValue;
+		}
+		touched.clear();
+		compactSize = MinCompactSize;
+	}
+private:
+	static constexpr size_t MinCompactSize = 1024;
+	// most changes are undone by the aligner itself, drop the indices which are back to the default value and the duplicates
+	void compact()
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < touched.size(); i++)
+		{
+			if (bits[touched[i]] == defaultValue) continue;
+			bits[touched[i]] = defaultValue;
+			touched[kept] = touched[i];
+			kept += 1;
+		}
+		touched.resize(kept);
+		for (auto index : touched)
+		{
+			bits[index] = !defaultValue;
+		}
+		compactSize = std::max(MinCompactSize, touched.size() * 2);
+	}
+	std::vector<bool> bits;
+	std::vector<size_t> touched;
+	bool defaultValue;
+	size_t compactSize;
+};
+
+#endif
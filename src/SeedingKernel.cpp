@@ -0,0 +1,94 @@
+#include <array>
+#include "SeedingKernel.h"
+#if defined(__x86_64__) && !defined(NOSIMDKERNEL)
+#include <immintrin.h>
+#define SIMDKERNEL
+#endif
+
+namespace
+{
+	using EncodeFunction = void(*)(const char*, size_t, uint8_t*);
+
+	std::array<uint8_t, 256> getBaseCodes()
+	{
+		std::array<uint8_t, 256> result;
+		result.fill(SeedingKernel::InvalidBase);
+		result['a'] = 0;
+		result['A'] = 0;
+		result['c'] = 1;
+		result['C'] = 1;
+		result['g'] = 2;
+		result['G'] = 2;
+		result['t'] = 3;
+		result['T'] = 3;
+		return result;
+	}
+
+	const std::array<uint8_t, 256> baseCodes = getBaseCodes();
+
+	void encodeScalar(const char* sequence, size_t length, uint8_t* codes)
+	{
+		for (size_t i = 0; i < length; i++)
+		{
+			codes[i] = baseCodes[(uint8_t)sequence[i]];
+		}
+	}
+
+#ifdef SIMDKERNEL
+	// bits 1-2 of the ASCII code are 0, 1, 3, 2 for A, C, G, T in both cases, xoring the high bit into the low one gives 0, 1, 2, 3
+	// byte lanes don't have shifts, so shift 16-bit lanes and mask away the bits that crossed from the neighbouring byte
+	__attribute__((target("avx2")))
+	void encodeAVX2(const char* sequence, size_t length, uint8_t* codes)
+	{
+		const __m256i caseMask = _mm256_set1_epi8((char)0xDF);
+		const __m256i upperA = _mm256_set1_epi8('A');
+		const __m256i upperC = _mm256_set1_epi8('C');
+		const __m256i upperG = _mm256_set1_epi8('G');
+		const __m256i upperT = _mm256_set1_epi8('T');
+		const __m256i lowTwoBits = _mm256_set1_epi8(3);
+		const __m256i lowBit = _mm256_set1_epi8(1);
+		const __m256i invalid = _mm256_set1_epi8(SeedingKernel::InvalidBase);
+		size_t i = 0;
+		for (; i + 32 <= length; i += 32)
+		{
+			__m256i chars = _mm256_loadu_si256((const __m256i*)(sequence + i));
+			__m256i upper = _mm256_and_si256(chars, caseMask);
+			__m256i valid = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(upper, upperA), _mm256_cmpeq_epi8(upper, upperC)), _mm256_or_si256(_mm256_cmpeq_epi8(upper, upperG), _mm256_cmpeq_epi8(upper, upperT)));
+			__m256i bits = _mm256_and_si256(_mm256_srli_epi16(chars, 1), lowTwoBits);
+			__m256i code = _mm256_xor_si256(bits, _mm256_and_si256(_mm256_srli_epi16(bits, 1), lowBit));
+			_mm256_storeu_si256((__m256i*)(codes + i), _mm256_blendv_epi8(invalid, code, valid));
+		}
+		encodeScalar(sequence + i, length - i, codes + i);
+	}
+#endif
+
+	struct Implementation
+	{
+		EncodeFunction encode;
+		const char* name;
+	};
+
+	Implementation pickImplementation()
+	{
+#ifdef SIMDKERNEL
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) return { encodeAVX2, "AVX2" };
+#endif
+		return { encodeScalar, "scalar" };
+	}
+
+	const Implementation implementation = pickImplementation();
+}
+
+namespace SeedingKernel
+{
+	void EncodeBases(const char* sequence, size_t length, uint8_t* codes)
+	{
+		implementation.encode(sequence, length, codes);
+	}
+
+	const char* ImplementationName()
+	{
+		return implementation.name;
+	}
+}
@@ -0,0 +1,18 @@
+#ifndef SeedingKernel_h
+#define SeedingKernel_h
+
+#include <cstddef>
+#include <cstdint>
+
+// read-side base encoding for minimizer seeding
+// AVX2 / scalar implementation picked at startup from the CPU features, compile with -DNOSIMDKERNEL to always use the scalar one
+namespace SeedingKernel
+{
+	// code of a base which is not one of ACGT / acgt
+	constexpr uint8_t InvalidBase = 4;
+	// A, C, G, T in either case to 0, 1, 2, 3, anything else to InvalidBase
+	void EncodeBases(const char* sequence, size_t length, uint8_t* codes);
+	const char* ImplementationName();
+}
+
+#endif
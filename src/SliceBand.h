@@ -0,0 +1,75 @@
+#ifndef SliceBand_h
+#define SliceBand_h
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+// membership of the nodes in the band of one DP slice. A node is in the band if its stamp equals the current epoch,
+// so clearing the band between slices is a counter increment and lookups are plain loads
+class SliceBand
+{
+public:
+	class reference
+	{
+	public:
+		reference(SliceBand& band, size_t index) :
+		band(band),
+		index(index)
+		{
+		}
+		operator bool() const
+		{
+			return band.stamps[index] == band.epoch;
+		}
+		reference& operator=(bool value)
+		{
+			band.stamps[index] = value ? band.epoch : 0;
+			return *this;
+		}
+		reference& operator=(const reference& other)
+		{
+			return *this = (bool)other;
+		}
+	private:
+		SliceBand& band;
+		size_t index;
+	};
+	SliceBand() :
+	stamps(),
+	epoch(1)
+	{
+	}
+	void resize(size_t size)
+	{
+		stamps.resize(size, 0);
+	}
+	size_t size() const
+	{
+		return stamps.size();
+	}
+	bool operator[](size_t index) const
+	{
+		return stamps[index] == epoch;
+	}
+	reference operator[](size_t index)
+	{
+		return reference { *this, index };
+	}
+	// removes all nodes from the band
+	void clear()
+	{
+		epoch++;
+		if (epoch == 0)
+		{
+			std::fill(stamps.begin(), stamps.end(), 0);
+			epoch = 1;
+		}
+	}
+private:
+	std::vector<uint32_t> stamps;
+	uint32_t epoch;
+};
+
+#endif
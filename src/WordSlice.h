@@ -17,6 +17,8 @@ public:
 	static constexpr uint64_t AllZeros = 0x0000000000000000;
 	static constexpr uint64_t AllOnes = 0xFFFFFFFFFFFFFFFF;
 	static constexpr uint64_t LastBit = 0x8000000000000000;
+	//every second bit starting from the second one
+	static constexpr uint64_t AlternatingBits = 0xAAAAAAAAAAAAAAAA;
 	//positions of the sign bits for each chunk
 	static constexpr uint64_t SignMask = 0x8080808080808080;
 	//constant for multiplying the chunk popcounts into prefix sums
@@ -143,6 +145,48 @@ public:
 	}
 };
 
+//two 64-bit halves, slices cover 128 rows
+//the chunk tricks work on each half separately since a chunk never crosses the halves
+template <>
+class WordConfiguration<__uint128_t>
+{
+	using Half = WordConfiguration<uint64_t>;
+public:
+	static constexpr int WordSize = 128;
+	static constexpr int ChunkBits = Half::ChunkBits;
+	static constexpr __uint128_t AllZeros = 0;
+	static constexpr __uint128_t AllOnes = ~(__uint128_t)0;
+	static constexpr __uint128_t LastBit = (__uint128_t)1 << 127;
+	static constexpr __uint128_t AlternatingBits = ((__uint128_t)Half::AlternatingBits << 64) | Half::AlternatingBits;
+	static constexpr __uint128_t SignMask = ((__uint128_t)Half::SignMask << 64) | Half::SignMask;
+	static constexpr __uint128_t LSBMask = ((__uint128_t)Half::LSBMask << 64) | Half::LSBMask;
+
+	static uint64_t Low(__uint128_t x)
+	{
+		return (uint64_t)x;
+	}
+
+	static uint64_t High(__uint128_t x)
+	{
+		return (uint64_t)(x >> 64);
+	}
+
+	static int popcount(__uint128_t x)
+	{
+		return Half::popcount(Low(x)) + Half::popcount(High(x));
+	}
+
+	static __uint128_t ChunkPopcounts(__uint128_t value)
+	{
+		return ((__uint128_t)Half::ChunkPopcounts(High(value)) << 64) | Half::ChunkPopcounts(Low(value));
+	}
+
+	static int BitPosition(__uint128_t number, int rank)
+	{
+		return Half::BitPosition(Low(number), High(number), rank);
+	}
+};
+
 //uncomment if there's an undefined reference with -O0. why?
 // constexpr uint64_t WordConfiguration<uint64_t>::AllZeros;
 // constexpr uint64_t WordConfiguration<uint64_t>::AllOnes;
@@ -390,7 +434,7 @@ private:
 	{
 		ScoreType scoreBeforeStart = getScoreBeforeStart();
 		//rightmost VP between any VN's, aka one cell to the left of a minimum
-		Word priorityCausedMinima = 0xAAAAAAAAAAAAAAAA & ~VP & ~VN;
+		Word priorityCausedMinima = WordConfiguration<Word>::AlternatingBits & ~VP & ~VN;
 		priorityCausedMinima |= VN;
 		Word possibleLocalMinima = (VP & (priorityCausedMinima - VP));
 		//shift right by one to get the minimum
@@ -503,7 +547,6 @@ private:
 	static WordSlice mergeTwoSlices(WordSlice left, WordSlice right)
 	{
 		//O(log w), because prefix sums need log w chunks of log w bits
-		static_assert(std::is_same<Word, uint64_t>::value);
 		if (left.getScoreBeforeStart() > right.getScoreBeforeStart()) std::swap(left, right);
 		assert((left.VP & left.VN) == WordConfiguration<Word>::AllZeros);
 		assert((right.VP & right.VN) == WordConfiguration<Word>::AllZeros);
@@ -522,8 +565,8 @@ private:
 		assert((right.VP & right.VN) == WordConfiguration<Word>::AllZeros);
 		assert((leftSmaller & rightSmaller) == 0);
 		auto mask = (rightSmaller | ((leftSmaller | rightSmaller) - (rightSmaller << 1))) & ~leftSmaller;
-		uint64_t leftReduction = leftSmaller & (rightSmaller << 1);
-		uint64_t rightReduction = rightSmaller & (leftSmaller << 1);
+		Word leftReduction = leftSmaller & (rightSmaller << 1);
+		Word rightReduction = rightSmaller & (leftSmaller << 1);
 		if ((rightSmaller & 1) && left.getScoreBeforeStart() < right.getScoreBeforeStart())
 		{
 			rightReduction |= 1;
@@ -544,13 +587,17 @@ private:
 #ifdef NDEBUG
 	__attribute__((always_inline))
 #endif
-	static std::pair<uint64_t, uint64_t> differenceMasks(uint64_t leftVP, uint64_t leftVN, uint64_t rightVP, uint64_t rightVN, int scoreDifference)
+	static std::pair<Word, Word> differenceMasks(Word leftVP, Word leftVN, Word rightVP, Word rightVN, int scoreDifference)
 	{
 		auto result = differenceMasksBitTwiddle(leftVP, leftVN, rightVP, rightVN, scoreDifference);
 #ifdef EXTRACORRECTNESSASSERTIONS
-		auto debugCompare = differenceMasksWord(leftVP, leftVN, rightVP, rightVN, scoreDifference);
-		assert(result.first == debugCompare.first);
-		assert(result.second == debugCompare.second);
+		//the chunked prefix sum version only exists for one 64-bit word
+		if constexpr (std::is_same<Word, uint64_t>::value)
+		{
+			auto debugCompare = differenceMasksWord(leftVP, leftVN, rightVP, rightVN, scoreDifference);
+			assert(result.first == debugCompare.first);
+			assert(result.second == debugCompare.second);
+		}
 #endif
 		return result;
 	}
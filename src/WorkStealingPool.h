@@ -0,0 +1,164 @@
+#ifndef WorkStealingPool_h
+#define WorkStealingPool_h
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include "ThreadReadAssertion.h"
+
+// tasks shared between a fixed set of worker threads, each with its own State which the tasks run on
+// a worker pushes and pops its own tasks at the back of its deque, idle workers steal from the front of the others'
+// there are no dedicated threads, workers run tasks while waiting for their own tasks and after they run out of work
+template <typename State>
+class WorkStealingPool
+{
+public:
+	using Task = std::function<void(State&)>;
+	// tasks whose completion is waited for together. The first exception thrown by a task is rethrown by wait()
+	class TaskGroup
+	{
+	public:
+		TaskGroup() :
+		remaining(0),
+		error()
+		{
+		}
+	private:
+		std::atomic<size_t> remaining;
+		std::exception_ptr error;
+		friend class WorkStealingPool;
+	};
+	WorkStealingPool(size_t numWorkers) :
+	queues(),
+	queuedTasks(0),
+	activeWorkers(numWorkers),
+	waitMutex(),
+	waitCondition()
+	{
+		for (size_t i = 0; i < numWorkers; i++) queues.emplace_back(std::make_unique<WorkerQueue>());
+	}
+	WorkStealingPool(const WorkStealingPool& other) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool& other) = delete;
+	void submit(size_t worker, TaskGroup& group, Task task)
+	{
+		assert(worker < queues.size());
+		group.remaining += 1;
+		// counted before it is visible so that the count never goes below the tasks in the queues
+		{
+			std::lock_guard<std::mutex> lock { waitMutex };
+			queuedTasks += 1;
+		}
+		{
+			std::lock_guard<std::mutex> lock { queues[worker]->mutex };
+			queues[worker]->tasks.push_back(QueuedTask { std::move(task), &group });
+		}
+		waitCondition.notify_all();
+	}
+	// runs tasks until all of the group's tasks are done. The state may be used by other groups' tasks in between
+	void wait(size_t worker, State& state, TaskGroup& group)
+	{
+		while (group.remaining > 0)
+		{
+			if (runOne(worker, state)) continue;
+			std::unique_lock<std::mutex> lock { waitMutex };
+			waitCondition.wait(lock, [this, &group]() { return group.remaining == 0 || queuedTasks > 0; });
+		}
+		if (group.error) std::rethrow_exception(group.error);
+	}
+	// the worker has no more tasks of its own to submit. Helps the other workers until all of them are finished
+	// returns the time spent running tasks, in microseconds
+	uint64_t finish(size_t worker, State& state)
+	{
+		{
+			std::lock_guard<std::mutex> lock { waitMutex };
+			activeWorkers -= 1;
+		}
+		waitCondition.notify_all();
+		uint64_t runMicroseconds = 0;
+		while (true)
+		{
+			auto runStart = std::chrono::steady_clock::now();
+			if (runOne(worker, state))
+			{
+				runMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - runStart).count();
+				continue;
+			}
+			std::unique_lock<std::mutex> lock { waitMutex };
+			if (activeWorkers == 0 && queuedTasks == 0) break;
+			waitCondition.wait(lock, [this]() { return queuedTasks > 0 || activeWorkers == 0; });
+		}
+		return runMicroseconds;
+	}
+private:
+	struct QueuedTask
+	{
+		Task task;
+		TaskGroup* group;
+	};
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<QueuedTask> tasks;
+	};
+	bool tryTake(size_t worker, size_t from, QueuedTask& result)
+	{
+		std::lock_guard<std::mutex> lock { queues[from]->mutex };
+		if (queues[from]->tasks.size() == 0) return false;
+		if (from == worker)
+		{
+			result = std::move(queues[from]->tasks.back());
+			queues[from]->tasks.pop_back();
+		}
+		else
+		{
+			result = std::move(queues[from]->tasks.front());
+			queues[from]->tasks.pop_front();
+		}
+		return true;
+	}
+	bool runOne(size_t worker, State& state)
+	{
+		QueuedTask task;
+		bool found = false;
+		for (size_t i = 0; i < queues.size() && !found; i++)
+		{
+			found = tryTake(worker, (worker + i) % queues.size(), task);
+		}
+		if (!found) return false;
+		{
+			std::lock_guard<std::mutex> lock { waitMutex };
+			queuedTasks -= 1;
+		}
+		try
+		{
+			task.task(state);
+		}
+		catch (...)
+		{
+			// the state might be left in the middle of an alignment
+			state.clear();
+			std::lock_guard<std::mutex> lock { waitMutex };
+			if (!task.group->error) task.group->error = std::current_exception();
+		}
+		{
+			std::lock_guard<std::mutex> lock { waitMutex };
+			task.group->remaining -= 1;
+		}
+		waitCondition.notify_all();
+		return true;
+	}
+	std::vector<std::unique_ptr<WorkerQueue>> queues;
+	size_t queuedTasks;
+	size_t activeWorkers;
+	std::mutex waitMutex;
+	std::condition_variable waitCondition;
+};
+
+#endif
@@ -1,8 +1,488 @@
 #include <algorithm>
 #include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <thread>
+#include <condition_variable>
+#include <deque>
 #include "fastqloader.h"
 #include "CommonUtils.h"
 
+// compressed input is inflated in blocks of this size, the buffer grows if a line doesn't fit
+static constexpr size_t InputBlockSize = 4 * 1024 * 1024;
+// pooled reads with larger strings than this release their memory instead of keeping it around
+static constexpr size_t MaxPooledCapacity = 16 * 1024 * 1024;
+// how many decompressed blocks may wait for the parser per decompression thread
+static constexpr size_t BlocksInFlightPerThread = 64;
+
+// decompresses gzip input on helper threads and hands out the bytes in file order
+// BGZF members carry their compressed size so they are inflated in parallel,
+// other gzip input can't be split without inflating it so one helper thread inflates it ahead of the parser
+class GzipBlockReader
+{
+public:
+	GzipBlockReader(const std::string& filename, size_t numThreads);
+	~GzipBlockReader();
+	// blocks until data is available, returns 0 only at the end of the input
+	size_t read(char* target, size_t maxBytes);
+private:
+	struct Block
+	{
+		std::vector<char> compressed;
+		std::vector<char> decompressed;
+		size_t consumed = 0;
+		bool done = false;
+	};
+	static bool isBGZF(const unsigned char* header, size_t size);
+	bool readBGZFMember(std::vector<char>& result);
+	void inflateBGZFMember(Block& block);
+	void runBGZFWorker();
+	void runGzipWorker();
+	std::mutex mutex;
+	std::condition_variable blockReady;
+	std::condition_variable spaceAvailable;
+	std::deque<std::shared_ptr<Block>> ordered;
+	std::vector<std::thread> threads;
+	size_t maxBlocks;
+	bool inputFinished;
+	bool stopping;
+	int fd;
+	gzFile gzfile;
+	std::string filename;
+};
+
+GzipBlockReader::GzipBlockReader(const std::string& filename, size_t numThreads) :
+	mutex(),
+	blockReady(),
+	spaceAvailable(),
+	ordered(),
+	threads(),
+	maxBlocks(BlocksInFlightPerThread * std::max((size_t)1, numThreads)),
+	inputFinished(false),
+	stopping(false),
+	fd(-1),
+	gzfile(nullptr),
+	filename(filename)
+{
+	fd = open(filename.c_str(), O_RDONLY);
+	if (fd == -1)
+	{
+		std::cerr << "Could not open input file " << filename << ": " << strerror(errno) << std::endl;
+		std::abort();
+	}
+	unsigned char header[18];
+	ssize_t headerSize = pread(fd, header, sizeof(header), 0);
+	if (headerSize > 0 && isBGZF(header, headerSize))
+	{
+		for (size_t i = 0; i < std::max((size_t)1, numThreads); i++)
+		{
+			threads.emplace_back([this]() { runBGZFWorker(); });
+		}
+		return;
+	}
+	close(fd);
+	fd = -1;
+	gzfile = gzopen(filename.c_str(), "rb");
+	if (gzfile == nullptr)
+	{
+		std::cerr << "Could not open input file " << filename << ": " << strerror(errno) << std::endl;
+		std::abort();
+	}
+	gzbuffer(gzfile, 1024 * 1024);
+	maxBlocks = 4;
+	threads.emplace_back([this]() { runGzipWorker(); });
+}
+
+GzipBlockReader::~GzipBlockReader()
+{
+	{
+		std::lock_guard<std::mutex> lock { mutex };
+		stopping = true;
+	}
+	spaceAvailable.notify_all();
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		threads[i].join();
+	}
+	if (fd != -1) close(fd);
+	if (gzfile != nullptr) gzclose(gzfile);
+}
+
+// BGZF is gzip with the compressed member size in a "BC" extra subfield
+bool GzipBlockReader::isBGZF(const unsigned char* header, size_t size)
+{
+	if (size < 18) return false;
+	if (header[0] != 0x1f || header[1] != 0x8b || header[2] != 8) return false;
+	if ((header[3] & 4) == 0) return false;
+	size_t extraLength = header[10] + ((size_t)header[11] << 8);
+	if (extraLength != 6) return false;
+	return header[12] == 'B' && header[13] == 'C' && header[14] == 2 && header[15] == 0;
+}
+
+// called with the mutex held so members are read and queued in file order
+bool GzipBlockReader::readBGZFMember(std::vector<char>& result)
+{
+	unsigned char header[18];
+	size_t got = 0;
+	while (got < sizeof(header))
+	{
+		ssize_t readNow = ::read(fd, header + got, sizeof(header) - got);
+		if (readNow <= 0) break;
+		got += readNow;
+	}
+	if (got == 0) return false;
+	if (!isBGZF(header, got))
+	{
+		std::cerr << "Error reading compressed input " << filename << ": mixed BGZF and non-BGZF gzip members are not supported" << std::endl;
+		std::abort();
+	}
+	size_t memberSize = header[16] + ((size_t)header[17] << 8) + 1;
+	result.resize(memberSize);
+	memcpy(result.data(), header, sizeof(header));
+	got = sizeof(header);
+	while (got < memberSize)
+	{
+		ssize_t readNow = ::read(fd, result.data() + got, memberSize - got);
+		if (readNow <= 0)
+		{
+			std::cerr << "Error reading compressed input " << filename << ": truncated BGZF block" << std::endl;
+			std::abort();
+		}
+		got += readNow;
+	}
+	return true;
+}
+
+void GzipBlockReader::inflateBGZFMember(Block& block)
+{
+	const std::vector<char>& compressed = block.compressed;
+	size_t memberSize = compressed.size();
+	size_t uncompressedSize = (unsigned char)compressed[memberSize-4] + ((size_t)(unsigned char)compressed[memberSize-3] << 8) + ((size_t)(unsigned char)compressed[memberSize-2] << 16) + ((size_t)(unsigned char)compressed[memberSize-1] << 24);
+	block.decompressed.resize(uncompressedSize);
+	z_stream strm;
+	memset(&strm, 0, sizeof(strm));
+	// 16+MAX_WBITS: expect a gzip header and check the crc
+	if (inflateInit2(&strm, 16 + MAX_WBITS) != Z_OK)
+	{
+		std::cerr << "Error reading compressed input " << filename << ": could not initialize zlib" << std::endl;
+		std::abort();
+	}
+	strm.next_in = (Bytef*)compressed.data();
+	strm.avail_in = memberSize;
+	// empty blocks (like the BGZF end of file marker) still need a valid output pointer
+	char emptyOutput;
+	strm.next_out = (Bytef*)(uncompressedSize > 0 ? block.decompressed.data() : &emptyOutput);
+	strm.avail_out = uncompressedSize;
+	int result = inflate(&strm, Z_FINISH);
+	size_t totalOut = strm.total_out;
+	inflateEnd(&strm);
+	if (result != Z_STREAM_END || totalOut != uncompressedSize)
+	{
+		std::cerr << "Error reading compressed input " << filename << ": corrupted BGZF block" << std::endl;
+		std::abort();
+	}
+	block.compressed.clear();
+	block.compressed.shrink_to_fit();
+}
+
+void GzipBlockReader::runBGZFWorker()
+{
+	while (true)
+	{
+		std::shared_ptr<Block> block;
+		{
+			std::unique_lock<std::mutex> lock { mutex };
+			spaceAvailable.wait(lock, [this]() { return stopping || inputFinished || ordered.size() < maxBlocks; });
+			if (stopping || inputFinished) break;
+			block = std::make_shared<Block>();
+			if (!readBGZFMember(block->compressed))
+			{
+				inputFinished = true;
+				blockReady.notify_all();
+				spaceAvailable.notify_all();
+				break;
+			}
+			ordered.push_back(block);
+		}
+		inflateBGZFMember(*block);
+		{
+			std::lock_guard<std::mutex> lock { mutex };
+			block->done = true;
+		}
+		blockReady.notify_all();
+	}
+}
+
+void GzipBlockReader::runGzipWorker()
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock { mutex };
+			spaceAvailable.wait(lock, [this]() { return stopping || ordered.size() < maxBlocks; });
+			if (stopping) break;
+		}
+		std::shared_ptr<Block> block = std::make_shared<Block>();
+		block->decompressed.resize(InputBlockSize);
+		int got = gzread(gzfile, block->decompressed.data(), block->decompressed.size());
+		if (got < 0)
+		{
+			int errnum = 0;
+			std::cerr << "Error reading compressed input " << filename << ": " << gzerror(gzfile, &errnum) << std::endl;
+			std::abort();
+		}
+		std::lock_guard<std::mutex> lock { mutex };
+		if (got == 0)
+		{
+			inputFinished = true;
+			blockReady.notify_all();
+			break;
+		}
+		block->decompressed.resize(got);
+		block->done = true;
+		ordered.push_back(block);
+		blockReady.notify_all();
+	}
+}
+
+size_t GzipBlockReader::read(char* target, size_t maxBytes)
+{
+	while (true)
+	{
+		std::shared_ptr<Block> front;
+		{
+			std::unique_lock<std::mutex> lock { mutex };
+			blockReady.wait(lock, [this]() { return (ordered.size() > 0 && ordered.front()->done) || (ordered.size() == 0 && inputFinished); });
+			if (ordered.size() == 0) return 0;
+			front = ordered.front();
+			if (front->consumed == front->decompressed.size())
+			{
+				ordered.pop_front();
+				spaceAvailable.notify_one();
+				continue;
+			}
+		}
+		// only the parser thread touches consumed
+		size_t copied = std::min(maxBytes, front->decompressed.size() - front->consumed);
+		memcpy(target, front->decompressed.data() + front->consumed, copied);
+		front->consumed += copied;
+		return copied;
+	}
+}
+
+FastqInputBuffer::FastqInputBuffer(const std::string& filename, bool gzipped, size_t decompressionThreads) :
+	data(nullptr),
+	dataSize(0),
+	pos(0),
+	eof(false),
+	buffer(),
+	mapped(nullptr),
+	mappedSize(0),
+	gzreader(),
+	stream(nullptr),
+	fd(-1)
+{
+	if (gzipped)
+	{
+		gzreader = std::make_unique<GzipBlockReader>(filename, decompressionThreads);
+		buffer.resize(InputBlockSize);
+		data = buffer.data();
+		return;
+	}
+	fd = open(filename.c_str(), O_RDONLY);
+	if (fd == -1)
+	{
+		std::cerr << "Could not open input file " << filename << ": " << strerror(errno) << std::endl;
+		std::abort();
+	}
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) == 0 && S_ISREG(fileStat.st_mode))
+	{
+		void* map = MAP_FAILED;
+		if (fileStat.st_size > 0) map = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (fileStat.st_size == 0 || map != MAP_FAILED)
+		{
+			if (map != MAP_FAILED)
+			{
+				mapped = (char*)map;
+				mappedSize = fileStat.st_size;
+				madvise(mapped, mappedSize, MADV_SEQUENTIAL);
+				data = mapped;
+				dataSize = mappedSize;
+			}
+			eof = true;
+			close(fd);
+			fd = -1;
+			return;
+		}
+	}
+	// pipes and files which can't be mapped are read in blocks
+	buffer.resize(InputBlockSize);
+	data = buffer.data();
+}
+
+FastqInputBuffer::FastqInputBuffer(std::istream& stream) :
+	data(nullptr),
+	dataSize(0),
+	pos(0),
+	eof(false),
+	buffer(),
+	mapped(nullptr),
+	mappedSize(0),
+	gzreader(),
+	stream(&stream),
+	fd(-1)
+{
+	buffer.resize(InputBlockSize);
+	data = buffer.data();
+}
+
+FastqInputBuffer::~FastqInputBuffer()
+{
+	if (mapped != nullptr) munmap(mapped, mappedSize);
+	if (fd != -1) close(fd);
+}
+
+bool FastqInputBuffer::nextLine(std::string_view& line)
+{
+	while (true)
+	{
+		const char* start = data + pos;
+		const char* newline = nullptr;
+		if (pos < dataSize) newline = (const char*)memchr(start, '\n', dataSize - pos);
+		if (newline != nullptr)
+		{
+			line = std::string_view { start, (size_t)(newline - start) };
+			pos = newline - data + 1;
+			return true;
+		}
+		if (eof)
+		{
+			if (pos == dataSize) return false;
+			line = std::string_view { start, dataSize - pos };
+			pos = dataSize;
+			return true;
+		}
+		refill();
+	}
+}
+
+void FastqInputBuffer::refill()
+{
+	assert(mapped == nullptr);
+	size_t remaining = dataSize - pos;
+	if (remaining == buffer.size()) buffer.resize(buffer.size() * 2);
+	memmove(buffer.data(), buffer.data() + pos, remaining);
+	pos = 0;
+	dataSize = remaining;
+	size_t got = 0;
+	if (gzreader != nullptr)
+	{
+		// fill the whole buffer so long lines aren't moved for every decompressed block
+		while (dataSize + got < buffer.size())
+		{
+			size_t readNow = gzreader->read(buffer.data() + dataSize + got, buffer.size() - dataSize - got);
+			if (readNow == 0) break;
+			got += readNow;
+		}
+	}
+	else if (stream != nullptr)
+	{
+		stream->read(buffer.data() + dataSize, buffer.size() - dataSize);
+		got = stream->gcount();
+	}
+	else if (fd != -1)
+	{
+		ssize_t readNow = -1;
+		do
+		{
+			readNow = ::read(fd, buffer.data() + dataSize, buffer.size() - dataSize);
+		} while (readNow == -1 && errno == EINTR);
+		if (readNow == -1)
+		{
+			std::cerr << "Could not read input file: " << strerror(errno) << std::endl;
+			std::abort();
+		}
+		got = readNow;
+	}
+	if (got == 0) eof = true;
+	dataSize += got;
+	data = buffer.data();
+}
+
+FastQPool::FastQPool(size_t maxPooled) :
+	mutex(),
+	pooled(),
+	maxPooled(maxPooled)
+{
+	pooled.reserve(maxPooled);
+}
+
+FastQPool::~FastQPool()
+{
+	for (FastQ* read : pooled) delete read;
+}
+
+FastQ* FastQPool::acquire()
+{
+	{
+		std::lock_guard<std::mutex> lock { mutex };
+		if (pooled.size() > 0)
+		{
+			FastQ* result = pooled.back();
+			pooled.pop_back();
+			return result;
+		}
+	}
+	return new FastQ;
+}
+
+void FastQPool::release(FastQ* read)
+{
+	if (read->sequence.capacity() > MaxPooledCapacity || read->quality.capacity() > MaxPooledCapacity)
+	{
+		delete read;
+		return;
+	}
+	read->seq_id.clear();
+	read->sequence.clear();
+	read->quality.clear();
+	{
+		std::lock_guard<std::mutex> lock { mutex };
+		if (pooled.size() < maxPooled)
+		{
+			pooled.push_back(read);
+			return;
+		}
+	}
+	delete read;
+}
+
+FastQPool::Handle FastQPool::wrap(FastQ* read)
+{
+	return Handle { read, Releaser { this } };
+}
+
+void FastQPool::Releaser::operator()(FastQ* read) const
+{
+	pool->release(read);
+}
+
+std::string_view FastQ::trimLine(std::string_view line, bool trimSpaces)
+{
+	if (line.size() > 0 && line.back() == '\r') line.remove_suffix(1);
+	if (trimSpaces)
+	{
+		while (line.size() > 0 && line.back() == ' ') line.remove_suffix(1);
+	}
+	return line;
+}
+
 std::vector<FastQ> loadFastqFromFile(std::string filename, bool includeQuality)
 {
 	std::vector<FastQ> result;
@@ -2,107 +2,171 @@
 #define FastqLoader_H
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <memory>
+#include <mutex>
 #include <zstr.hpp> //https://github.com/mateidavid/zstr
 
+class FastQ;
+class GzipBlockReader;
+
+// reads the input in large blocks and hands out lines as views into the block buffer
+// plain files are memory mapped and pipes are read in blocks, compressed files are inflated on helper threads into a large buffer that is recycled between blocks
+class FastqInputBuffer
+{
+public:
+	FastqInputBuffer(const std::string& filename, bool gzipped, size_t decompressionThreads);
+	FastqInputBuffer(std::istream& stream);
+	~FastqInputBuffer();
+	FastqInputBuffer(const FastqInputBuffer& other) = delete;
+	FastqInputBuffer& operator=(const FastqInputBuffer& other) = delete;
+	// line excludes the newline and is valid until the next call
+	bool nextLine(std::string_view& line);
+private:
+	void refill();
+	const char* data;
+	size_t dataSize;
+	size_t pos;
+	bool eof;
+	std::vector<char> buffer;
+	char* mapped;
+	size_t mappedSize;
+	std::unique_ptr<GzipBlockReader> gzreader;
+	std::istream* stream;
+	int fd;
+};
+
+// recycles FastQ objects between the reader thread and the worker threads so the strings keep their capacity
+class FastQPool
+{
+public:
+	struct Releaser
+	{
+		void operator()(FastQ* read) const;
+		FastQPool* pool;
+	};
+	using Handle = std::unique_ptr<FastQ, Releaser>;
+	FastQPool(size_t maxPooled);
+	~FastQPool();
+	FastQPool(const FastQPool& other) = delete;
+	FastQPool& operator=(const FastQPool& other) = delete;
+	FastQ* acquire();
+	void release(FastQ* read);
+	Handle wrap(FastQ* read);
+private:
+	std::mutex mutex;
+	std::vector<FastQ*> pooled;
+	size_t maxPooled;
+};
+
 class FastQ {
 public:
 	template <typename F>
 	static void streamFastqFastqFromStream(std::istream& file, bool includeQuality, F f)
 	{
-		do
+		FastqInputBuffer input { file };
+		streamFastqFastqFromBuffer(input, includeQuality, f);
+	}
+	template <typename F>
+	static void streamFastqFastaFromStream(std::istream& file, bool includeQuality, F f)
+	{
+		FastqInputBuffer input { file };
+		streamFastqFastaFromBuffer(input, includeQuality, f);
+	}
+	// the same FastQ object is reused for every record, callbacks which keep the read should swap or move it out
+	template <typename F>
+	static void streamFastqFastqFromBuffer(FastqInputBuffer& input, bool includeQuality, F f)
+	{
+		FastQ newread;
+		std::string_view line;
+		while (input.nextLine(line))
 		{
-			std::string line;
-			std::getline(file, line);
-			if (!file.good()) break;
 			if (line.size() == 0) continue;
 			if (line[0] != '@') continue;
-			FastQ newread;
-			if (line.back() == '\r') line.pop_back();
-			while (line.back() == ' ') line.pop_back();
-			newread.seq_id = line.substr(1);
-			std::getline(file, line);
-			if (line.back() == '\r') line.pop_back();
-			newread.sequence = line;
-			std::getline(file, line);
-			std::getline(file, line);
-			if (line.back() == '\r') line.pop_back();
-			while (line.back() == ' ') line.pop_back();
+			line = trimLine(line, true);
+			newread.seq_id.assign(line.data() + 1, line.size() - 1);
+			if (!input.nextLine(line)) break;
+			line = trimLine(line, false);
+			newread.sequence.assign(line.data(), line.size());
+			input.nextLine(line);
+			if (!input.nextLine(line)) line = std::string_view {};
+			newread.quality.clear();
 			if (includeQuality)
 			{
-				newread.quality = line;
+				line = trimLine(line, true);
+				newread.quality.assign(line.data(), line.size());
 				assert(newread.quality.size() == newread.sequence.size());
 			}
 			f(newread);
-		} while (file.good());
+		}
 	}
+	// the same FastQ object is reused for every record, callbacks which keep the read should swap or move it out
 	template <typename F>
-	static void streamFastqFastaFromStream(std::istream& file, bool includeQuality, F f)
+	static void streamFastqFastaFromBuffer(FastqInputBuffer& input, bool includeQuality, F f)
 	{
-		std::string line;
-		std::getline(file, line);
-		do
+		FastQ newread;
+		std::string_view line;
+		bool haveLine = input.nextLine(line);
+		while (haveLine)
 		{
-			if (line.size() == 0)
-			{
-				std::getline(file, line);
-				continue;
-			}
-			if (line[0] != '>')
+			if (line.size() == 0 || line[0] != '>')
 			{
-				std::getline(file, line);
+				haveLine = input.nextLine(line);
 				continue;
 			}
-			FastQ newread;
-			if (line.back() == '\r') line.pop_back();
-			newread.seq_id = line.substr(1);
-			newread.sequence = "";
-			do
+			line = trimLine(line, false);
+			newread.seq_id.assign(line.data() + 1, line.size() - 1);
+			newread.sequence.clear();
+			haveLine = false;
+			while (input.nextLine(line))
 			{
-				line.clear();
-				std::getline(file, line);
 				if (line.size() == 0) continue;
-				if (line[0] == '>') break;
-				if (line.back() == '\r') line.pop_back();
-				while (line.back() == ' ') line.pop_back();
-				newread.sequence += line;
-			} while (file.good());
-			if (includeQuality)
-			{
-				for (size_t i = 0; i < newread.sequence.size(); i++)
+				if (line[0] == '>')
 				{
-					newread.quality += '!';
+					haveLine = true;
+					break;
 				}
+				line = trimLine(line, true);
+				newread.sequence.append(line.data(), line.size());
 			}
+			newread.quality.clear();
+			if (includeQuality) newread.quality.assign(newread.sequence.size(), '!');
 			f(newread);
-		} while (file.good());
+		}
 	}
 	template <typename F>
 	static void streamFastqFastqFromFile(std::string filename, bool includeQuality, F f)
 	{
-		std::ifstream file {filename};
-		streamFastqFastqFromStream(file, includeQuality, f);
+		FastqInputBuffer input { filename, false, 1 };
+		streamFastqFastqFromBuffer(input, includeQuality, f);
 	}
 	template <typename F>
 	static void streamFastqFastaFromFile(std::string filename, bool includeQuality, F f)
 	{
-		std::ifstream file {filename};
-		streamFastqFastaFromStream(file, includeQuality, f);
+		FastqInputBuffer input { filename, false, 1 };
+		streamFastqFastaFromBuffer(input, includeQuality, f);
 	}
 	template <typename F>
-	static void streamFastqFastqFromGzippedFile(std::string filename, bool includeQuality, F f)
+	static void streamFastqFastqFromGzippedFile(std::string filename, bool includeQuality, size_t decompressionThreads, F f)
 	{
-		zstr::ifstream file { filename };
-		streamFastqFastqFromStream(file, includeQuality, f);
+		FastqInputBuffer input { filename, true, decompressionThreads };
+		streamFastqFastqFromBuffer(input, includeQuality, f);
 	}
 	template <typename F>
-	static void streamFastqFastaFromGzippedFile(std::string filename, bool includeQuality, F f)
+	static void streamFastqFastaFromGzippedFile(std::string filename, bool includeQuality, size_t decompressionThreads, F f)
 	{
-		zstr::ifstream file { filename };
-		streamFastqFastaFromStream(file, includeQuality, f);
+		FastqInputBuffer input { filename, true, decompressionThreads };
+		streamFastqFastaFromBuffer(input, includeQuality, f);
 	}
 	template <typename F>
 	static void streamFastqFromFile(std::string filename, bool includeQuality, F f)
+	{
+		streamFastqFromFile(filename, includeQuality, 1, f);
+	}
+	// decompressionThreads is used for BGZF input, other gzip input is inflated on one helper thread
+	template <typename F>
+	static void streamFastqFromFile(std::string filename, bool includeQuality, size_t decompressionThreads, F f)
 	{
 		bool gzipped = false;
 		std::string originalFilename = filename;
@@ -121,7 +185,7 @@ public:
 		{
 			if (gzipped)
 			{
-				streamFastqFastaFromGzippedFile(originalFilename, includeQuality, f);
+				streamFastqFastaFromGzippedFile(originalFilename, includeQuality, decompressionThreads, f);
 				return;
 			}
 			else
@@ -134,7 +198,7 @@ public:
 		{
 			if (gzipped)
 			{
-				streamFastqFastqFromGzippedFile(originalFilename, includeQuality, f);
+				streamFastqFastqFromGzippedFile(originalFilename, includeQuality, decompressionThreads, f);
 				return;
 			}
 			else
@@ -148,6 +212,8 @@ public:
 	std::string seq_id;
 	std::string sequence;
 	std::string quality;
+private:
+	static std::string_view trimLine(std::string_view line, bool trimSpaces);
 };
 
 std::vector<FastQ> loadFastqFromFile(std::string filename, bool includeQuality = true);